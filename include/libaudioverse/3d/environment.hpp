@@ -14,6 +14,11 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <memory>
 #include <tuple>
 #include <glm/glm.hpp>
+#include "../implementations/ambisonics.hpp"
+#include "../implementations/amplitude_panner.hpp"
+#include "../implementations/hrtf_panner.hpp"
+#include "../implementations/buffer_player.hpp"
+#include "panner_pool.hpp"
 
 namespace libaudioverse_implementation {
 
@@ -24,6 +29,14 @@ class Buffer;
 class BufferNode;
 
 
+//Early reflections delayed by more than this many seconds are left to the reverb.
+const float environment_max_reflection_delay = 0.2f;
+const float environment_speed_of_sound = 343.0f;
+//Direct sources keep their panner until another source is this many times more audible, so near ties don't crossfade back and forth every block.
+const float environment_direct_hysteresis = 1.5f;
+//Likewise for real voices, since each change leaves or rejoins the plan.
+const float environment_voice_hysteresis = 1.5f;
+
 /**Configuration of an effect send.*/
 class EffectSendConfiguration {
 	public:
@@ -52,11 +65,80 @@ class EnvironmentInfo {
 	float min_distance = 0.0, max_distance = 0.0;
 	float reverb_distance = 0.0;
 	float min_reverb_level = 0.0, max_reverb_level = 1.0;
+	//0 unless sources should encode to the ambisonic bus.
+	int ambisonic_order = 0;
+	//How many sources the environment lets pan directly while the bus is in use.
+	int max_direct_sources = 0;
+	//0 for no limit.
+	int max_voices = 0;
+};
+
+/**Everything needed to update all of an environment's sources at once, as structure of arrays.
+
+Each source gathers its inputs into its index, the environment computes the outputs for every source with the geometry kernels, and then each source reads its outputs back.
+Positions are in world coordinates, except for head-relative sources which are already relative to the listener.*/
+class SourceUpdateBatch {
+	public:
+	void resize(int count);
+	int count = 0;
+	std::vector<SourceNode*> sources;
+	//Inputs.
+	std::vector<float> x, y, z, size, max_distance, reverb_distance, min_reverb_level, max_reverb_level, mul, occlusion, priority;
+	std::vector<int> head_relative, distance_model, panning_strategy, reverb_count;
+	//Outputs. Azimuth and elevation are in degrees.
+	std::vector<float> distance, azimuth, elevation, dry_gain, reverb_gain;
+	//Scratch.
+	std::vector<float> zeros, ones, horizontal_distance, negative_z;
+	std::vector<std::tuple<int, float, float, float>> head_relative_positions;
+};
+
+//Fill in the outputs of batch from its inputs.
+void computeSourceUpdates(const EnvironmentInfo &env, SourceUpdateBatch &batch);
+
+//The matrix taking world coordinates to those of a listener at position facing orientation, which is at and up packed as 6 floats.
+glm::mat4 computeWorldToListenerTransform(const float* position, const float* orientation);
+
+/**A listener beyond the first, which is the environment's own position and orientation.
+Sources filter their input once and then pan it for each listener, with the geometry computed per listener.
+Each listener has its own output, and its sources go straight to it: extra listeners don't use effect sends or the ambisonic bus.*/
+class ListenerConfiguration {
+	public:
+	float position[3] = {0.0f, 0.0f, 0.0f};
+	float orientation[6] = {0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f};
+	int panning_strategy = Lav_PANNING_STRATEGY_HRTF;
+	int channels = 2;
+	int start = 0; //The output we start at.
+	EnvironmentInfo info;
+	//A copy of the inputs of the environment's batch, with our outputs.
+	SourceUpdateBatch batch;
+};
+
+/**A sound from playAsync, played by the environment itself instead of by a source and buffer node.
+The environment keeps a pool of these, so starting one allocates nothing and leaves the plan alone.*/
+class AsyncVoice {
+	public:
+	AsyncVoice(int blockSize, float sr, std::shared_ptr<HrtfData> hrtf);
+	BufferPlayer player;
+	HrtfPanner hrtf_panner;
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+	bool is_dry = false;
+	//Set until the first block, so that we start at the right place without fading.
+	bool is_new = true;
+	float ambisonic_gains[ambisonic_max_channels] = {}, prev_ambisonic_gains[ambisonic_max_channels] = {};
+};
+
+/**Buffers for the sources of one job group to accumulate into.
+Sources in different groups may run at the same time, so each group gets its own; they're summed at the start of the environment's process.*/
+class AccumulationBuffers {
+	public:
+	std::vector<float*> source_buffers, ambisonic_buffers;
+	//Set by the first source to write this block.
+	bool used = false;
 };
 
 /**The sorce and environment model does not use the standard node and implementation separation.
 
-Sources write directly to special buffers in the environment, which are then copied to the environment's output in the process method.
+Sources write directly to special buffers in the environment, one set per job group, which are then summed and copied to the environment's output in the process method.
 */
 
 class EnvironmentNode: public Node {
@@ -80,19 +162,84 @@ class EnvironmentNode: public Node {
 	int addEffectSend(int channels, bool isReverb, bool connecctByDefault);
 	EffectSendConfiguration& getEffectSend(int which);
 	int getEffectSendCount();
-	//This is a public variable; sources write directly to these buffers.
+	//Listeners are numbered from 1; 0 is the environment itself.
+	int addListener(int panningStrategy);
+	ListenerConfiguration& getListener(int which);
+	int getListenerCount();
+	void setListenerPosition(int which, float x, float y, float z);
+	void setListenerOrientation(int which, float atX, float atY, float atZ, float upX, float upY, float upZ);
+	//Counts from the last block.
+	void getVoiceCounts(int* realVoices, int* virtualVoices);
+	//Sources get their panners here, and only from updatePanners.
+	PannerPool& getPannerPool();
+	//The buffers for the job group of the calling thread, grown to match source_buffers.  Only for use in process.
+	AccumulationBuffers& getAccumulationBuffers();
+	//Sources write to their group's copies of these, which we sum here before anything else reads them.
 	//There are always at least 8 buffers, with additional buffers appended for effect sends.
 	std::vector<float*> source_buffers;
+	//Sources using the ambisonic bus write here instead.  There are always ambisonic_max_channels.
+	std::vector<float*> ambisonic_buffers;
 	private:
+	//Make a decoder for the current order and panning strategy.
+	//This runs on the thread setting either property, which holds the server's lock, so the new decoder takes over at a block boundary.
+	void configureAmbisonicDecoder();
+	//Update every source, in one pass over batch.
+	void updateSources();
+	//Manage the pool of AsyncVoice.  Starting fails if the pool is full.
+	void resizeVoicePool(int size);
+	bool startVoice(std::shared_ptr<Buffer> buffer, float x, float y, float z, bool isDry);
+	//Compute the geometry of the voices in willTick, then play them in process.
+	void updateVoices();
+	void renderVoices();
+	//Sum the accumulation buffers into source_buffers and ambisonic_buffers in group order, and clear them for the next block.
+	void reduceAccumulationBuffers();
+	AmplitudePanner* getPannerForChannels(int channels);
+	//Apply max_voices, making the lowest scoring sources virtual.
+	void manageVoices();
+	//Pick the sources which bypass the bus.
+	void rankSources();
+	//Place the images of every source in the room and give each source its taps, keeping at most max_reflections.
+	//Called between gathering and computing the batch, while its positions are still in world coordinates.
+	void gatherReflections();
+	void updateReflections();
 	//while these may be parents (through virtue of the panners we give out), they also have to hold a reference to us-and that reference must be strong.
 	//the world is more capable of handling a source that dies than a source a world that dies.
 	std::set<std::weak_ptr<SourceNode>, std::owner_less<std::weak_ptr<SourceNode>>> sources;
 	std::shared_ptr<HrtfData > hrtf;
 	EnvironmentInfo environment_info;
 	std::vector<EffectSendConfiguration> effect_sends;
+	//Pointers so that sources can hold onto a listener across additions.
+	std::vector<std::unique_ptr<ListenerConfiguration>> listeners;
+	//At most one of these exists, and only while the ambisonic bus is in use.
+	std::shared_ptr<AmbisonicBinauralDecoder> binaural_decoder;
+	std::shared_ptr<AmbisonicSpeakerDecoder> speaker_decoder;
+	std::unique_ptr<PannerPool> panner_pool;
+	//Have the pool start on the panners the current panning strategy needs, and on reflection lines if there are reflections.
+	void preparePanners();
 	
 	template<typename JobT, typename CallableT, typename... ArgsT>
 	friend void environmentVisitDependencies(JobT&& start, CallableT &&callable, ArgsT&&... args);
+	SourceUpdateBatch batch;
+	//One per job group of the planner.  Each is allocated on first use.
+	std::vector<AccumulationBuffers> accumulation_buffers;
+	int real_voice_count = 0, virtual_voice_count = 0;
+	//The pool.  Both vectors of indices are into voices, and voice_batch is parallel to active_voices.
+	std::vector<std::unique_ptr<AsyncVoice>> voices;
+	std::vector<int> free_voices, active_voices;
+	SourceUpdateBatch voice_batch;
+	//Images of the sources, as (x, y, z) offsets in rooms, for the current reflection order.
+	std::vector<std::tuple<int, int, int>> reflection_images;
+	int reflection_images_order = 0;
+	//One entry per image of every source with reflections, and the index in batch of the source it belongs to.
+	SourceUpdateBatch reflection_batch;
+	std::vector<int> reflection_owners, reflection_image_indices;
+	std::vector<std::tuple<float, int>> ranked_reflections;
+	//Reflections pan through the shared tables for 2, 4, 6, and 8 channels, made when first needed.
+	std::shared_ptr<AmplitudePannerTable> reflection_tables[4];
+	//The voices share these, since amplitude panners only hold an angle.
+	AmplitudePanner stereo_panner, surround40_panner, surround51_panner, surround71_panner;
+	//Scratch for rankSources and manageVoices, kept to avoid allocating every block.
+	std::vector<std::tuple<float, SourceNode*>> ranked_sources;
 	//This is used to make play_async not invalidate the plan.
 	std::vector<std::tuple<std::shared_ptr<BufferNode>, std::shared_ptr<SourceNode>>> play_async_source_cache;
 	int play_async_source_cache_limit = 30; //How many we're willing to cache.
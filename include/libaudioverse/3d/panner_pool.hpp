@@ -0,0 +1,89 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include "../implementations/amplitude_panner.hpp"
+#include "../implementations/hrtf_panner.hpp"
+#include "../implementations/delayline.hpp"
+#include "../private/lock_free_ring.hpp"
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace libaudioverse_implementation {
+
+class HrtfData;
+
+//How many ready panners the pool keeps of each kind that has been used.
+const int panner_pool_spares = 4;
+//The most ready panners of one kind, and the most waiting to be destroyed.
+const int panner_pool_capacity = 64;
+const int panner_pool_retired_capacity = 256;
+//The thread checks for work at least this often, in seconds.
+const double panner_pool_max_sleep = 0.05;
+//The kind for the delay lines of early reflections.
+const int panner_pool_reflection_line_kind = 5;
+const int panner_pool_kinds = 6;
+
+/**Builds and destroys the panners of an environment's sources on a thread of its own, so that the audio thread does neither.
+
+The audio side is the environment's willTick: sources take panners and give them back from updatePanners, and then the environment calls endBlock.
+Panners pass between the two sides through lock-free rings.
+A few spares of each kind in use are kept ready.  When a take finds none, the panner is built on the audio thread after all and counted as a miss, and the thread keeps enough spares to cover the burst next time.
+
+The lines sources use for early reflections are large enough to need the same treatment, so they come from here too.
+Going without one only delays a source's reflections, which fade in when it arrives, so a take of a line doesn't build one on the audio thread.
+
+Kinds are 0 for hrtf and channels/2 for amplitude panners, then panner_pool_reflection_line_kind.*/
+class PannerPool {
+	public:
+	//reflectionDelay is the longest delay of a reflection line, in samples.
+	PannerPool(int blockSize, float sr, std::shared_ptr<HrtfData> hrtf, int reflectionDelay);
+	~PannerPool();
+	//Never nullptr.  Panners start facing straight ahead, and have never panned.
+	HrtfPanner* takeHrtfPanner();
+	AmplitudePanner* takeAmplitudePanner(int channels);
+	//nullptr if none are ready.  Lines are silent.
+	MultiTapDelayLine* takeReflectionLine();
+	//False if the pool can't accept the panner yet; keep it and try again next block.
+	bool giveBack(HrtfPanner* panner);
+	bool giveBack(AmplitudePanner* panner);
+	bool giveBack(MultiTapDelayLine* line);
+	//Ask the thread for whatever this block was short of.
+	void endBlock();
+	//Start keeping spares of a kind before the audio thread first asks.  Any thread.
+	void prepare(int kind);
+	private:
+	void threadFunction();
+	//Destroy what was given back and top up the spares.
+	void work();
+	AmplitudePanner* buildAmplitudePanner(int kind);
+	MultiTapDelayLine* buildReflectionLine();
+	int block_size;
+	float sr;
+	std::shared_ptr<HrtfData> hrtf;
+	int reflection_delay;
+	std::unique_ptr<LockFreeRing<HrtfPanner*>> hrtf_ready, hrtf_retired;
+	//Indexed by kind-1.
+	std::unique_ptr<LockFreeRing<AmplitudePanner*>> amplitude_ready[4];
+	std::unique_ptr<LockFreeRing<AmplitudePanner*>> amplitude_retired;
+	std::unique_ptr<LockFreeRing<MultiTapDelayLine*>> line_ready, line_retired;
+	//How many ready panners the thread keeps of each kind.
+	std::atomic<int> targets[panner_pool_kinds];
+	//Audio side only: takes which had to build this block, and whether anything happened at all.
+	int misses[panner_pool_kinds] = {};
+	bool touched = false;
+	std::atomic<bool> woken{false};
+	bool running = true;
+	std::mutex mutex;
+	std::condition_variable wake_condition;
+	std::thread thread;
+};
+
+}
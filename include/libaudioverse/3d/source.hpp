@@ -10,17 +10,46 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include "../implementations/amplitude_panner.hpp"
 #include "../implementations/hrtf_panner.hpp"
 #include "../implementations/biquad.hpp"
+#include "../implementations/ambisonics.hpp"
+#include "../implementations/delayline.hpp"
 #include <memory>
 #include <set>
 #include <vector>
 #include <map>
+#include <math.h>
 
 namespace libaudioverse_implementation {
 
 class EnvironmentNode;
 class EnvironmentInfo;
+class SourceUpdateBatch;
+class ListenerConfiguration;
 class HrtfData;
 
+//What a source keeps for each listener beyond the environment's own.
+class SourceListenerState {
+	public:
+	//Only one of these is used, depending on the listener's panning strategy.
+	std::unique_ptr<HrtfPanner> hrtf_panner;
+	std::unique_ptr<AmplitudePanner> amplitude_panner;
+	int panner_last_used = 0;
+	//The environment never removes listeners, so this stays valid.
+	const ListenerConfiguration* listener = nullptr;
+	float dry_gain = 0.0f;
+	float last_azimuth = NAN, last_elevation = NAN;
+	bool culled = true;
+};
+
+//One image of a source in the environment's room, written by the environment every block.
+class ReflectionTap {
+	public:
+	//In samples, after the direct sound.  We move from prev_delay to delay over the block.
+	float delay = 0.0f, prev_delay = 0.0f;
+	int channels = 0;
+	//Gains per output channel, including panning.  We fade from prev_gains to gains over the block.
+	float gains[8] = {}, prev_gains[8] = {};
+};
+
 class SourceNode: public Node {
 	public:
 	SourceNode(std::shared_ptr<Server> server, std::shared_ptr<EnvironmentNode> environment);
@@ -28,23 +57,83 @@ class SourceNode: public Node {
 	void reset() override;
 	void feedEffect(int which);
 	void stopFeedingEffect(int which);
+	//Update just this source.  The environment normally updates all of its sources at once, with the following two functions.
 	void update(EnvironmentInfo env);
+	//Write our inputs to batch at index.
+	void gatherUpdate(EnvironmentInfo env, SourceUpdateBatch &batch, int index);
+	//Pick up our outputs, touching the panners only if something changed.
+	void applyUpdate(const EnvironmentInfo &env, SourceUpdateBatch &batch, int index);
+	//The same, for one of the environment's extra listeners.  which is 0 for the first of them.
+	void applyListenerUpdate(int which, const ListenerConfiguration &listener, SourceUpdateBatch &batch, int index);
 	void updateEnvironmentInfoFromProperties(EnvironmentInfo& env);
 	void updatePropertiesFromEnvironmentInfo(const EnvironmentInfo& env);
 	void setPropertiesFromEnvironment();
 	virtual void process() override;
+	//Culled and virtual sources are left out of the plan, along with anything upstream that nothing else needs.
+	bool canCull() override;
+	//Set by the environment's voice limit.  Sources fade out before becoming virtual, and fade in afterward.
+	void setVirtual(bool v);
+	bool isVirtual();
+	//False from the moment setVirtual(true) starts the fade out, unlike isVirtual.
+	bool isReal();
+	//Leave or rejoin the plan if culling or the voice limit changed.  Called after setVirtual every block.
+	void updatePlanMembership();
 	void handleStateUpdates(bool shouldCull);
 	void handleOcclusion();
+	//The gain from the last update to the loudest listener, or 0 if culled for all of them.
+	float getAudibility();
+	//The same, for the environment's own listener only.
+	float getMainAudibility();
+	//While the environment's ambisonic bus is in use, whether to use our own panner instead.
+	void setDirect(bool d);
+	bool isDirect();
+	//Create the panners this block needs and release any that have gone unused for the grace period.
+	//Called after setDirect, so that promoted sources have a panner before they process.
+	void updatePanners();
+	//One per image of this source in the environment's room, or empty if there is no room.
+	std::vector<ReflectionTap>& getReflectionTaps();
 	private:
-	bool culled = false;
-	float dry_gain, reverb_gain;
+	//Panners are taken from the environment's pool when something first needs them, and face the current direction.
+	//These come from the environment's panner pool.
+	HrtfPanner* getHrtfPanner();
+	AmplitudePanner* getAmplitudePanner(int channels);
+	//Pan with our own panner, then add to outputs with gain moving from gainStart to gainEnd.
+	void panDirect(float* input, float** panBuffers, float** outputs, float gainStart, float gainEnd);
+	//Everything for the environment's own listener, which may be skipped if only the other listeners can hear us.
+	void processMainListener(float* input, float** panBuffers, float** outputs);
+	void processOtherListeners(float* input, float** panBuffers, float** outputs);
+	//Delay input into the reflection line and add every audible tap to outputs.  scratch is one block.
+	void processReflections(float* input, float* scratch, float** outputs);
+	//True if no extra listener can hear us.
+	bool isCulledForOtherListeners();
+	bool culled = false, is_virtual = false, out_of_plan = false;
+	//The tick at which we left the plan.  When we come back, the nodes upstream skip ahead by the blocks since.
+	int out_of_plan_since = 0;
+	//The gain from the voice limit, and where it's heading.
+	float voice_gain = 1.0f, voice_target = 1.0f;
+	float dry_gain = 0.0f, reverb_gain = 0.0f;
+	//What the panners and occlusion filter were last set to.
+	float last_azimuth = NAN, last_elevation = NAN, last_occlusion = 0.0f;
 	int panning_strategy;
-	HrtfPanner hrtf_panner;
-	AmplitudePanner stereo_panner, surround40_panner, surround51_panner, surround71_panner;
+	//If nonzero, we encode to the environment's ambisonic bus, fading from the previous gains to the current ones.
+	int ambisonic_order = 0;
+	float ambisonic_gains[ambisonic_max_channels] = {}, prev_ambisonic_gains[ambisonic_max_channels] = {};
+	//direct is set by the environment; was_direct is what we did last block, so that changes crossfade.
+	bool direct = false, was_direct = false;
+	//Most sources only ever use one panner, and the hrtf panner is by far the largest part of a source.
+	//So they're null until needed.  The amplitude panners are for 2, 4, 6, and 8 channels, in that order.
+	std::unique_ptr<HrtfPanner> hrtf_panner;
+	std::unique_ptr<AmplitudePanner> amplitude_panners[4];
+	//The tick at which each panner was last needed.
+	int hrtf_panner_last_used = 0, amplitude_panner_last_used[4] = {};
 	BiquadFilter occlusion_filter;
 	std::shared_ptr<EnvironmentNode> environment;
 	std::shared_ptr<HrtfData> hrtf_data;
-	std::map<int, AmplitudePanner*> fed_effects;
+	std::set<int> fed_effects;
+	std::vector<std::unique_ptr<SourceListenerState>> listener_states;
+	//All of our reflections share one line, which the environment's pool gives us only while one of our taps is heard.
+	std::vector<ReflectionTap> reflection_taps;
+	std::unique_ptr<MultiTapDelayLine> reflection_line;
 };
 
 std::shared_ptr<SourceNode> createSourceNode(std::shared_ptr<Server> server, std::shared_ptr<EnvironmentNode> environment);
@@ -0,0 +1,64 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include <kiss_fft.h>
+#include <memory>
+#include <vector>
+
+namespace libaudioverse_implementation {
+
+class HrtfData;
+class FftPlan;
+
+/**Ambisonics of orders 1 through 3.
+
+Channels are in ACN order with N3D normalization.
+Directions are azimuth and elevation in degrees, using the same conventions as the panners.
+Decoding goes through a fixed set of virtual speakers spread over the sphere, with max-rE weighting.*/
+const int ambisonic_max_order = 3;
+const int ambisonic_max_channels = (ambisonic_max_order+1)*(ambisonic_max_order+1);
+
+int ambisonicChannelCount(int order);
+//Writes ambisonicChannelCount(order) coefficients.
+void computeAmbisonicCoefficients(int order, float azimuth, float elevation, float* out);
+//Add input to the bus, moving each channel's gain linearly from from to to over the block.
+void ambisonicEncode(int blockSize, int order, float* input, float* from, float* to, float** bus);
+
+//Decodes to binaural with filters made from the hrirs of the virtual speakers.
+//Each block costs one fft per channel and one inverse fft per ear.
+class AmbisonicBinauralDecoder {
+	public:
+	AmbisonicBinauralDecoder(int blockSize, int order, std::shared_ptr<HrtfData> hrtf);
+	~AmbisonicBinauralDecoder();
+	//Adds to left and right.
+	void decode(float** bus, float* left, float* right);
+	void reset();
+	private:
+	int block_size, channels, fft_size, bin_count;
+	std::shared_ptr<FftPlan> fft, ifft;
+	//Per channel: the last fft_size samples of input, and the filter spectra for each ear.
+	std::vector<float*> histories;
+	std::vector<kiss_fft_cpx*> left_filters, right_filters;
+	kiss_fft_cpx *input_spectrum = nullptr, *left_accumulator = nullptr, *right_accumulator = nullptr;
+	float* workspace = nullptr;
+};
+
+//Decodes to one of the speaker layouts of the AmplitudePanner, by panning each virtual speaker.
+class AmbisonicSpeakerDecoder {
+	public:
+	//map is the same as for AmplitudePanner::readMap.
+	AmbisonicSpeakerDecoder(int order, int speakerCount, float* map);
+	//Adds to outputs.
+	void decode(int blockSize, float** bus, float** outputs);
+	private:
+	int channels, speaker_count;
+	//speaker_count rows of channels gains.
+	std::vector<float> matrix;
+};
+
+}
@@ -7,6 +7,7 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
 #include <vector>
+#include <memory>
 
 namespace libaudioverse_implementation {
 
@@ -19,22 +20,61 @@ struct AmplitudePannerEntry {
 	int channel;
 };
 
+//The default number of table entries per degree.
+const int amplitude_panner_default_table_resolution = 10;
+
+/**The pair of channels and their gains for every azimuth, at resolution entries per degree.
+Built once from a sorted map.  Azimuths round to the nearest entry.*/
+struct AmplitudePannerTableEntry {
+	int channel1, channel2;
+	float weight1, weight2;
+};
+
+class AmplitudePannerTable {
+	public:
+	AmplitudePannerTable(const std::vector<AmplitudePannerEntry> &channels, int resolution);
+	const AmplitudePannerTableEntry& lookup(float azimuth);
+	private:
+	int resolution;
+	std::vector<AmplitudePannerTableEntry> entries;
+};
+
+//The standard layouts share their tables between every panner.  Safe to call from any thread.
+std::shared_ptr<AmplitudePannerTable> getStandardAmplitudePannerTable(int channels, int resolution);
+
 class AmplitudePanner {
 	public:
 	AmplitudePanner(int _block_size, float _sr);
 	void clearMap();
 	void addEntry(float angle, int channel);
+	//Writes every output, zeroing the ones that aren't in use.
 	void pan(float* input, float** outputs);
+	//If map is one of the standard maps, this uses the shared table.  Otherwise the table is built here.
 	void readMap(int entries, float* map);
 	float getAzimuth();
 	void setAzimuth(float a);
 	float getElevation();
 	void setElevation(float e);
+	//When the gains change, ramp to the new ones over a block.
+	//Panners shared between many inputs should turn this off, since the ramp would start from the last input's gains.
+	void setShouldCrossfade(bool cf);
+	bool getShouldCrossfade();
+	void setTableResolution(int r);
+	int getTableResolution();
 	private:
+	void buildTable();
 	std::vector<AmplitudePannerEntry> channels;
+	std::shared_ptr<AmplitudePannerTable> table;
+	//The standard layout we're using, or 0.
+	int standard_channels = 0;
+	//Indexed by output.
+	std::vector<float> gains, target_gains;
+	int output_count = 0;
 	float azimuth = 0.0f, elevation = 0.0f;
 	float sr;
 	int block_size;
+	int table_resolution = amplitude_panner_default_table_resolution;
+	bool should_crossfade = true, has_panned = false;
 };
 
 }
\ No newline at end of file
@@ -8,6 +8,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #pragma once
 #include "../private/buffer.hpp"
 #include "../private/memory.hpp"
+#include "../private/kernels.hpp"
 #include <audio_io/audio_io.hpp>
 #include <memory>
 #include <vector>
@@ -23,6 +24,8 @@ class BufferPlayer {
 	BufferPlayer(int _block_size, float _sr);
 	~BufferPlayer();
 	void process(int channels, float** outputs);
+	//Advance as process would over frames output frames, without producing anything.
+	void skip(int frames);
 	void setBuffer(std::shared_ptr<Buffer> buff);
 	std::shared_ptr<Buffer> getBuffer();
 	void setPosition(double position);
@@ -35,6 +38,10 @@ class BufferPlayer {
 	int getEndedCount();
 	void setEndedCount(int c);
 	private:
+	//Interpolation reads one sample at a time, which only direct buffers can afford.
+	//For the others, it reads from a window of decoded audio.
+	float readSample(int f, int channel);
+	void fillWindow(int f);
 	std::shared_ptr<Buffer> buffer = nullptr;
 	int frame = 0;
 	int buffer_length=0;
@@ -49,12 +56,19 @@ class BufferPlayer {
 	int buffer_channels = 0;
 	//We get our output, and then downmix it ourselves.
 	std::vector<float*> intermediate_destination;
+	bool buffer_is_direct = true;
+	//Windows start on ADPCM blocks, so that filling one never decodes a block twice.
+	std::vector<float*> window;
+	int window_start = 0, window_length = 0, window_size;
 };
 
-inline BufferPlayer::BufferPlayer(int _block_size, float _sr): sr(_sr), block_size(_block_size) {}
+inline BufferPlayer::BufferPlayer(int _block_size, float _sr): sr(_sr), block_size(_block_size) {
+	window_size = (block_size/adpcm_block_frames+2)*adpcm_block_frames;
+}
 
 inline BufferPlayer::~BufferPlayer() {
 	for(auto &i: intermediate_destination) freeArray(i);
+	for(auto &i: window) freeArray(i);
 	if(buffer) buffer->decrementUseCount();
 }
 
@@ -62,9 +76,14 @@ inline void BufferPlayer::process(int channels, float** outputs) {
 	if(buffer == nullptr) return; //no buffer.
 	if(buffer_length== 0) return;
 	if(ended) return;
+	if(buffer_is_direct == false) buffer->prefetch(frame, is_looping);
 	//This is an optimizable case, and a fairly common one.  It degrades to a memcpy when we can do it.
 	if(rate == 1.0 && offset < 1e-5 && frame+block_size < buffer_length) {
 		for(int ch = 0; ch < buffer_channels; ch++) {
+			if(buffer_is_direct == false) {
+				buffer->decode(ch, frame, block_size, intermediate_destination[ch]);
+				continue;
+			}
 			float* p=buffer->getPointer(frame, ch);
 			std::copy(p, p+block_size, intermediate_destination[ch]);
 		}
@@ -85,10 +104,10 @@ inline void BufferPlayer::process(int channels, float** outputs) {
 			}
 			for(int chan =0; chan < buffer_channels; chan++) {
 				//This is standard linear interpolation.
-				double a = buffer->getSample(frame, chan);
+				double a = readSample(frame, chan);
 				double b;
-				if(frame+1 < buffer_length) b = buffer->getSample(frame+1, chan); //okay, we have one more sample after this one.
-				else if(is_looping) b =buffer->getSample(0, chan); //We have a next sample, but it's looped to the beginning.
+				if(frame+1 < buffer_length) b = readSample(frame+1, chan); //okay, we have one more sample after this one.
+				else if(is_looping) b =readSample(0, chan); //We have a next sample, but it's looped to the beginning.
 				else b = 0.0; //no next sample.
 				double weight1 = 1-offset;
 				double weight2 = offset;
@@ -108,6 +127,38 @@ inline void BufferPlayer::process(int channels, float** outputs) {
 	audio_io::remixAudioUninterleaved(block_size, buffer_channels, &intermediate_destination[0], channels, outputs);
 }
 
+inline float BufferPlayer::readSample(int f, int channel) {
+	if(buffer_is_direct) return buffer->getSample(f, channel);
+	if(f < window_start || f >= window_start+window_length) fillWindow(f);
+	return window[channel][f-window_start];
+}
+
+inline void BufferPlayer::fillWindow(int f) {
+	window_start = f/adpcm_block_frames*adpcm_block_frames;
+	window_length = std::min(window_size, buffer_length-window_start);
+	for(int ch = 0; ch < buffer_channels; ch++) buffer->decode(ch, window_start, window_length, window[ch]);
+}
+
+inline void BufferPlayer::skip(int frames) {
+	if(buffer == nullptr || buffer_length == 0 || ended) return;
+	double position = frame+offset+rate*frames;
+	if(position >= buffer_length) {
+		if(is_looping == false) {
+			if(ended_count < std::numeric_limits<int>::max()) ended_count++;
+			ended = true;
+			frame = buffer_length;
+			offset = 0.0;
+			return;
+		}
+		//Every pass over the end counts, as it does in process.
+		double loops = floor(position/buffer_length);
+		ended_count = (int)std::min<double>(ended_count+loops, std::numeric_limits<int>::max());
+		position -= loops*buffer_length;
+	}
+	frame = (int)floor(position);
+	offset = position-frame;
+}
+
 inline void BufferPlayer::setBuffer(std::shared_ptr<Buffer> b) {
 	if(buffer) buffer->decrementUseCount();
 	buffer = b;
@@ -123,6 +174,11 @@ inline void BufferPlayer::setBuffer(std::shared_ptr<Buffer> b) {
 		while(intermediate_destination.size() < (unsigned int)b->getChannels()) intermediate_destination.push_back(allocArray<float>(block_size));
 	}
 	buffer_channels = b ? b->getChannels() : 0;
+	buffer_is_direct = b == nullptr || b->isDirect();
+	window_length = 0;
+	if(buffer_is_direct == false) {
+		while(window.size() < (unsigned int)buffer_channels) window.push_back(allocArray<float>(window_size));
+	}
 }
 
 inline std::shared_ptr<Buffer> BufferPlayer::getBuffer() {
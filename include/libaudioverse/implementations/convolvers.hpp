@@ -6,10 +6,19 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 <LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
-#include <kiss_fftr.h>
+#include <kiss_fft.h>
+#include <memory>
+#include <future>
+#include <vector>
+
+namespace powercores {
+class ThreadPool;
+}
 
 namespace libaudioverse_implementation {
 
+class FftPlan;
+
 class BlockConvolver {
 	public:
 	BlockConvolver(int blockSize);
@@ -33,7 +42,7 @@ class FftConvolver {
 	void convolve(float* input, float* output);
 	//Convolve with an fft of the input.
 	//This fft must meet a size requirement, queerieable by getFftSize().
-	//Must be computed with kiss_fftr.
+	//Must be computed with an FftPlan of that size.
 	void convolveFft(kiss_fft_cpx *fft, float* output);
 	//If using convolveFft, this is the size to which the input must be zero-padded.
 	int getFftSize();
@@ -46,7 +55,46 @@ class FftConvolver {
 	int block_size = 0, fft_size = 0, tail_size= 0, workspace_size = 0;
 	float*workspace = nullptr, *tail = nullptr;
 	kiss_fft_cpx *response_fft = nullptr, *block_fft = nullptr;
-	kiss_fftr_cfg fft = nullptr, ifft = nullptr;
+	std::shared_ptr<FftPlan> fft, ifft;
+};
+
+//One uniformly partitioned piece of a PartitionedConvolver.
+class ConvolutionSegment;
+
+/**A non-uniform partitioned convolver, for responses of several seconds.
+
+The first part of the response is convolved every block with partitions of the block size, so there is no added latency.
+The rest of the response is split into stages whose partitions double in size up to a maximum.
+A stage with partitions of size n starts 2n samples into the response, so its fft can run on a background thread while the next n samples of input arrive.
+The deadline is therefore the block on which the stage's output is first needed; if the background thread is late, we wait for it.*/
+class PartitionedConvolver {
+	public:
+	PartitionedConvolver(int blockSize);
+	~PartitionedConvolver();
+	void setResponse(int length, float* response);
+	void convolve(float* input, float* output);
+	void reset();
+	private:
+	struct TailStage {
+		ConvolutionSegment* segment = nullptr;
+		//The output being read and the output being computed in the background.
+		float* current = nullptr, *next = nullptr;
+		//Input accumulated for the next job.
+		float* input = nullptr;
+		int fill = 0, read_position = 0;
+		bool job_pending = false;
+		std::future<void> job;
+	};
+	void freeStages();
+	void finishJob(TailStage &stage);
+	int block_size = 0;
+	ConvolutionSegment* head = nullptr;
+	std::vector<TailStage> tail;
+	std::shared_ptr<powercores::ThreadPool> thread_pool;
 };
 
+//The background threads used by PartitionedConvolver.
+void initializeConvolutionThreads();
+void shutdownConvolutionThreads();
+
 }
\ No newline at end of file
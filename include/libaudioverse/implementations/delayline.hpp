@@ -83,6 +83,28 @@ class DoppleringDelayLine {
 	DoppleringDelayLine* slave = nullptr;
 };
 
+//A delay line read at many delays at once, a block at a time.
+//Every sample is stored twice, so that the block at any delay is contiguous and the reads can use the SIMD kernels.
+class MultiTapDelayLine {
+	public:
+	MultiTapDelayLine(int maxDelay, int blockSize);
+	MultiTapDelayLine(const MultiTapDelayLine& other) = delete;
+	~MultiTapDelayLine();
+	//Append a block.
+	void write(float* input);
+	//Read the last block written, delayed by delay samples.  Fractional delays interpolate linearly.
+	//Delays are clamped to [0, maxDelay].
+	void read(float delay, float* output);
+	//The same, with the delay moving linearly from one value to the other across the block, so that moving taps don't click.
+	void read(float from, float to, float* output);
+	int getMaxDelay();
+	void reset();
+	private:
+	float* buffer = nullptr;
+	//The buffer holds 2*length samples.  write_position is where the next sample goes.
+	int max_delay = 0, block_size = 0, length = 0, write_position = 0;
+};
+
 class InterpolatedDelayLine {
 	public:
 	InterpolatedDelayLine(float maxDelay, float sr);
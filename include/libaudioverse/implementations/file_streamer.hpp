@@ -7,19 +7,36 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
 #include "../private/file.hpp"
+#include "../private/lock_free_ring.hpp"
+#include "../private/streaming.hpp"
 #include <speex_resampler_cpp.hpp>
 #include <memory>
 #include <algorithm>
 #include <string>
+#include <atomic>
 #include <inttypes.h>
 
 namespace libaudioverse_implementation {
 
-/**This is a lot like a BufferPlayer, but channels matches the file always and we resample at run-time.*/
+//Each call to the reader asks for at most this many frames.
+const int file_streamer_read_frames = 4096;
+//A stream is only read for once it has room for this fraction of its prefetch.
+const int file_streamer_refill_divisor = 4;
 
+/**This is a lot like a BufferPlayer, but channels matches the file always and we resample at run-time.
+
+The file is only ever touched by the server's StreamingScheduler, whose I/O threads keep a ring of decoded frames prefetch seconds ahead of playback.
+The audio thread reads from the ring, and plays silence and counts an underrun if it's empty.
+
+Seeking is a flush: the audio thread asks for one and plays silence until an I/O thread has seeked and said where in the ring the new data starts.
+The audio thread then drops everything before that point.
+Growing the prefetch past what the ring holds is also a flush, and the I/O thread makes a new ring while the audio thread isn't reading.
+
+The scheduler never has two threads in service at once for the same streamer, so everything only the I/O side touches needs no locking.
+Streamers are destroyed with StreamingScheduler::retireStream, never directly, so that nothing waits for a read in progress.*/
 class FileStreamer {
 	public:
-	FileStreamer(std::string path, int _block_size, float _sr);
+	FileStreamer(std::string path, int _block_size, float _sr, std::shared_ptr<StreamingScheduler> _scheduler);
 	~FileStreamer();
 	void process(float** outputs);
 	void setPosition(double position);
@@ -32,17 +49,54 @@ class FileStreamer {
 	//This last fact is important for the node's process method.
 	bool getEnded();
 	int getChannels();
+	//In seconds of the file.
+	void setPrefetch(double seconds);
+	//Blocks in which the ring ran dry.
+	int getUnderruns();
+	float getFileSr();
+	//These are for the scheduler.
+	//Seconds of audio left in the ring, or -1 if a seek is waiting.
+	//Playback always consumes file_sr frames a second, since the resampler only converts rates.
+	double getDeadline();
+	//How long until the ring has enough room to be worth reading for; 0 or less if now.
+	double getSecondsUntilService();
+	//Handle any flush and read until the ring holds enough.  Returns the frames read.
+	int service();
 	private:
 	void feedResampler();
+	//Ask the I/O thread to seek to frame, with a ring holding capacity samples.
+	void requestFlush(int64_t frame, int capacity);
+	//Frames the ring could take without going past the prefetch.  Only for the I/O side.
+	int getRoom();
 	int block_size = 0;
 	float sr = 0.0f;
 	FileReader reader;
 	std::shared_ptr<speex_resampler_cpp::Resampler> resampler = nullptr;
 	float *workspace_before_resampling = nullptr, *workspace_after_resampling = nullptr;
+	//Where the I/O thread reads to.
+	float* read_workspace = nullptr;
 	int channels = 0;
-	double position = 0.0, duration  = 0.0, position_per_sample = 0.0;
+	int64_t frame_count = 0;
+	float file_sr = 0.0f;
+	double duration  = 0.0;
+	//The frame of the file the next frame from the ring came from.
 	int64_t position_in_frames = 0;
-	bool is_looping = false, ended_before_resampling = false, ended_after_resampling = false;
+	std::atomic<bool> is_looping{false};
+	bool ended_before_resampling = false, ended_after_resampling = false;
+	bool at_end = false;
+	//Replaced only by the I/O thread, and only during a flush.
+	LockFreeRing<float>* ring = nullptr;
+	std::atomic<int> prefetch_frames{0};
+	//The flush protocol.  The audio thread increments requested_flush; the I/O thread copies it to acknowledged_flush when done.
+	std::atomic<long long> requested_flush{0}, acknowledged_flush{0};
+	std::atomic<int64_t> flush_frame{0};
+	//The audio thread reads this instead of the ring's capacity, since the ring may be being replaced.
+	std::atomic<int> flush_capacity{0};
+	//Positions in the ring where the data after the last flush starts and where the file ended, if it has.
+	std::atomic<long long> flush_point{0}, end_point;
+	std::atomic<int> underruns{0};
+	//Not owned: the scheduler destroys us, and may do so from one of its threads.
+	StreamingScheduler* scheduler = nullptr;
 };
 
-}
\ No newline at end of file
+}
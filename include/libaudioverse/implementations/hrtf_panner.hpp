@@ -13,8 +13,18 @@ carrying such notice may not be copied, modified, or distributed except accordin
 
 namespace libaudioverse_implementation {
 
-//Implement HRTF panning.
+class FftPlan;
 
+//Hrirs at least this long are convolved in the frequency domain.
+const int hrtf_panner_fft_threshold = 64;
+
+/**Implement HRTF panning.
+
+Short hrirs are convolved in the time domain.
+Long ones use overlap-save with the hrir spectra precomputed by HrtfData, so each block costs one input fft shared by both ears and one inverse fft per ear.
+Crossfades mix the outputs of the old and new spectra, which costs two more inverse ffts.
+If the HrtfData has a precomputed grid, directions snap to it and nothing is recomputed until a source crosses to another point, which always crossfades.
+If the HrtfData is minimum phase, the interaural delay is applied to each ear's output by a fractional delay line.*/
 class HrtfPanner {
 	public:
 	HrtfPanner(int _block_size, float _sr, std::shared_ptr<HrtfData> hrtf);
@@ -32,9 +42,30 @@ class HrtfPanner {
 	void setCrossfadeThreshold(float threshold);
 	float getCrossfadeThreshold();
 	private:
+	void panTimeDomain(float* input, float* left_output, float* right_output, bool moved, bool needsCrossfade);
+	void panFrequencyDomain(float* input, float* left_output, float* right_output, bool moved, bool needsCrossfade);
+	//Give the time-domain convolvers the responses for the current direction.
+	void setResponses();
+	//The same for the frequency-domain path.
+	void setSpectra();
+	void computeDelays();
+	//Delay buffer in place, moving linearly from one delay in samples to the other.
+	void delay(DelayRingbuffer &line, float from, float to, float* buffer);
 	std::shared_ptr<HrtfData> hrtf;
 	//Convolvers, current and previous.
-	BlockConvolver *left_convolver, *right_convolver, *prev_left_convolver, *prev_right_convolver;
+	BlockConvolver *left_convolver = nullptr, *right_convolver = nullptr, *prev_left_convolver = nullptr, *prev_right_convolver = nullptr;
+	//The frequency-domain path.  History is the last fft_size samples of input.
+	bool use_fft = false;
+	int fft_size = 0;
+	std::shared_ptr<HrtfSpectra> spectra;
+	std::shared_ptr<FftPlan> fft, ifft;
+	float* history = nullptr;
+	kiss_fft_cpx *left_spectrum = nullptr, *right_spectrum = nullptr, *prev_left_spectrum = nullptr, *prev_right_spectrum = nullptr;
+	//Only present for minimum-phase hrtfs.
+	DelayRingbuffer *left_delay_line = nullptr, *right_delay_line = nullptr;
+	float left_delay = 0.0f, right_delay = 0.0f, prev_left_delay = 0.0f, prev_right_delay = 0.0f;
+	//Grid points of the current responses, if the HrtfData has a grid.
+	int left_grid_index = -1, right_grid_index = -1;
 	int block_size;
 	int response_length;
 	float sr;
@@ -78,6 +78,7 @@ enum Lav_ERRORS {
 
 	Lav_ERROR_CANNOT_CONNECT_TO_PROPERTY,
 	Lav_ERROR_BUFFER_IN_USE,
+	Lav_ERROR_BUFFER_LOADING,
 	
 	Lav_ERROR_INTERNAL= 999,
 };
@@ -151,6 +152,21 @@ enum Lav_NODE_STATES {
 	Lav_NODESTATE_ALWAYS_PLAYING,
 };
 
+/**The states of a buffer being loaded asynchronously.*/
+enum Lav_BUFFER_LOAD_STATES {
+	Lav_BUFFER_LOAD_STATE_READY,
+	Lav_BUFFER_LOAD_STATE_LOADING,
+	Lav_BUFFER_LOAD_STATE_FAILED,
+};
+
+/**How buffers store their samples.*/
+enum Lav_BUFFER_STORAGE_FORMATS {
+	Lav_BUFFER_STORAGE_FORMAT_FLOAT,
+	Lav_BUFFER_STORAGE_FORMAT_INT16,
+	Lav_BUFFER_STORAGE_FORMAT_HALF,
+	Lav_BUFFER_STORAGE_FORMAT_ADPCM,
+};
+
 /**Logging levels.*/
 enum Lav_LOGGING_LEVELS {
 	Lav_LOGGING_LEVEL_CRITICAL = 10,
@@ -201,6 +217,21 @@ This exists only for bindings.  If you use this in your C program, you may have
 typedef void (*LavHandleDestroyedCallback)(LavHandle which);
 Lav_PUBLIC_FUNCTION LavError Lav_setHandleDestroyedCallback(LavHandleDestroyedCallback cb);
 
+/**Memory to spend on precomputed HRTF grids, in kilobytes.  0 turns them off.*/
+Lav_PUBLIC_FUNCTION LavError Lav_setHrtfGridBudget(int kilobytes);
+Lav_PUBLIC_FUNCTION LavError Lav_getHrtfGridBudget(int* destination);
+/**Split HRTF responses into minimum-phase responses of this many taps and an interaural delay.  0 turns this off.*/
+Lav_PUBLIC_FUNCTION LavError Lav_setHrtfMinimumPhaseLength(int length);
+Lav_PUBLIC_FUNCTION LavError Lav_getHrtfMinimumPhaseLength(int* destination);
+/**Save and load precomputed HRTF data, so that later runs don't need to parse and resample.*/
+Lav_PUBLIC_FUNCTION LavError Lav_saveHrtfCache(const char* hrtfPath, int sr, const char* cachePath);
+Lav_PUBLIC_FUNCTION LavError Lav_loadHrtfCache(const char* cachePath);
+/**Buffers loaded from the same file share decoded data.  The budget is memory for files no buffer is using, in kilobytes.*/
+Lav_PUBLIC_FUNCTION LavError Lav_setAssetCacheBudget(int kilobytes);
+Lav_PUBLIC_FUNCTION LavError Lav_getAssetCacheBudget(int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_getAssetCacheStats(int* hits, int* misses, int* kilobytes);
+Lav_PUBLIC_FUNCTION LavError Lav_resetAssetCacheStats();
+
 Lav_PUBLIC_FUNCTION LavError Lav_deviceGetCount(unsigned int* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_deviceGetName(unsigned int index, char** destination);
 Lav_PUBLIC_FUNCTION LavError Lav_deviceGetIdentifierString(unsigned int index, char** destination);
@@ -224,6 +255,11 @@ Lav_PUBLIC_FUNCTION LavError Lav_serverWriteFile(LavHandle serverHandle, const c
 
 Lav_PUBLIC_FUNCTION LavError Lav_serverSetThreads(LavHandle serverHandle, int threads);
 Lav_PUBLIC_FUNCTION LavError Lav_serverGetThreads(LavHandle serverHandle, int* destination);
+/**File streamers read on a small pool of threads shared by the whole server.*/
+Lav_PUBLIC_FUNCTION LavError Lav_serverSetStreamingThreads(LavHandle serverHandle, int threads);
+Lav_PUBLIC_FUNCTION LavError Lav_serverGetStreamingThreads(LavHandle serverHandle, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_serverGetStreamingStats(LavHandle serverHandle, int* streams, double* throughput, double* latency, double* maxLatency, int* underruns);
+Lav_PUBLIC_FUNCTION LavError Lav_serverResetStreamingStats(LavHandle serverHandle);
 
 Lav_PUBLIC_FUNCTION LavError Lav_serverCallIn(LavHandle serverHandle, double when, int inAudioThread, LavTimeCallback cb, void* userdata);
 
@@ -232,11 +268,27 @@ Buffers are chunks of audio data from any source.  A variety of nodes to work wi
 Lav_PUBLIC_FUNCTION LavError Lav_createBuffer(LavHandle serverHandle, LavHandle* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferGetServer(LavHandle bufferHandle, LavHandle* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFile(LavHandle bufferHandle, const char* path);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFilePaged(LavHandle bufferHandle, const char* path);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromArray(LavHandle bufferHandle, int sr, int channels, int frames, float* data);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferDecodeFromArray(LavHandle bufferHandle, char* data, int datalen);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferNormalize(LavHandle bufferHandle);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferGetDuration(LavHandle bufferHandle, float* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLengthInSamples(LavHandle bufferHandle, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferSetStorageFormat(LavHandle bufferHandle, int format);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetStorageFormat(LavHandle bufferHandle, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetSizeInBytes(LavHandle bufferHandle, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetUnderruns(LavHandle bufferHandle, int* destination);
+/**Load and decode on a pool of loader threads.  The callback runs on the server's background thread when loading finishes, with the error if it failed.*/
+typedef void (*LavBufferLoadedCallback)(LavHandle bufferHandle, LavError error, void* userdata);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFileAsync(LavHandle bufferHandle, const char* path, LavBufferLoadedCallback callback, void* userdata);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferDecodeFromArrayAsync(LavHandle bufferHandle, char* data, int datalen, LavBufferLoadedCallback callback, void* userdata);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLoadState(LavHandle bufferHandle, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLoadError(LavHandle bufferHandle, LavError* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferSetPlaysWhileLoading(LavHandle bufferHandle, int playsWhileLoading);
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetPlaysWhileLoading(LavHandle bufferHandle, int* destination);
+/**The number of threads which load buffers for the asynchronous functions, shared by every server.*/
+Lav_PUBLIC_FUNCTION LavError Lav_setBufferLoaderThreads(int threads);
+Lav_PUBLIC_FUNCTION LavError Lav_getBufferLoaderThreads(int* destination);
 
 Lav_PUBLIC_FUNCTION LavError Lav_nodeGetServer(LavHandle nodeHandle, LavHandle* destination);
 
@@ -376,6 +428,7 @@ Lav_PUBLIC_FUNCTION LavError Lav_createLeakyIntegratorNode(LavHandle serverHandl
 
 Lav_PUBLIC_FUNCTION LavError Lav_createFileStreamerNode(LavHandle serverHandle, const char* path, LavHandle* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_fileStreamerNodeSetEndCallback(LavHandle nodeHandle, LavParameterlessCallback callback, void* userdata);
+Lav_PUBLIC_FUNCTION LavError Lav_fileStreamerNodeGetStreamingStats(LavHandle nodeHandle, double* throughput, double* latency, double* maxLatency, int* underruns);
 
 #ifdef __cplusplus
 }
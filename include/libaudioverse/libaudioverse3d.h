@@ -13,7 +13,12 @@ extern "C" {
 
 Lav_PUBLIC_FUNCTION LavError Lav_createEnvironmentNode(LavHandle serverHandle, const char*hrtfPath, LavHandle* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_environmentNodePlayAsync(LavHandle nodeHandle, LavHandle bufferHandle, float x, float y, float z, int isDry);
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodePlayAsyncBatch(LavHandle nodeHandle, int count, LavHandle* bufferHandles, float* positions, int isDry);
 Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeAddEffectSend(LavHandle nodeHandle, int channels, int isReverb, int connectByDefault, int* destination);
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeGetVoiceCounts(LavHandle nodeHandle, int* realVoices, int* virtualVoices);
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeAddListener(LavHandle nodeHandle, int panningStrategy, int* listenerIndex, int* outputIndex);
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeSetListenerPosition(LavHandle nodeHandle, int listener, float x, float y, float z);
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeSetListenerOrientation(LavHandle nodeHandle, int listener, float atX, float atY, float atZ, float upX, float upY, float upZ);
 
 Lav_PUBLIC_FUNCTION LavError Lav_createSourceNode(LavHandle serverHandle, LavHandle environmentHandle, LavHandle* destination);
 Lav_PUBLIC_FUNCTION LavError Lav_sourceNodeFeedEffect(LavHandle nodeHandle, int effect);
@@ -33,6 +38,15 @@ enum lav_STANDARD_ENVIRONMENT_PROPERTIES {
 	Lav_ENVIRONMENT_MAX_REVERB_LEVEL,
 	Lav_ENVIRONMENT_POSITION ,
 	Lav_ENVIRONMENT_ORIENTATION,
+	Lav_ENVIRONMENT_AMBISONIC_ORDER = 2,
+	Lav_ENVIRONMENT_MAX_DIRECT_SOURCES,
+	Lav_ENVIRONMENT_MAX_VOICES,
+	Lav_ENVIRONMENT_VOICE_POOL_SIZE,
+	Lav_ENVIRONMENT_ROOM_ORIGIN,
+	Lav_ENVIRONMENT_ROOM_SIZE,
+	Lav_ENVIRONMENT_REFLECTION_ORDER,
+	Lav_ENVIRONMENT_WALL_REFLECTIVITY,
+	Lav_ENVIRONMENT_MAX_REFLECTIONS,
 };
 
 enum Lav_SOURCE_PROPERTIES {
@@ -50,6 +64,7 @@ enum Lav_SOURCE_PROPERTIES {
 	Lav_SOURCE_CONTROL_REVERB,
 	Lav_SOURCE_POSITION,
 	Lav_SOURCE_ORIENTATION,
+	Lav_SOURCE_PRIORITY,
 };
 
 enum Lav_DISTANCE_MODELS {
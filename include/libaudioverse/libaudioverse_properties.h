@@ -216,6 +216,20 @@ enum Lav_FILE_STREAMER_PROPERTIES {
 	Lav_FILE_STREAMER_POSITION = -1,
 	Lav_FILE_STREAMER_LOOPING = -2,
 	Lav_FILE_STREAMER_ENDED= -3,
+	Lav_FILE_STREAMER_PREFETCH = -4,
+	Lav_FILE_STREAMER_UNDERRUNS = -5,
+};
+
+enum Lav_RECORDER_PROPERTIES {
+	Lav_RECORDER_FORMAT = -1,
+	Lav_RECORDER_BUFFER_LENGTH = -2,
+	Lav_RECORDER_OVERFLOWS = -3,
+};
+
+enum Lav_RECORDING_FORMATS {
+	Lav_RECORDING_FORMAT_PCM16 = 0,
+	Lav_RECORDING_FORMAT_PCM24 = 1,
+	Lav_RECORDING_FORMAT_FLOAT = 2,
 };
 
 #ifdef __cplusplus
@@ -24,8 +24,14 @@ class BufferNode: public Node {
 	void positionChanged();
 	void bufferChanged();
 	virtual void process();
+	void skipBlocks(int blocks) override;
+	//Waits for a buffer which was still loading when we got it, then has the task thread pick it up.
+	void willTick() override;
 	BufferPlayer player;
 	std::shared_ptr<Callback<void()>> end_callback;
+	private:
+	//We only register for willTick the first time we get a loading buffer.
+	bool waiting_for_load = false, registered_for_will_tick = false;
 };
 
 std::shared_ptr<Node> createBufferNode(std::shared_ptr<Server> server);
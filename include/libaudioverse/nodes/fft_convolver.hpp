@@ -12,7 +12,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 namespace libaudioverse_implementation {
 
 class Server;
-class FftConvolver;
+class PartitionedConvolver;
 
 class FftConvolverNode: public Node {
 	public:
@@ -22,7 +22,7 @@ class FftConvolverNode: public Node {
 	void setResponse(int channel, int length, float* response);
 	void setResponseFromFile(std::string path, int fileChannel, int convolverChannel);
 	int channels;
-	FftConvolver **convolvers;
+	PartitionedConvolver **convolvers;
 };
 
 std::shared_ptr<Node> createFftConvolverNode(std::shared_ptr<Server> server, int channels);
@@ -20,9 +20,11 @@ class Server;
 class FileStreamerNode: public Node {
 	public:
 	FileStreamerNode(std::shared_ptr<Server> server, std::string path);
+	~FileStreamerNode();
 	void positionChanged();
 	virtual void process() override;
-	FileStreamer streamer;
+	//Given to the scheduler to destroy when we die.
+	FileStreamer* streamer = nullptr;
 	std::shared_ptr<Callback<void()>> end_callback;
 };
 
@@ -8,31 +8,41 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #pragma once
 #include "../private/node.hpp"
 #include "../private/file.hpp"
-#include <powercores/threadsafe_queue.hpp>
+#include "../private/lock_free_ring.hpp"
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <memory>
 
 namespace libaudioverse_implementation {
 
 class Server;
 
+//The writer thread takes at most this many frames from the ring at once.
+const int recorder_write_frames = 4096;
+//Stopping waits at most this many seconds for what's left in the ring to be written.
+const double recorder_max_stop_wait = 0.1;
+
+/**Records through a ring of buffer_length seconds, which is made when recording starts.
+The audio thread only copies into the ring; if the writer thread falls so far behind that it's full, the block is dropped and counted as an overflow.
+The writer thread does the conversion to the file's format.*/
 class RecorderNode: public Node {
 	public:
 	RecorderNode(std::shared_ptr<Server> server, int channels);
 	~RecorderNode();
 	void recordingThreadFunction();
 	virtual void process() override;
-	virtual void doMaintenance() override;
 	void startRecording(std::string path);
 	void stopRecording();
 	std::thread recording_thread;
-	powercores::ThreadsafeQueue<float*> available_buffers;
-	powercores::ThreadsafeQueue<float*> unwritten_buffers;
-	int buffer_size = 0;
-	int buffer_freeing_threshold =20; //If we ever get this far ahead, we free some buffers.
+	LockFreeRing<float>* ring = nullptr;
+	//Where the audio thread interleaves to, and where the writer thread reads to.
+	float* block_workspace = nullptr, *write_workspace = nullptr;
 	std::atomic_flag should_keep_recording;
+	//Set before should_keep_recording is cleared, which publishes it to the writer thread.
+	std::chrono::steady_clock::time_point stop_deadline;
+	int overflows = 0;
 	FileWriter recording_to;
 	int channels = 0;
 	bool recording = false;
@@ -0,0 +1,34 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include <memory>
+#include <string>
+
+namespace libaudioverse_implementation {
+
+class BufferData;
+
+/**The process-wide cache of decoded files, keyed by path, modification time, sampling rate, and storage format.
+
+Buffers loaded from the same file at the same rate share one copy of the data.
+Entries which some buffer is using are always kept.
+The budget is how much memory may go to entries nothing is using, which are forgotten least recently used first.
+Everything here is safe to call from any thread.*/
+void initializeAssetCache();
+void shutdownAssetCache();
+//Decode path at sr in format, or return the copy we already have.
+std::shared_ptr<BufferData> loadAsset(const std::string &path, int sr, int format);
+//Forget unused entries until within budget.  Buffers call this when they let go of cached data.
+void trimAssetCache();
+void setAssetCacheBudget(size_t bytes);
+size_t getAssetCacheBudget();
+//bytes is the size of everything in the cache, used or not.
+void getAssetCacheStats(int* hits, int* misses, size_t* bytes);
+void resetAssetCacheStats();
+
+}
@@ -7,12 +7,49 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
 #include "memory.hpp"
+#include "../libaudioverse.h"
 #include <memory>
 #include <atomic>
+#include <functional>
+#include <stdint.h>
 
 
 namespace libaudioverse_implementation {
 class Server;
+class PagedAudio;
+
+/**Uninterleaved audio, in one of the storage formats.
+Never modified once made, so that buffers loaded from the same file can share it through the asset cache.*/
+class BufferData {
+	public:
+	//Takes ownership of data, which must come from new[].
+	BufferData(int channels, int frames, float* data);
+	//Encode source, which must be float, in format.
+	BufferData(const BufferData &source, int format);
+	//Read from paged as needed.  Paged data is always float, and stays paged whatever the storage format.
+	BufferData(std::shared_ptr<PagedAudio> paged);
+	~BufferData();
+	BufferData(const BufferData&) = delete;
+	size_t getSize();
+	//Decode count frames of channel starting at frame.  This works for every format, but float data can be read directly.
+	void decode(int channel, int frame, int count, float* destination);
+	//Slow for ADPCM, which has to decode from the start of a block.
+	float getSample(int frame, int channel);
+	int format = Lav_BUFFER_STORAGE_FORMAT_FLOAT;
+	int channels = 0, frames = 0;
+	//Only the one for format is used.  Half-floats are stored as their bits.
+	float* data = nullptr;
+	int16_t* int16_data = nullptr;
+	uint16_t* half_data = nullptr;
+	unsigned char* adpcm_data = nullptr;
+	int adpcm_blocks = 0; //Per channel.
+	std::shared_ptr<PagedAudio> paged;
+};
+
+//Resample interleaved audio to outputSr and uninterleave it.  This is the slow part of loading a buffer.
+std::shared_ptr<BufferData> makeBufferData(int inputSr, int outputSr, int channels, int frames, float* interleaved);
+//Get source in format, going through float if need be.  Returns source if it's already in format.
+std::shared_ptr<BufferData> convertBufferData(std::shared_ptr<BufferData> source, int format);
 
 class Buffer: public ExternalObject {
 	public:
@@ -24,18 +61,34 @@ class Buffer: public ExternalObject {
 	int getChannels();
 	//This can be used outside the lock; the only thing it does is read server's sr value which can never change by definition.
 	void loadFromArray(int sr, int channels, int frames, float* inputData);
-	//The following two functions do not check if the requested frame is past the end for efficiency.
+	//Use data from the asset cache, which must be at the server's sampling rate and in our storage format.
+	void loadFromAsset(std::shared_ptr<BufferData> asset);
+	void loadPaged(std::shared_ptr<PagedAudio> paged);
+	//The following functions do not check if the requested frame is past the end for efficiency.
 	//It is possible the compiler would optimize this, but running  in debug mode is already really painful and the trade-off here is worth it.
 	//a single sample without mixing:
 	float getSample(int frame, int channel);
-	//Get a pointer to part of the buffer, so that we can memcpy and stuff.
+	//Get a pointer to part of the buffer, so that we can memcpy and stuff.  Only if isDirect.
 	float* getPointer(int frame, int channel);
+	//True if the samples are float and in memory, so that getPointer works.
+	bool isDirect();
+	//Decode part of a channel, for the other storage formats and paged buffers.
+	void decode(int channel, int frame, int count, float* destination);
+	//Players of paged buffers call this every block, so that what they need next is decoded ahead of time.
+	void prefetch(int frame, bool looping);
+	//One of the Lav_BUFFER_STORAGE_FORMATS.  Setting this converts what the buffer already holds.
+	int getStorageFormat();
+	void setStorageFormat(int format);
+	//Bytes used by the samples.
+	size_t getSize();
+	//For paged buffers, how many reads found audio not yet decoded.  0 otherwise.
+	int getUnderruns();
 	//meet lockable concept:
 	void lock();
 	void unlock();
 
 	//Normalize the buffer: divide by the sample furthest from zero.
-	//This can't be undone.
+	//This can't be undone.  Shared data is copied first, so other buffers are unaffected.
 	void normalize();
 	
 	//Lock and unlock the user's ability to change the buffer's contents.
@@ -43,15 +96,48 @@ class Buffer: public ExternalObject {
 	void incrementUseCount();
 	void decrementUseCount();
 	void throwIfInUse();
+	
+	//Asynchronous loading.  While loading, the buffer is empty and can't be modified.
+	//Call beginLoading with the lock held, then loadFromArray and finishLoading from any thread.
+	void beginLoading();
+	void finishLoading(LavError error);
+	bool isLoading();
+	int getLoadState();
+	LavError getLoadError();
+	void setPlaysWhileLoading(bool p);
+	bool getPlaysWhileLoading();
+	void throwIfLoading();
+	//For buffer nodes and playAsync, which play silence until loaded if asked to.
+	void throwIfCannotPlay();
 	private:
+	//Call with the lock held.  from_cache says whether to let the asset cache know when we let go of it.
+	void setContents(std::shared_ptr<BufferData> newContents, bool fromCache);
+	//channels, frames, and data mirror contents, to keep getSample and getPointer cheap.
+	//data is null unless contents are float.
 	int channels = 0;
 	int frames = 0;
 	int sr = 0;
 	float* data = nullptr;
+	std::shared_ptr<BufferData> contents;
+	bool contents_from_cache = false;
 	std::shared_ptr<Server> server;
 	std::atomic<int> use_count{0};
+	std::atomic<int> load_state{Lav_BUFFER_LOAD_STATE_READY};
+	LavError load_error = Lav_ERROR_NONE;
+	std::atomic<bool> plays_while_loading{true};
+	//Read by asynchronous loads, which can't overlap a change.
+	std::atomic<int> storage_format{Lav_BUFFER_STORAGE_FORMAT_FLOAT};
 };
 
 std::shared_ptr<Buffer> createBuffer(std::shared_ptr<Server>server);
 
+//The pool of threads behind the asynchronous loading functions, shared by all servers.
+void initializeBufferLoader();
+void shutdownBufferLoader();
+void setBufferLoaderThreads(int threads);
+int getBufferLoaderThreads();
+//Run load on the pool, then mark the buffer loaded and call callback on the server's background thread.
+//load should throw on failure.
+void loadBufferAsync(std::shared_ptr<Buffer> buffer, std::function<void(Buffer&)> load, LavBufferLoadedCallback callback, void* userdata);
+
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include <kiss_fft.h>
+#include <memory>
+
+namespace libaudioverse_implementation {
+
+/**A real fft of a given size and direction.
+
+All frequency-domain code goes through this interface rather than calling an fft library.
+Spectra are size/2+1 kiss_fft_cpx, laid out as kiss_fftr lays them out, and inverse transforms are not normalized.
+
+Plans keep no per-call state, so one plan may be used from any number of threads at once.
+Get plans from getFftPlan, which shares them process-wide and picks the fastest backend for the size.*/
+class FftPlan {
+	public:
+	FftPlan(int size, bool inverse): size(size), inverse(inverse) {}
+	virtual ~FftPlan() {}
+	//size real samples in, size/2+1 complex bins out.  Forward plans only.
+	virtual void fft(const float* input, kiss_fft_cpx* output) = 0;
+	//size/2+1 complex bins in, size real samples out.  Inverse plans only.
+	virtual void ifft(const kiss_fft_cpx* input, float* output) = 0;
+	int getSize() {return size;}
+	bool isInverse() {return inverse;}
+	protected:
+	int size;
+	bool inverse;
+};
+
+/**The backends.
+These don't validate their arguments and aren't cached; they exist separately so they can be benchmarked against each other.
+The kissfft backend handles any even size.
+The SSE backend handles sizes of 2^a*3^b*5^c which are multiples of 32, and returns nullptr for anything else or if built without SSE2.*/
+std::shared_ptr<FftPlan> createKissFftPlan(int size, bool inverse);
+std::shared_ptr<FftPlan> createSseFftPlan(int size, bool inverse);
+
+//Size must be even.  Thread safe.
+std::shared_ptr<FftPlan> getFftPlan(int size, bool inverse);
+//The smallest size at least minimum for which getFftPlan gives a fast plan.
+int nextFastFftSize(int minimum);
+
+void initializeFftPlanCache();
+void shutdownFftPlanCache();
+
+}
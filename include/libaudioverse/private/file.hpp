@@ -7,6 +7,7 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
 #include <sndfile.h>
+#include "../libaudioverse_properties.h"
 #include <inttypes.h>
 #include <cstddef>
 #include <memory>
@@ -54,7 +55,8 @@ class FileWriter {
 	public:
 	FileWriter(): info() {}
 	~FileWriter();
-	void open(const char* path, int sr, int channels);
+	//The container comes from the extension: wav, caf, flac, or ogg.  Format is from Lav_RECORDING_FORMATS, and is ignored for ogg.
+	void open(const char* path, int sr, int channels, int format = Lav_RECORDING_FORMAT_PCM16);
 	void close();
 	float getSr();
 	unsigned int getChannelCount();
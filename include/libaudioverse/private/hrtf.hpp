@@ -7,12 +7,33 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
 #include <powercores/thread_local_variable.hpp>
+#include <kiss_fft.h>
 #include <string>
 #include <memory>
-#include <kiss_fftr.h>
+#include <map>
+#include <mutex>
+#include <stddef.h>
 
 namespace libaudioverse_implementation {
 
+/**Spectra of every measured hrir, zero-padded to one fft size and stored one after the other.
+If the HrtfData has a grid, the spectra of the grid's responses follow in grid_spectra, so that moving between points is a copy.
+These are a good deal larger than the grid itself, since fft_size covers a block as well as a response.
+These are shared by every frequency-domain HrtfPanner using that size.  Get them from HrtfData::getSpectra.*/
+class HrtfSpectra {
+	public:
+	HrtfSpectra(int fftSize, int hrirCount, int gridPoints);
+	~HrtfSpectra();
+	int fft_size, bin_count;
+	kiss_fft_cpx* spectra = nullptr, *grid_spectra = nullptr;
+};
+
+//One of the measured responses contributing to a direction, and how much.
+struct HrtfTap {
+	int elevation, azimuth;
+	float weight;
+};
+
 class HrtfData {
 	public:
 	HrtfData();
@@ -23,29 +44,106 @@ class HrtfData {
 	//warning: writes directly to the output destination, doesn't allocate a new one.
 	void computeCoefficientsStereo(float elevation, float azimuth, float* left, float* right);
 
+	//Spectra of the measured hrirs for an fft size at least getLength()+1, computed on first use and kept for the life of this HrtfData.
+	//Keeping them means that only the first panner of a size pays for the ffts.
+	//Threadsafe, but slow the first time; don't call it from the audio thread.
+	std::shared_ptr<HrtfSpectra> getSpectra(int fftSize);
+	//The frequency-domain equivalent of computeCoefficientsStereo: the interpolation is linear, so blending spectra gives the spectrum of the blended hrir.
+	//left and right need spectra->bin_count entries.
+	void computeSpectraStereo(HrtfSpectra* spectra, float elevation, float azimuth, kiss_fft_cpx* left, kiss_fft_cpx* right);
+
 	//load from a file.
 	void loadFromFile(std::string path, unsigned int forSr);
 	void loadFromDefault(unsigned int forSr);
 	void loadFromBuffer(unsigned int length, char* buffer, unsigned int forSr);
 
+	/**The on-disk cache holds everything loadFromBuffer and convertToMinimumPhase compute, for one sample rate.
+	identity is the 16-byte id of the source file.
+	Loading maps the file and uses the responses in place, so there's no parsing or resampling.*/
+	void saveToCache(std::string path, const char* identity);
+	//identity receives the id of the source file.
+	void loadFromCache(std::string path, char* identity);
+	int getSr();
+	//The length passed to convertToMinimumPhase, or 0.
+	int getMinimumPhaseLength();
+
 	//get the hrir's length.
 	int getLength();
+
+	/**Split every hrir into a minimum-phase response of at most length taps and a fractional onset delay.
+	Most of a measured hrir's length is the interaural delay as leading zeros, so this lets panners convolve with far fewer taps and apply the delay with a delay line.
+	Like buildGrid, call this before sharing the HrtfData; call it before buildGrid so that the grid holds the new responses.*/
+	void convertToMinimumPhase(int length);
+	//True after convertToMinimumPhase.  Without delays, they are included in the responses.
+	bool hasDelays();
+	//The largest delay, in samples.
+	float getMaxDelay();
+	//The delay, in samples, that goes with the responses from computeCoefficientsStereo.
+	void computeDelaysStereo(float elevation, float azimuth, float* left, float* right);
+
+	/**The optional precomputed grid.
+	This holds right-ear responses already interpolated at regular points, one after the other, so that a direction becomes a table read.
+	buildGrid picks the finest resolution whose responses fit in budget bytes, and returns false if none do.
+	It isn't threadsafe with respect to lookups, so call it before sharing this HrtfData.*/
+	bool buildGrid(size_t budget);
+	bool hasGrid();
+	//Index of the grid point nearest to each ear's direction.  Equal indices mean identical responses.
+	void computeGridIndicesStereo(float elevation, float azimuth, int* left, int* right);
+	//hrir_length samples, owned by this HrtfData.
+	float* getGridResponse(int index);
+	//The spectrum of getGridResponse(index), spectra->bin_count entries.
+	kiss_fft_cpx* getGridSpectrum(HrtfSpectra* spectra, int index);
+	float getGridDelay(int index);
 	private:
+	int computeGridIndex(float elevation, float azimuth);
+	void allocateSlab();
+	float* getHrir(int elevation, int azimuth);
+	float computeDelayMono(float elevation, float azimuth);
+	//Fills taps with the 4 measured responses to blend for this direction, for the right ear.
+	void computeTaps(float elevation, float azimuth, HrtfTap* taps);
+	void computeSpectraMono(HrtfSpectra* spectra, float elevation, float azimuth, kiss_fft_cpx* out);
 	float* createTemporaryBuffer();
 	void freeTemporaryBuffer(float* b);
 	int elev_count = 0, hrir_count = 0, hrir_length = 0;
 	int min_elevation = 0, max_elevation = 0;
 	int *azimuth_counts = nullptr;
+	//Index of the first response of each elevation, counting responses in file order.
+	int *elevation_offsets = nullptr;
 	int samplerate = 0;
-	float ***hrirs = nullptr;
+	//Every hrir in one allocation, in file order.  Each starts hrir_stride floats after the last, on a cache line boundary.
+	float *hrir_slab = nullptr, *hrir_allocation = nullptr;
+	int hrir_stride = 0;
+	//Onset delays in samples, one per hrir, if split off by convertToMinimumPhase.
+	float* delays = nullptr;
+	float max_delay = 0.0f;
+	int minimum_phase_length = 0;
+	//If we came from the on-disk cache, this keeps the file mapped under hrir_slab.
+	std::shared_ptr<void> cache_mapping;
+	//The grid, in degrees.  Points run over azimuth, then elevation from min_elevation upward.
+	int grid_elevation_step = 0, grid_azimuth_step = 0, grid_elevation_count = 0, grid_azimuth_count = 0;
+	float* grid = nullptr, *grid_delays = nullptr;
 	//used for crossfading so we don't clobber the heap.
 	powercores::ThreadLocalVariable<float*> temporary_buffer1, temporary_buffer2;
+	std::map<int, std::shared_ptr<HrtfSpectra>> spectra_cache;
+	std::mutex spectra_mutex;
 };
 
 void initializeHrtfCaches();
 void shutdownHrtfCaches();
 
+//Bytes of precomputed grid to give each HRTF loaded from here on; 0 disables it.
+void setHrtfGridBudget(size_t budget);
+size_t getHrtfGridBudget();
+//Minimum-phase length for HRTFs loaded from here on; 0 keeps the measured responses.
+void setHrtfMinimumPhaseLength(int length);
+int getHrtfMinimumPhaseLength();
+
 //This is threadsafe in and of itself, and will return hrtfs from a cache if it can.
 //Either load from a file or our internal default.
 std::shared_ptr<HrtfData> createHrtfFromString(std::string path, int forSr);
+
+//Write the hrtf that createHrtfFromString would give for path and forSr to an on-disk cache.
+void saveHrtfCache(std::string path, int forSr, std::string cachePath);
+//Load an on-disk cache, so that createHrtfFromString returns it for the file and sample rate it was made from.
+void loadHrtfCache(std::string cachePath);
 }
\ No newline at end of file
@@ -6,6 +6,7 @@ https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 o
 <LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
 carrying such notice may not be copied, modified, or distributed except according to those terms. */
 #pragma once
+#include <stdint.h>
 
 namespace libaudioverse_implementation {
 
@@ -23,6 +24,8 @@ void additionKernel(int length, float* a1, float* a2, float* dest);
 void scalarAdditionKernel(int length, float c, float*a1, float* dest);
 void scalarMultiplicationKernel(int length, float c, float* a1, float* dest);
 void multiplicationKernel(int length, float* a1, float* a2, float* dest);
+//Multiply a1 by a gain moving linearly from start toward end over length samples.
+void gainRampKernel(int length, float start, float end, float* a1, float* dest);
 
 //multiply a1 by c, sum with a2, and store result in dest.
 //a1==dest and a2==dest are, again, safe.
@@ -32,6 +35,17 @@ void multiplicationAdditionKernel(int length, float c, float* a1, float* a2, flo
 //This implies that a1 must be at least 3 elements longer than a2.
 //Note that if a1 and a2 are the same buffers, this will be problematic; if they are, a2-a1 must be greater than 3.
 void parallelMultiplicationAdditionKernel(int length, float c1, float c2, float c3, float c4,  float* a1, float* a2, float* out);
+//As multiplicationAdditionKernel, but the multiplier moves linearly from start toward end over length samples.
+void gainRampMultiplicationAdditionKernel(int length, float start, float end, float* a1, float* a2, float* dest);
+//dest = a1+weight*(a2-a1).  Reading a1 and a2 one sample apart gives a fractional delay.
+void linearInterpolationKernel(int length, float weight, float* a1, float* a2, float* dest);
+
+/**Complex multiplication of spectra stored as interleaved (real, imaginary) pairs, i.e. arrays of kiss_fft_cpx.
+Length is in complex numbers, not floats.
+complexMultiplicationKernel stores a1*a2 in dest and is safe if dest is a1 or a2.
+complexMultiplicationAdditionKernel adds a1*a2 to dest, and dest must not alias either input.*/
+void complexMultiplicationKernel(int length, float* a1, float* a2, float* dest);
+void complexMultiplicationAdditionKernel(int length, float* a1, float* a2, float* dest);
 
 /**The convolution kernel.
 The first response-1 samples of the input buffer are assumed to be a running history, so the actual length of the input buffer needs to be outputSampleCount+responseLength-1.
@@ -56,6 +70,31 @@ This is slow and inefficient.  Frequent calls will cause heap fragmentation.  Th
 Note that this allocates with new[] because it just forwards onto speex_resampler_cpp.*/
 void staticResamplerKernel(int inputSr, int outputSr, int channels, int frames, float* data, int *framesOut, float** dataOut);
 
+/**Conversions for the storage formats of buffers.
+Samples are scaled so that 1.0 is 32767; encoding clamps to [-1, 1].
+
+ADPCM is IMA ADPCM in blocks of adpcm_block_frames samples which can each be decoded alone: the first sample and the step index, followed by 4-bit codes.
+adpcmEncodeKernel encodes one block of at most adpcm_block_frames samples, padding with silence, and carries the step index between blocks through index.
+adpcmDecodeKernel decodes the first length samples of one block.*/
+const int adpcm_block_frames = 256;
+const int adpcm_block_bytes = 4+adpcm_block_frames/2;
+void floatToInt16Kernel(int length, const float* source, int16_t* dest);
+void int16ToFloatKernel(int length, const int16_t* source, float* dest);
+void floatToHalfKernel(int length, const float* source, uint16_t* dest);
+void halfToFloatKernel(int length, const uint16_t* source, float* dest);
+void adpcmEncodeKernel(int length, const float* source, int* index, unsigned char* dest);
+void adpcmDecodeKernel(int length, const unsigned char* source, float* dest);
+
 /**Dot two vectors.*/
 float dotKernel(int length, const float* v1, const float* v2);
+
+/**Kernels for updating many sources at once, operating on positions stored as separate x, y, and z arrays.
+
+transformPointsKernel applies the affine part of a column-major 4x4 matrix, in place.
+atan2Kernel is in radians and approximate, with an error under 1e-5 radians.
+distanceGainKernel computes the gain of each point for the distance model in models, silent past maxDistance.*/
+void transformPointsKernel(int length, const float* matrix, float* x, float* y, float* z);
+void lengthKernel(int length, float* x, float* y, float* z, float* dest);
+void atan2Kernel(int length, float* y, float* x, float* dest);
+void distanceGainKernel(int length, int* models, float* distance, float* referenceDistance, float* maxDistance, float* dest);
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include "memory.hpp"
+#include <atomic>
+#include <algorithm>
+
+namespace libaudioverse_implementation {
+
+/**A fixed-size ring for one producer thread and one consumer thread, which never locks or allocates.
+
+Positions count every item ever written or read, so they only grow.
+This lets the two sides agree on points in the stream, for example where data written after a seek begins.*/
+template<typename T>
+class LockFreeRing {
+	public:
+	LockFreeRing(int capacity);
+	~LockFreeRing();
+	LockFreeRing(const LockFreeRing&) = delete;
+	int getCapacity();
+	//Either side may call these, but the answer may be out of date by the time it's used.
+	long long getReadPosition();
+	long long getWritePosition();
+	//Producer only.  Returns how many were written, which is less than count if the ring fills.
+	int write(const T* source, int count);
+	//Consumer only.  Returns how many were read.
+	int read(T* destination, int count);
+	int getReadAvailable();
+	//Producer only.
+	int getWriteAvailable();
+	//Consumer only: drop everything before position.
+	void skipTo(long long position);
+	//Drop everything.  Only safe when the consumer is known not to be using the ring.
+	void clear();
+	private:
+	T* data = nullptr;
+	int capacity = 0;
+	std::atomic<long long> read_position{0}, write_position{0};
+};
+
+template<typename T>
+LockFreeRing<T>::LockFreeRing(int capacity): capacity(capacity) {
+	data = allocArray<T>(capacity);
+}
+
+template<typename T>
+LockFreeRing<T>::~LockFreeRing() {
+	freeArray(data);
+}
+
+template<typename T>
+int LockFreeRing<T>::getCapacity() {
+	return capacity;
+}
+
+template<typename T>
+long long LockFreeRing<T>::getReadPosition() {
+	return read_position.load(std::memory_order_acquire);
+}
+
+template<typename T>
+long long LockFreeRing<T>::getWritePosition() {
+	return write_position.load(std::memory_order_acquire);
+}
+
+template<typename T>
+int LockFreeRing<T>::write(const T* source, int count) {
+	long long w = write_position.load(std::memory_order_relaxed);
+	long long r = read_position.load(std::memory_order_acquire);
+	count = std::min<int>(count, capacity-(int)(w-r));
+	int start = (int)(w%capacity);
+	int first = std::min(count, capacity-start);
+	std::copy(source, source+first, data+start);
+	std::copy(source+first, source+count, data);
+	write_position.store(w+count, std::memory_order_release);
+	return count;
+}
+
+template<typename T>
+int LockFreeRing<T>::read(T* destination, int count) {
+	long long r = read_position.load(std::memory_order_relaxed);
+	long long w = write_position.load(std::memory_order_acquire);
+	count = std::min<int>(count, (int)(w-r));
+	int start = (int)(r%capacity);
+	int first = std::min(count, capacity-start);
+	std::copy(data+start, data+start+first, destination);
+	std::copy(data, data+count-first, destination+first);
+	read_position.store(r+count, std::memory_order_release);
+	return count;
+}
+
+template<typename T>
+int LockFreeRing<T>::getReadAvailable() {
+	return (int)(write_position.load(std::memory_order_acquire)-read_position.load(std::memory_order_relaxed));
+}
+
+template<typename T>
+int LockFreeRing<T>::getWriteAvailable() {
+	return capacity-(int)(write_position.load(std::memory_order_relaxed)-read_position.load(std::memory_order_acquire));
+}
+
+template<typename T>
+void LockFreeRing<T>::skipTo(long long position) {
+	long long r = read_position.load(std::memory_order_relaxed);
+	position = std::min(position, write_position.load(std::memory_order_acquire));
+	if(position > r) read_position.store(position, std::memory_order_release);
+}
+
+template<typename T>
+void LockFreeRing<T>::clear() {
+	read_position.store(write_position.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+}
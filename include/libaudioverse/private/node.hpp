@@ -122,6 +122,12 @@ class Node: public Job {
 
 	//True if we're paused.
 	bool canCull() override;
+
+	//Called just before we tick again after the planner left us out for blocks blocks, because everything downstream of us was culled.
+	//Nodes which keep time, i.e. BufferNode, override this to catch up.  The default does nothing.
+	virtual void skipBlocks(int blocks);
+	//Call skipBlocks on us and everything upstream of us which missed ticks, but for no more than blocks blocks.
+	void catchUp(int blocks);
 	
 	//Various optimizations that subclasses can enable.
 	void setShouldZeroOutputBuffers(bool v);
@@ -0,0 +1,59 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include <memory>
+#include <string>
+#include <atomic>
+
+namespace libaudioverse_implementation {
+
+//Chunked files are decoded this many frames at a time, and each paged buffer keeps this many chunks.
+const int paged_chunk_frames = 16384;
+const int paged_chunk_slots = 8;
+//How far ahead of a player we decode.
+const int paged_lookahead_chunks = 2;
+//The loader thread looks for requests at least this often, in seconds.
+const double paged_loader_max_sleep = 0.1;
+
+/**Audio read from a file as it plays, for buffers too large to decode up front.
+
+Uncompressed wave files are mapped, and the OS pages them in.
+Everything else is decoded a chunk at a time by the paged loader thread, keeping the most recently used chunks.
+Players call prefetch with their position every block, which asks for what they'll need next.
+Neither prefetching nor reading ever waits on the file: reading something which isn't ready asks for it and gives silence, counting an underrun.*/
+class PagedAudio {
+	public:
+	PagedAudio(int channels, int frames);
+	virtual ~PagedAudio() {}
+	int getChannels();
+	int getFrames();
+	//Read count frames of channel starting at frame, scaled by the gain.
+	void read(int channel, int frame, int count, float* destination);
+	virtual void prefetch(int frame, bool looping) = 0;
+	//Memory we hold, not counting what the OS pages in for mapped files.
+	virtual size_t getSize() = 0;
+	//The sample furthest from zero, ignoring the gain.  Slow, since it reads everything.
+	virtual float computePeak() = 0;
+	//For normalization.  Call only while nothing is reading.
+	void setGain(float g);
+	//Reads which found part of what they wanted not yet decoded.
+	int getUnderruns();
+	protected:
+	virtual void readFrames(int channel, int frame, int count, float* destination) = 0;
+	int channels = 0, frames = 0;
+	float gain = 1.0f;
+	std::atomic<int> underruns{0};
+};
+
+//Returns null if the file isn't at sr, since resampling needs the whole file.
+std::shared_ptr<PagedAudio> openPagedAudio(const std::string &path, int sr);
+
+void initializePagedLoader();
+void shutdownPagedLoader();
+
+}
@@ -16,6 +16,19 @@ carrying such notice may not be copied, modified, or distributed except accordin
 /**job.hpp contains the rest of this code.*/
 
 namespace libaudioverse_implementation {
+
+/**Each bin of the plan is split into this many contiguous groups of jobs, which run in order.
+The split doesn't depend on the thread count, so anything keyed on the group does the same work in the same order however many threads there are.
+The environment uses this to give parallel sources their own buffers and still sum them deterministically.*/
+const int planner_job_group_count = 16;
+//The group of the job running on this thread.
+int getCurrentJobGroup();
+
+struct JobGroup {
+	int index;
+	std::shared_ptr<Job> *begin, *end;
+};
+
 class Planner {
 	public:
 	Planner();
@@ -35,8 +48,12 @@ class Planner {
 	//Initialize the strong version of the plan from the weak pointers.
 	//This can invalidate the plan.
 	void initializeStrongPlan();
+	//Split the bins of the plan into job_groups.
+	void makeJobGroups();
 	std::map<int, std::vector<std::shared_ptr<Job>>> plan;
 	std::map<int, std::vector<std::weak_ptr<Job>>> weak_plan;
+	//Parallel to the bins of plan.
+	std::vector<std::vector<JobGroup>> job_groups;
 	bool is_valid = false;
 	std::weak_ptr<Job> last_start;
 	//For threads:
@@ -27,6 +27,7 @@ class Node;
 class Device;
 class InputConnection;
 class Planner;
+class StreamingScheduler;
 
 /*When thrown on the background thread, terminates it.*/
 class ThreadTerminationException {
@@ -77,6 +78,8 @@ class Server: public Job {
 	//Thread support.
 	void setThreads(int n);
 	int getThreads();
+	//Reads for every file streamer of this server.
+	std::shared_ptr<StreamingScheduler> getStreamingScheduler();
 
 	//called when connections are formed or lost, or when a node is deleted.
 	void invalidatePlan();
@@ -138,6 +141,7 @@ class Server: public Job {
 	std::multimap<double, std::function<void(void)>> scheduled_callbacks;
 	
 	Planner* planner = nullptr;
+	std::shared_ptr<StreamingScheduler> streaming_scheduler;
 	int threads = 1;
 	
 	template<typename JobT, typename CallableT, typename... ArgsT>
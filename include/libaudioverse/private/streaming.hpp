@@ -0,0 +1,88 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#pragma once
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+namespace libaudioverse_implementation {
+
+class FileStreamer;
+
+//Servers start with this many I/O threads.
+const int streaming_default_threads = 2;
+//I/O threads never sleep longer than this, so that streams which start playing are noticed.
+const double streaming_max_sleep = 0.1;
+
+class StreamingStats {
+	public:
+	long long frames = 0;
+	//In seconds of the file.
+	double seconds = 0.0;
+	int reads = 0;
+	//From when a stream first needed a read until that read finished.
+	double total_latency = 0.0, max_latency = 0.0;
+	int underruns = 0;
+	void add(const StreamingStats &other);
+};
+
+/**Reads for every FileStreamer of a server, from a small pool of I/O threads.
+
+Each stream's deadline is how long its ring can keep playing, and the threads always read for the stream with the earliest one.
+A stream isn't read for until it has room for a good amount, and then it's refilled in one go, so the disk sees a few long reads per file instead of many short ones interleaved across files.
+Seeks are always most urgent.*/
+class StreamingScheduler {
+	public:
+	StreamingScheduler(int threads);
+	~StreamingScheduler();
+	void addStream(FileStreamer* stream);
+	//Forget a stream and destroy it, now if no thread is reading for it and otherwise by that thread once the read finishes.  Never waits.
+	//This is how streams die; the scheduler must outlive them.
+	void retireStream(FileStreamer* stream);
+	//Called by streams when something happened that the threads should look at right away.
+	void wake();
+	void setThreadCount(int threads);
+	int getThreadCount();
+	//Stats are since the scheduler was made or the last reset.  Throughput is in seconds of audio read per second.
+	void getStreamStats(FileStreamer* stream, double* throughput, double* latency, double* maxLatency, int* underruns);
+	//Includes streams that have since been removed.
+	void getStats(int* streams, double* throughput, double* latency, double* maxLatency, int* underruns);
+	void resetStats();
+	private:
+	class StreamState {
+		public:
+		bool in_service = false, is_due = false, failed = false;
+		//Set by retireStream while a thread is reading for the stream, so that the thread destroys it.
+		bool retired = false;
+		std::chrono::steady_clock::time_point due_since;
+		StreamingStats stats;
+		//The stream's underrun count when stats were last reset.
+		int underruns_at_reset = 0;
+	};
+	void threadFunction();
+	//Claim the most urgent stream, or return nullptr and say how long until one might need reading.  Call with the mutex held.
+	FileStreamer* pickStream(double* sleepFor);
+	void startThreads(int count);
+	void stopThreads();
+	void reportStats(const StreamingStats &stats, double* throughput, double* latency, double* maxLatency, int* underruns);
+	std::map<FileStreamer*, StreamState> streams;
+	//Stats of removed streams.
+	StreamingStats retired_stats;
+	std::chrono::steady_clock::time_point stats_start;
+	std::vector<std::thread> threads;
+	bool running = false;
+	std::mutex mutex;
+	std::condition_variable wake_condition;
+	//Serializes changes to the thread count, which wait for reads in progress, without blocking anything else.
+	std::mutex threads_mutex;
+};
+
+}
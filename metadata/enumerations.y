@@ -24,6 +24,7 @@ enumerations:
       Lav_ERROR_OVERLAPPING_AUTOMATORS: An attempt to schedule an automator within the duration of another.
       Lav_ERROR_CANNOT_CONNECT_TO_PROPERTY: Attempt to connect a node to a property which cannot be automated.
       Lav_ERROR_BUFFER_IN_USE: Indicates an attempt to modify a buffer while something is reading its data.
+      Lav_ERROR_BUFFER_LOADING: Indicates an attempt to modify or play a buffer which is still loading asynchronously.
       Lav_ERROR_INTERNAL: If you see this error, it's a bug.
   Lav_PROPERTY_TYPES:
     doc_description: |
@@ -46,6 +47,29 @@ enumerations:
       Lav_NODESTATE_PAUSED: This node is paused.
       Lav_NODESTATE_PLAYING: This node advances if other nodes need audio from it.
       Lav_NODESTATE_ALWAYS_PLAYING: This node advances always.
+  Lav_BUFFER_LOAD_STATES:
+    doc_description: |
+      The state of a buffer loaded with {{"Lav_bufferLoadFromFileAsync"|function}} or {{"Lav_bufferDecodeFromArrayAsync"|function}}.
+    members:
+      Lav_BUFFER_LOAD_STATE_READY: The buffer is not loading.  Buffers which were never loaded asynchronously are always ready.
+      Lav_BUFFER_LOAD_STATE_LOADING: The buffer is still loading, and is empty until it finishes.
+      Lav_BUFFER_LOAD_STATE_FAILED: The last asynchronous load failed, and the buffer is empty.  {{"Lav_bufferGetLoadError"|function}} says why.
+  Lav_BUFFER_STORAGE_FORMATS:
+    doc_description: |
+      How a buffer stores its samples.  See {{"Lav_bufferSetStorageFormat"|function}}.
+    members:
+      Lav_BUFFER_STORAGE_FORMAT_FLOAT: 32-bit floating point.  This is lossless and the fastest to play.
+      Lav_BUFFER_STORAGE_FORMAT_INT16: 16-bit integers, half the size of float, with the quality of CD audio.
+      Lav_BUFFER_STORAGE_FORMAT_HALF: 16-bit floating point, half the size of float.  Quiet sounds keep more detail than with 16-bit integers, at the cost of loud ones.
+      Lav_BUFFER_STORAGE_FORMAT_ADPCM: IMA ADPCM, about an eighth the size of float.  This is audibly lossy, and is best for ambiences and other sounds where size matters more than quality.
+  Lav_RECORDING_FORMATS:
+    doc_description: |
+      The sample format of files written by the {{"Lav_OBJTYPE_RECORDER_NODE"|node}}.
+      Ogg files are always Vorbis, and ignore this.
+    members:
+      Lav_RECORDING_FORMAT_PCM16: 16-bit integers, the quality of CD audio.
+      Lav_RECORDING_FORMAT_PCM24: 24-bit integers, for recordings which will be processed further.
+      Lav_RECORDING_FORMAT_FLOAT: 32-bit floating point.  This is lossless, and anything louder than 1.0 survives instead of clipping.  FLAC can't hold it.
   Lav_LOGGING_LEVELS:
     doc_description: |
       Possible levels for logging.
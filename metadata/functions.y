@@ -127,6 +127,104 @@ functions:
       and further use of that handle will cause crashes.
     params:
       cb: The callback to be called when handles are destroyed.
+  Lav_setHrtfGridBudget:
+    category: core
+    doc_description: |
+      Set how much memory each HRTF dataset may spend on its precomputed grid.
+      
+      When the grid is enabled, responses are interpolated ahead of time at regular directions, and moving a source becomes a table lookup instead of an interpolation.
+      Libaudioverse uses the finest resolution that fits, starting at 1 degree in both elevation and azimuth.
+      Directions are rounded to the nearest point on the grid, and sources which round to the same point share its response.
+      A grid costs 4 bytes per HRIR sample per point; for 128-sample HRIRs covering -40 to 90 degrees of elevation, 1 degree by 5 degrees is about 5 MB.
+      HRIRs of 64 samples or more are convolved in the frequency domain, and then each server block size in use also keeps the spectrum of every point.
+      Those spectra aren't counted against the budget, and cost about 4 bytes per point for every sample of the block size plus the HRIR length.
+      For 128-sample HRIRs that is about 3 times the grid at a block size of 256 and about 9 times at 1024.
+      
+      The budget applies to HRTF datasets loaded after this call.
+      Nodes which already exist keep using what they have.
+      The default is 0, which disables the grid.
+    params:
+      kilobytes: The budget, in kilobytes.
+  Lav_getHrtfGridBudget:
+    category: core
+    doc_description: |
+      Get the memory budget for precomputed HRTF grids, in kilobytes.
+  Lav_setHrtfMinimumPhaseLength:
+    category: core
+    doc_description: |
+      Convert HRTF datasets to minimum phase when they are loaded.
+      
+      Most of the length of a measured HRIR is the delay before the sound reaches the farther ear.
+      When this setting is nonzero, each HRIR is split into a minimum-phase response truncated to this many taps and a fractional delay, and panners apply the delay with a delay line.
+      This makes convolution much cheaper: values from 32 to 64 work well.
+      
+      The setting applies to HRTF datasets loaded after this call.
+      Nodes which already exist keep using what they have.
+      The default is 0, which uses the measured responses.
+    params:
+      length: The number of taps to keep.
+  Lav_getHrtfMinimumPhaseLength:
+    category: core
+    doc_description: |
+      Get the minimum-phase length for HRTF datasets.
+  Lav_saveHrtfCache:
+    category: core
+    doc_description: |
+      Write an HRTF dataset, as prepared for one sample rate, to a cache file.
+      
+      Loading an HRTF file means parsing it and resampling every response, which takes noticeable time for large datasets.
+      The cache holds the result, including the effects of {{"Lav_setHrtfMinimumPhaseLength"|function}}, so that {{"Lav_loadHrtfCache"|function}} can skip that work.
+      Caches are specific to the machine's byte order and to the version of Libaudioverse which wrote them.
+    params:
+      hrtfPath: The HRTF file, or "default" for the default HRTF.
+      sr: The sample rate the cache is for.  This should match your servers.
+      cachePath: Where to write the cache.
+  Lav_loadHrtfCache:
+    category: core
+    doc_description: |
+      Load a cache file written by {{"Lav_saveHrtfCache"|function}}.
+      
+      Afterward, nodes created with the HRTF file the cache was made from, at the sample rate it was made for, use the cache instead of loading the file.
+      The cache is mapped into memory rather than read, so loading it is fast.
+      
+      This function fails if the cache was made with a different minimum-phase length than the current one.
+      Changing either {{"Lav_setHrtfMinimumPhaseLength"|function}} or {{"Lav_setHrtfGridBudget"|function}} forgets loaded caches, so call those first.
+    params:
+      cachePath: The cache to load.
+  Lav_setAssetCacheBudget:
+    category: core
+    doc_description: |
+      Set how much memory the asset cache may spend on files which no buffer is using.
+      
+      Files loaded with {{"Lav_bufferLoadFromFile"|function}} or {{"Lav_bufferLoadFromFileAsync"|function}} are decoded once per sampling rate, and every buffer loaded from the same file shares the result.
+      Entries are identified by path and modification time, so changing a file causes it to be loaded again.
+      Files in use by a buffer are always kept and shared.
+      When no buffer is using a file any more, it stays in the cache so that loading it again is free, until the unused files exceed this budget.
+      The least recently used are forgotten first.
+      
+      The default is 0, which forgets files as soon as nothing uses them.
+      Normalizing a buffer gives it its own copy of the data.
+    params:
+      kilobytes: The budget.
+  Lav_getAssetCacheBudget:
+    category: core
+    doc_description: |
+      Get the budget set with {{"Lav_setAssetCacheBudget"|function}}.
+  Lav_getAssetCacheStats:
+    category: core
+    doc_description: |
+      Get how well the asset cache is doing.
+      
+      Hits and misses count loads since initialization or the last call to {{"Lav_resetAssetCacheStats"|function}}.
+      The size is of everything in the cache, whether or not a buffer is using it.
+    params:
+      hits: Loads which found the file already decoded.
+      misses: Loads which had to decode the file.
+      kilobytes: The size of the cache.
+  Lav_resetAssetCacheStats:
+    category: core
+    doc_description: |
+      Set the hit and miss counts of {{"Lav_getAssetCacheStats"|function}} back to 0.
   Lav_deviceGetCount:
     category: devices
     doc_description: |
@@ -258,6 +356,39 @@ functions:
     category: servers
     doc_description: |
       Get the number of threads that the server is currently using.
+  Lav_serverSetStreamingThreads:
+    category: servers
+    doc_description: |
+      Set how many threads read files for this server's file streamer nodes.
+      
+      Streams share these threads instead of each having their own, and the threads always read for the stream closest to running out first.
+      The default of 2 is enough for hundreds of streams from a local disk.
+      More threads help when reads are slow to start, for example on network drives.
+      
+      This waits for reads in progress to finish, but doesn't stop the server from producing audio meanwhile.
+    params:
+      threads: The number of threads.  Must be at least 1.
+  Lav_serverGetStreamingThreads:
+    category: servers
+    doc_description: |
+      Get how many threads read files for this server's file streamer nodes.
+  Lav_serverGetStreamingStats:
+    category: servers
+    doc_description: |
+      Get how well this server is keeping up with its file streamer nodes.
+      
+      These statistics count from the creation of the server or the last call to {{"Lav_serverResetStreamingStats"|function}}, and include streams which have since been deleted.
+      Per-stream statistics are available from {{"Lav_fileStreamerNodeGetStreamingStats"|function}}.
+    params:
+      streams: The number of file streamer nodes which currently exist.
+      throughput: Seconds of audio read per second.  This must keep up with the number of streams playing.
+      latency: The average time in milliseconds from a stream needing more audio until it was read.
+      maxLatency: The longest such time, in milliseconds.
+      underruns: Blocks in which some stream played silence because its audio wasn't read in time.
+  Lav_serverResetStreamingStats:
+    category: servers
+    doc_description: |
+      Start the statistics of {{"Lav_serverGetStreamingStats"|function}} and {{"Lav_fileStreamerNodeGetStreamingStats"|function}} over.
   Lav_serverCallIn:
     category: servers
     doc_description: |
@@ -292,9 +423,30 @@ functions:
       Loads data into this buffer from a file.
       The file will be resampled to the sampling rate of the server.
       This will happen synchronously.
+      
+      Buffers loaded from the same unchanged file at the same sampling rate share one copy of the data, which is decoded only once.
+      See {{"Lav_setAssetCacheBudget"|function}}.
     params:
       bufferHandle: The buffer into which to load data.
       path: The path to the file to load data from.
+  Lav_bufferLoadFromFilePaged:
+    category: buffers
+    doc_description: |
+      Load a file into this buffer a piece at a time, as it plays, instead of all at once.
+      
+      This is for files too large to decode up front, such as long ambiences.
+      The buffer holds a few seconds of audio at most.
+      What players will need next is decoded on a background thread, a little ahead of time.
+      The audio thread never waits for the file: if a player gets ahead of the decoding, for example right after seeking, it plays silence until the audio is ready.
+      {{"Lav_bufferGetUnderruns"|function}} counts how often this happens.
+      Uncompressed 16-bit and floating point wave files are mapped into memory instead of decoded, and cost almost nothing.
+      
+      Files at a different sampling rate from the server can't be paged, and are loaded as {{"Lav_bufferLoadFromFile"|function}} would.
+      Paged buffers ignore the storage format.
+      Normalizing a paged buffer reads the whole file, but doesn't load it.
+    params:
+      bufferHandle: The buffer into which to load data.
+      path: The path to the file.
   Lav_bufferLoadFromArray:
     category: buffers
     doc_description: |
@@ -328,6 +480,117 @@ functions:
       This function is primarily useful for estimating ram usage in caching structures.
     params:
       bufferHandle: The buffer whose length is to be queried.
+  Lav_bufferSetStorageFormat:
+    category: buffers
+    doc_description: |
+      Set how this buffer stores its samples.
+      
+      Buffers store 32-bit floats by default.
+      The other formats, described in {{"Lav_BUFFER_STORAGE_FORMATS"|enum}}, use less memory at the cost of some quality, and are decoded as they play.
+      Decoding 16-bit formats costs little; ADPCM costs more, but is still cheap compared to most nodes.
+      
+      If the buffer already holds audio, it is converted.
+      Converting from one of the lossy formats doesn't bring back what was lost, so set the format before loading the buffer when possible.
+      Loads and normalization keep the format.
+      
+      As with the other functions which modify buffers, this fails if the buffer is in use.
+    params:
+      bufferHandle: The buffer to modify.
+      format: The new format.
+  Lav_bufferGetStorageFormat:
+    category: buffers
+    doc_description: |
+      Get the storage format of this buffer.
+    params:
+      bufferHandle: The buffer to query.
+  Lav_bufferGetSizeInBytes:
+    category: buffers
+    doc_description: |
+      Get the memory used by the samples of this buffer.
+      
+      Buffers which share data through the asset cache each report the full size.
+    params:
+      bufferHandle: The buffer to query.
+  Lav_bufferGetUnderruns:
+    category: buffers
+    doc_description: |
+      Get how many times a player of this paged buffer needed audio which hadn't been decoded yet, and played silence instead.
+      
+      This is always 0 for buffers which aren't paged.
+      See {{"Lav_bufferLoadFromFilePaged"|function}}.
+    params:
+      bufferHandle: The buffer to query.
+      destination: Holds the count.
+  Lav_bufferLoadFromFileAsync:
+    category: buffers
+    doc_description: |
+      Like {{"Lav_bufferLoadFromFile"|function}}, but returns immediately, leaving the reading, decoding, and resampling to a pool of loader threads.
+      
+      Until loading finishes, the buffer is empty, its state is {{"Lav_BUFFER_LOAD_STATE_LOADING"|codelit}}, and anything which would modify it fails with {{"Lav_ERROR_BUFFER_LOADING"|codelit}}.
+      Use the callback or {{"Lav_bufferGetLoadState"|function}} to find out when it's done.
+      The callback is called on the same background thread as other callbacks, and receives the error if loading failed, in which case the buffer is left empty.
+      
+      Whether a loading buffer can be played is controlled by {{"Lav_bufferSetPlaysWhileLoading"|function}}.
+    params:
+      bufferHandle: The buffer into which to load data.
+      path: The path to the file to load data from.
+      callback: Called when loading finishes, or NULL.
+      userdata: An extra parameter to pass to the callback.
+  Lav_bufferDecodeFromArrayAsync:
+    category: buffers
+    doc_description: |
+      Like {{"Lav_bufferDecodeFromArray"|function}}, but asynchronous, as with {{"Lav_bufferLoadFromFileAsync"|function}}.
+      The data is copied before this function returns.
+    params:
+      bufferHandle: The buffer into which to load data.
+      data: The encoded file.
+      datalen: The length of data in bytes.
+      callback: Called when loading finishes, or NULL.
+      userdata: An extra parameter to pass to the callback.
+  Lav_bufferGetLoadState:
+    category: buffers
+    doc_description: |
+      Get whether the buffer is loading, ready, or failed to load, as one of {{"Lav_BUFFER_LOAD_STATES"|enum}}.
+    params:
+      bufferHandle: The buffer to query.
+  Lav_bufferGetLoadError:
+    category: buffers
+    doc_description: |
+      Get the error from the last asynchronous load of this buffer, or {{"Lav_ERROR_NONE"|codelit}} if it succeeded or is still going.
+    params:
+      bufferHandle: The buffer to query.
+  Lav_bufferSetPlaysWhileLoading:
+    category: buffers
+    doc_description: |
+      Set what happens when a loading buffer is given to a buffer node or played with {{"Lav_environmentNodePlayAsync"|function}}.
+      
+      If true, the default, the buffer node accepts it and plays silence, starting from the beginning once loading finishes.
+      If false, setting it fails with {{"Lav_ERROR_BUFFER_LOADING"|codelit}}.
+      
+      Other nodes always refuse loading buffers.
+    params:
+      bufferHandle: The buffer to configure.
+      playsWhileLoading: 1 to play silence while loading, 0 to refuse.
+  Lav_bufferGetPlaysWhileLoading:
+    category: buffers
+    doc_description: |
+      Get the value set with {{"Lav_bufferSetPlaysWhileLoading"|function}}.
+    params:
+      bufferHandle: The buffer to query.
+  Lav_setBufferLoaderThreads:
+    category: buffers
+    doc_description: |
+      Set how many threads load buffers for {{"Lav_bufferLoadFromFileAsync"|function}} and {{"Lav_bufferDecodeFromArrayAsync"|function}}.
+      
+      The pool is shared by every server.
+      Loads are started in the order they were requested, as many at a time as there are threads.
+      The default is 2.
+    params:
+      threads: The number of threads, at least 1.
+  Lav_getBufferLoaderThreads:
+    category: buffers
+    doc_description: |
+      Get the number of buffer loader threads.
   Lav_nodeGetServer:
     category: nodes
     doc_description: |
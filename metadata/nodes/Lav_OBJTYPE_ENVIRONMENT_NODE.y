@@ -113,6 +113,116 @@ properties:
       
       By default, sources look to their environmlent for the value of this property.
       If you wish to set it on a per-source basis, set {{"Lav_SOURCE_CONTROL_REVERB"|codelit}} to true on the source.
+  Lav_ENVIRONMENT_AMBISONIC_ORDER:
+    name: ambisonic_order
+    type: int
+    range: [0, 3]
+    default: 0
+    doc_description: |
+      If nonzero, sources are mixed into a shared ambisonic bus of this order instead of being panned individually.
+      
+      Each source then costs a handful of multiplies per sample, whatever the panning strategy.
+      The bus is decoded once per block according to {{"Lav_ENVIRONMENT_PANNING_STRATEGY"|property}}:
+      to binaural with this environment's HRTF, or to the speaker layout of the other strategies.
+      Sources ignore their own panning strategy while this is enabled.
+      
+      Higher orders localize more sharply but cost more to decode: order 1 has 4 channels, order 2 has 9, and order 3 has 16.
+      Effect sends are unaffected.
+  Lav_ENVIRONMENT_MAX_DIRECT_SOURCES:
+    name: max_direct_sources
+    type: int
+    range: [0, MAX_INT]
+    default: 0
+    doc_description: |
+      While the ambisonic bus is enabled, this many of the most audible sources are panned individually instead, using their normal panning strategy.
+      
+      Audibility is the gain from the distance model and the source's mul, as heard by the environment's own listener; other listeners don't use the bus.
+      Sources are ranked every block, and crossfade between their own panner and the bus when they move in or out of the top.
+      A source which is already panned individually keeps its place until another source is 1.5 times as audible, so that sources at nearly the same distance don't trade places every block.
+      This gives HRTF quality to the sources which matter most while bounding the cost of panning, whatever the number of sources.
+      
+      This property has no effect unless {{"Lav_ENVIRONMENT_AMBISONIC_ORDER"|property}} is nonzero.
+  Lav_ENVIRONMENT_MAX_VOICES:
+    name: max_voices
+    type: int
+    range: [0, MAX_INT]
+    default: 0
+    doc_description: |
+      The most sources this environment will render at once, or 0 for no limit.
+      
+      Every block, sources in range are scored by their gain from the distance model and mul, multiplied by their {{"Lav_SOURCE_PRIORITY"|property}}.
+      The highest scoring sources play normally.
+      The rest become virtual: they and anything upstream which only they need stop being processed, but buffers feeding them keep their place so that they resume in sync.
+      Sources fade out over one block before becoming virtual and fade in when they become real again.
+      A real source stays real until another source scores 1.5 times higher, so that sources with nearly the same score don't trade places every block.
+      
+      Use {{"Lav_environmentNodeGetVoiceCounts"|function}} to see how many sources are real and virtual.
+  Lav_ENVIRONMENT_VOICE_POOL_SIZE:
+    name: voice_pool_size
+    type: int
+    range: [0, 4096]
+    default: 32
+    doc_description: |
+      How many sounds from {{"Lav_environmentNodePlayAsync"|function}} the environment can play itself.
+      
+      These are played without creating any nodes, so starting one is cheap and does not disturb the rest of the graph.
+      They use the environment's current settings and cannot be changed once started.
+      When the pool is full, further calls fall back to creating a buffer node and a source, as before.
+      
+      Reducing this property stops any sounds playing in the removed part of the pool.
+  Lav_ENVIRONMENT_ROOM_ORIGIN:
+    name: room_origin
+    type: float3
+    default: [0.0, 0.0, 0.0]
+    doc_description: |
+      The corner of the room with the smallest coordinates, in world coordinates.
+      
+      See {{"Lav_ENVIRONMENT_REFLECTION_ORDER"|property}}.
+  Lav_ENVIRONMENT_ROOM_SIZE:
+    name: room_size
+    type: float3
+    default: [0.0, 0.0, 0.0]
+    doc_description: |
+      The size of the room along the x, y, and z axes.
+      The room is a box whose walls are parallel to the axes.
+      
+      If any of these is 0, there is no room and so no early reflections.
+  Lav_ENVIRONMENT_REFLECTION_ORDER:
+    name: reflection_order
+    type: int
+    range: [0, 3]
+    default: 0
+    doc_description: |
+      How many times sound may bounce off the walls of the room before we stop rendering it as an early reflection, or 0 for none.
+      
+      Reflections are computed with the image-source method: every source is mirrored in the walls, and each mirror image is a reflection with its own direction, delay, and gain.
+      The first order gives 6 images per source, the second 24, and the third 62.
+      Each image's gain is that of the distance model at its distance, times the source's mul, times {{"Lav_ENVIRONMENT_WALL_REFLECTIVITY"|property}} once per bounce.
+      Images are delayed relative to the source by the extra distance they travel, at 343 meters per second, and reflections delayed by more than 0.2 seconds are left to the reverb.
+      
+      Each source with at least one reflection being rendered keeps one delay line for all of its reflections, which are amplitude panned to the source's panning strategy; HRTF uses stereo panning for reflections.
+      A delay line holds 0.2 seconds of audio; sources whose reflections are all over the budget below have none.
+      The cost is per reflection, not per source, and is bounded by {{"Lav_ENVIRONMENT_MAX_REFLECTIONS"|property}}.
+      
+      The listener should be inside the room.
+      Head-relative sources have no reflections, nor do the environment's extra listeners or sounds from {{"Lav_environmentNodePlayAsync"|function}} which don't use a source.
+  Lav_ENVIRONMENT_WALL_REFLECTIVITY:
+    name: wall_reflectivity
+    type: float
+    range: [0.0, 1.0]
+    default: 0.7
+    doc_description: |
+      The fraction of the amplitude of a sound which survives each bounce off a wall.
+  Lav_ENVIRONMENT_MAX_REFLECTIONS:
+    name: max_reflections
+    type: int
+    range: [0, MAX_INT]
+    default: 256
+    doc_description: |
+      The most reflections this environment renders per block, over all of its sources.
+      
+      This is the budget for early reflections: each costs one read of its source's delay line and a multiply-add per output channel.
+      When there are more, the loudest are kept and the rest fade out.
 extra_functions:
   Lav_environmentNodePlayAsync:
     doc_description: |
@@ -125,6 +235,16 @@ extra_functions:
       y: The y-component of the position.
       z: The z-component of the position.
       isDry: If true, we avoid sending to the effect sends configured as defaults.
+  Lav_environmentNodePlayAsyncBatch:
+    doc_description: |
+      Equivalent to calling {{"Lav_environmentNodePlayAsync"|function}} once for each buffer, but taking the lock only once.
+      
+      Use this to start many sounds in the same block.
+    params:
+      count: The number of buffers.
+      bufferHandles: The buffers to play.
+      positions: The positions, packed as {{"count"|param}} triples of x, y, and z.
+      isDry: If true, none of these sounds go to the effect sends.
   Lav_environmentNodeAddEffectSend:
     doc_description: |
       Add an effect send.
@@ -149,6 +269,52 @@ extra_functions:
       channels: The number of channels the effect send is to have. Must be 1, 2, 4, 6, or 8.
       isReverb: nonzero if this is a reverb effect send.
       connectByDefault: If nonzero, all existing and newly created sources will send to this effect send unless disabled.
+  Lav_environmentNodeGetVoiceCounts:
+    doc_description: |
+      Get how many of this environment's sources were real and how many were virtual in the last block.
+      
+      Sources which are paused or out of range count as neither.
+      See {{"Lav_ENVIRONMENT_MAX_VOICES"|property}}.
+    params:
+      realVoices: Holds the number of sources which played normally.
+      virtualVoices: Holds the number of sources which were virtual because of the voice limit.
+  Lav_environmentNodeAddListener:
+    doc_description: |
+      Add a listener, for split-screen or several players sharing one environment.
+      
+      The environment's position and orientation properties are listener 0.
+      Each added listener has its own position, orientation, and panning strategy, and a new output of the environment with the channels for that strategy.
+      Sources filter and play their input once, and only work out the geometry and panning again for each listener.
+      
+      Added listeners hear sources directly: they do not use effect sends or the ambisonic bus, and sounds from {{"Lav_environmentNodePlayAsync"|function}} always use a source while there is more than one listener.
+      A source is only culled if it is out of range of every listener.
+      
+      The new output comes after any effect sends already added.
+      Effect send indexes count only effect sends, so add effect sends first if you want their indexes to match their outputs.
+    params:
+      panningStrategy: The panning strategy of the new listener.  This also decides how many channels its output has, and cannot be changed.
+      listenerIndex: Holds the index of the new listener, for use with the other listener functions.
+      outputIndex: Holds the index of the environment's output for the new listener.
+  Lav_environmentNodeSetListenerPosition:
+    doc_description: |
+      Set the position of a listener added with {{"Lav_environmentNodeAddListener"|function}}.
+      Use {{"Lav_ENVIRONMENT_POSITION"|property}} for listener 0.
+    params:
+      listener: The listener.
+      x: The x-component of the  position.
+      y: The y-component of the position.
+      z: The z-component of the position.
+  Lav_environmentNodeSetListenerOrientation:
+    doc_description: |
+      Set the orientation of a listener added with {{"Lav_environmentNodeAddListener"|function}}, as for {{"Lav_ENVIRONMENT_ORIENTATION"|property}}.
+    params:
+      listener: The listener.
+      atX: The x-component of the at vector.
+      atY: The y-component of the at vector.
+      atZ: The z-component of the at vector.
+      upX: The x-component of the up vector.
+      upY: The y-component of the up vector.
+      upZ: The z-component of the up vector.
 inputs: null
 outputs:
   - [dynamic, "Depends on the output_channels property.", "The output of the 3D environment."]
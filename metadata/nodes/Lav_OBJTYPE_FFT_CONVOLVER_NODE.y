@@ -21,7 +21,9 @@ doc_name: fft convolver
 doc_description: |
   A convolver for long impulse responses.
   
-  This convolver uses the overlap-add convolution algorithm.
+  This convolver uses non-uniform partitioned convolution.
+  The beginning of the response is processed every block, so the node adds no latency.
+  The rest of the response is split into progressively larger partitions which are processed on background threads shared by all convolvers in the process.
   It is slower than the {{"Lav_OBJTYPE_CONVOLVER_NODE"|node}} for small impulse responses.
   
   The difference between this node and the {{"Lav_OBJTYPE_CONVOLVER_NODE"|node}} is the complexity of the algorithm.
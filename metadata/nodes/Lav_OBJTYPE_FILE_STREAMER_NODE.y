@@ -1,3 +1,13 @@
+extra_functions:
+  Lav_fileStreamerNodeGetStreamingStats:
+    doc_description: |
+      Get how well the server is keeping up with this stream.
+      These are the same statistics as {{"Lav_serverGetStreamingStats"|function}}, for only this node.
+    params:
+      throughput: Seconds of audio read per second.
+      latency: The average time in milliseconds from this stream needing more audio until it was read.
+      maxLatency: The longest such time, in milliseconds.
+      underruns: Blocks in which this stream played silence because its audio wasn't read in time.
 properties:
   Lav_FILE_STREAMER_POSITION:
     name: position
@@ -24,6 +34,27 @@ properties:
     doc_description: |
       Switches from false to true once the stream has ended completely and gone silent.
       This property will never go true unless looping is false.
+  Lav_FILE_STREAMER_PREFETCH:
+    name: prefetch
+    type: double
+    default: 0.5
+    range: [0.05, 30.0]
+    doc_description: |
+      How many seconds of the file to keep decoded ahead of playback.
+      
+      Reading happens on threads shared by every stream of the server, so that slow disks don't interrupt the audio.
+      More prefetch rides out longer stalls, at the cost of memory.
+      Increasing this past its largest value so far causes a short gap while the stream refills.
+  Lav_FILE_STREAMER_UNDERRUNS:
+    name: underruns
+    type: int
+    default: 0
+    range: [0, MAX_INT]
+    read_only: true
+    doc_description: |
+      How many blocks the server's streaming threads failed to read in time for.
+      These blocks play silence where there should have been audio.
+      If this keeps going up, increase the prefetch.
 callbacks:
   end:
     doc_description: |
@@ -41,4 +72,7 @@ doc_description: |
   Libaudioverse plans to eventually offer a more generic streaming node that also supports web addresses; such a node will have a completely different, less buffer-like interface.
   
   In order to stream a file, it must be passed through a resampler.
-  Consequentlty, the position property is slightly inaccurate and the ended property and callback are slightly delayed.
\ No newline at end of file
+  Consequentlty, the position property is slightly inaccurate and the ended property and callback are slightly delayed.
+  
+  The file is read by a small pool of threads which the server shares between all of its file streamers; see {{"Lav_serverSetStreamingThreads"|function}}.
+  Seeking with the position property takes effect as soon as one of those threads has read from the new position, usually within a block or two, and plays silence until then.
\ No newline at end of file
@@ -4,15 +4,47 @@ extra_functions:
       Begin recording to the specified files.
       The sample rate is the same as that of the server.
       The channel count is the same as this node was initialized with.
-      The format of the file is determined from the extension: this function recognizes ".wav" and ".ogg" on all platforms.
+      The container is determined from the extension: this function recognizes ".wav", ".caf", ".flac", and ".ogg" on all platforms.
+      The sample format comes from the format property.
+      Asking for floating point FLAC is an error.
     params:
       path: The path of the file to record to.
   Lav_recorderNodeStopRecording:
     doc_description: |
       Stops recording.
       
+      Audio still waiting to be written is written before this returns, unless that would take more than about a tenth of a second, in which case the rest is dropped.
       Be sure to call this function.
       Failure to do so may lead to any of a number of undesirable problems.
+properties:
+  Lav_RECORDER_FORMAT:
+    name: format
+    type: int
+    default: Lav_RECORDING_FORMAT_PCM16
+    value_enum: Lav_RECORDING_FORMATS
+    doc_description: |
+      The sample format of the file.
+      Changes take effect the next time recording starts.
+  Lav_RECORDER_BUFFER_LENGTH:
+    name: buffer_length
+    type: double
+    default: 2.0
+    range: [0.1, 60.0]
+    doc_description: |
+      How many seconds of audio can wait to be written to the file.
+      
+      The audio thread hands audio to a background thread, which converts and writes it.
+      If that thread falls this far behind, blocks are dropped and counted in overflows.
+      The buffer is made when recording starts, so changes take effect the next time it does.
+  Lav_RECORDER_OVERFLOWS:
+    name: overflows
+    type: int
+    default: 0
+    range: [0, MAX_INT]
+    read_only: true
+    doc_description: |
+      How many blocks were dropped from the current recording because the buffer was full.
+      If this is ever nonzero, increase the buffer length.
 inputs:
   - [constructor, "The signal to record."]
 outputs:
@@ -119,6 +119,17 @@ properties:
       
       It is extremely difficult to map occlusion to a physical quantity.
       As a consequence, this property is unitless.
+  Lav_SOURCE_PRIORITY:
+    name: priority
+    type: float
+    range: [0.0, INFINITY]
+    default: 1.0
+    doc_description: |
+      How much this source matters when the environment has more sources than {{"Lav_ENVIRONMENT_MAX_VOICES"|property}} allows.
+      
+      A source's score is its gain from the distance model and mul, multiplied by this property.
+      Sources with the lowest scores become virtual first.
+      A priority of 0 makes the source the first to go.
   Lav_SOURCE_CONTROL_PANNING:
     name: control_panning
     type: boolean
@@ -16,10 +16,17 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/hrtf.hpp>
 #include <libaudioverse/private/buffer.hpp>
 #include <libaudioverse/private/helper_templates.hpp>
+#include <libaudioverse/private/data.hpp>
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/constants.hpp>
+#include <libaudioverse/private/workspace.hpp>
+#include <libaudioverse/private/planner.hpp>
+#include <libaudioverse/implementations/ambisonics.hpp>
 #include <libaudioverse/libaudioverse.h>
 #include <libaudioverse/libaudioverse_properties.h>
 #include <libaudioverse/libaudioverse3d.h>
 #include <stdlib.h>
+#include <math.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 #include <algorithm>
@@ -30,13 +37,44 @@ carrying such notice may not be copied, modified, or distributed except accordin
 
 namespace libaudioverse_implementation {
 
-EnvironmentNode::EnvironmentNode(std::shared_ptr<Server> server, std::shared_ptr<HrtfData> hrtf): Node(Lav_OBJTYPE_ENVIRONMENT_NODE, server, 0, 8)  {
+//Scratch for playing voices: a mono buffer, then up to 8 panned channels.
+thread_local Workspace<float> voice_workspace;
+
+AsyncVoice::AsyncVoice(int blockSize, float sr, std::shared_ptr<HrtfData> hrtf): player(blockSize, sr), hrtf_panner(blockSize, sr, hrtf) {
+}
+
+EnvironmentNode::EnvironmentNode(std::shared_ptr<Server> server, std::shared_ptr<HrtfData> hrtf): Node(Lav_OBJTYPE_ENVIRONMENT_NODE, server, 0, 8),
+stereo_panner(server->getBlockSize(), server->getSr()),
+surround40_panner(server->getBlockSize(), server->getSr()),
+surround51_panner(server->getBlockSize(), server->getSr()),
+surround71_panner(server->getBlockSize(), server->getSr()) {
 	this->hrtf = hrtf;
+	panner_pool = std::unique_ptr<PannerPool>(new PannerPool(server->getBlockSize(), server->getSr(), hrtf, (int)ceilf(environment_max_reflection_delay*server->getSr())+1));
+	preparePanners();
 	int channels = getProperty(Lav_ENVIRONMENT_OUTPUT_CHANNELS).getIntValue();
 	appendOutputConnection(0, channels);
 	//Allocate the 8 internal buffers.
 	for(int i = 0; i < 8; i++) source_buffers.push_back(allocArray<float>(server->getBlockSize()));
+	for(int i = 0; i < ambisonic_max_channels; i++) ambisonic_buffers.push_back(allocArray<float>(server->getBlockSize()));
+	accumulation_buffers.resize(planner_job_group_count);
 	updateEnvironmentInfo(true);
+	configureAmbisonicDecoder();
+	//Decoders are built by whoever sets these, never in willTick.
+	getProperty(Lav_ENVIRONMENT_AMBISONIC_ORDER).setPostChangedCallback([&] () {configureAmbisonicDecoder();});
+	getProperty(Lav_ENVIRONMENT_PANNING_STRATEGY).setPostChangedCallback([&] () {
+		configureAmbisonicDecoder();
+		preparePanners();
+	});
+	getProperty(Lav_ENVIRONMENT_REFLECTION_ORDER).setPostChangedCallback([&] () {preparePanners();});
+	stereo_panner.readMap(2, standard_panning_map_stereo);
+	surround40_panner.readMap(4, standard_panning_map_surround40);
+	surround51_panner.readMap(6, standard_panning_map_surround51);
+	surround71_panner.readMap(8, standard_panning_map_surround71);
+	//These pan every voice in turn, so there's no previous block to ramp from.
+	for(auto p: {&stereo_panner, &surround40_panner, &surround51_panner, &surround71_panner}) p->setShouldCrossfade(false);
+	resizeVoicePool(getProperty(Lav_ENVIRONMENT_VOICE_POOL_SIZE).getIntValue());
+	//Each voice has an hrtf panner, so the pool is resized by whoever sets the size, not in willTick.
+	getProperty(Lav_ENVIRONMENT_VOICE_POOL_SIZE).setPostChangedCallback([&] () {resizeVoicePool(getProperty(Lav_ENVIRONMENT_VOICE_POOL_SIZE).getIntValue());});
 	setShouldZeroOutputBuffers(false);
 }
 
@@ -48,6 +86,11 @@ std::shared_ptr<EnvironmentNode> createEnvironmentNode(std::shared_ptr<Server> s
 
 EnvironmentNode::~EnvironmentNode() {
 	for(auto p: source_buffers) freeArray(p);
+	for(auto p: ambisonic_buffers) freeArray(p);
+	for(auto &a: accumulation_buffers) {
+		for(auto p: a.source_buffers) freeArray(p);
+		for(auto p: a.ambisonic_buffers) freeArray(p);
+	}
 }
 
 void EnvironmentNode::willTick() {
@@ -56,40 +99,505 @@ void EnvironmentNode::willTick() {
 		getOutputConnection(0)->reconfigure(0, channels);
 	}
 	updateEnvironmentInfo();
-	//give the new environment to the sources.
-	//this is a set of weak pointers.
-	filterWeakPointers(sources, [&](std::shared_ptr<SourceNode> &s) {
-		s->update(environment_info);
-	});
+	updateSources();
+	updateVoices();
+	manageVoices();
+	for(int i = 0; i < batch.count; i++) batch.sources[i]->updatePlanMembership();
+	if(environment_info.ambisonic_order) rankSources();
+	for(int i = 0; i < batch.count; i++) batch.sources[i]->updatePanners();
+	panner_pool->endBlock();
 	for(auto p: source_buffers) std::fill(p, p+block_size, 0.0f);
+	if(environment_info.ambisonic_order) {
+		for(auto p: ambisonic_buffers) std::fill(p, p+block_size, 0.0f);
+	}
 }
 
 void EnvironmentNode::process() {
+	reduceAccumulationBuffers();
+	renderVoices();
+	//The decoders add to the panned outputs, which are the first 8 source buffers.
+	if(binaural_decoder) binaural_decoder->decode(&ambisonic_buffers[0], source_buffers[0], source_buffers[1]);
+	else if(speaker_decoder) speaker_decoder->decode(block_size, &ambisonic_buffers[0], &source_buffers[0]);
 	for(int i = 0; i < source_buffers.size(); i++) std::copy(source_buffers[i], source_buffers[i]+block_size, output_buffers[i]);
 }
 
+void SourceUpdateBatch::resize(int newCount) {
+	count = newCount;
+	sources.resize(count);
+	for(auto v: {&x, &y, &z, &size, &max_distance, &reverb_distance, &min_reverb_level, &max_reverb_level, &mul, &occlusion, &priority, &distance, &azimuth, &elevation, &dry_gain, &reverb_gain, &horizontal_distance, &negative_z}) v->resize(count);
+	for(auto v: {&head_relative, &distance_model, &panning_strategy, &reverb_count}) v->resize(count);
+	zeros.resize(count, 0.0f);
+	ones.resize(count, 1.0f);
+}
+
+void computeSourceUpdates(const EnvironmentInfo &env, SourceUpdateBatch &batch) {
+	//Geometry.  Head-relative sources skip the transform, so put them back afterward.
+	batch.head_relative_positions.clear();
+	for(int i = 0; i < batch.count; i++) {
+		if(batch.head_relative[i]) batch.head_relative_positions.emplace_back(i, batch.x[i], batch.y[i], batch.z[i]);
+	}
+	transformPointsKernel(batch.count, &env.world_to_listener_transform[0][0], &batch.x[0], &batch.y[0], &batch.z[0]);
+	for(auto &p: batch.head_relative_positions) {
+		int i = std::get<0>(p);
+		batch.x[i] = std::get<1>(p);
+		batch.y[i] = std::get<2>(p);
+		batch.z[i] = std::get<3>(p);
+	}
+	lengthKernel(batch.count, &batch.x[0], &batch.y[0], &batch.z[0], &batch.distance[0]);
+	//Distances have always been the length of the homogeneous position, w included, so fold in the 1.
+	lengthKernel(batch.count, &batch.distance[0], &batch.zeros[0], &batch.ones[0], &batch.distance[0]);
+	lengthKernel(batch.count, &batch.x[0], &batch.zeros[0], &batch.z[0], &batch.horizontal_distance[0]);
+	scalarMultiplicationKernel(batch.count, -1.0f, &batch.z[0], &batch.negative_z[0]);
+	atan2Kernel(batch.count, &batch.y[0], &batch.horizontal_distance[0], &batch.elevation[0]);
+	atan2Kernel(batch.count, &batch.x[0], &batch.negative_z[0], &batch.azimuth[0]);
+	scalarMultiplicationKernel(batch.count, (float)(180.0/PI), &batch.elevation[0], &batch.elevation[0]);
+	scalarMultiplicationKernel(batch.count, (float)(180.0/PI), &batch.azimuth[0], &batch.azimuth[0]);
+	//Gains.  The reverb gain reuses reverb_gain for the unscaled multiplier before scaling it.
+	distanceGainKernel(batch.count, &batch.distance_model[0], &batch.distance[0], &batch.size[0], &batch.max_distance[0], &batch.dry_gain[0]);
+	distanceGainKernel(batch.count, &batch.distance_model[0], &batch.distance[0], &batch.zeros[0], &batch.reverb_distance[0], &batch.reverb_gain[0]);
+	for(int i = 0; i < batch.count; i++) {
+		float unscaled = 1.0f-batch.reverb_gain[i];
+		float scaled = batch.min_reverb_level[i]+(batch.max_reverb_level[i]-batch.min_reverb_level[i])*unscaled;
+		//The logic here is that this is the average gain for all the diffuse field.
+		float reverbCount = batch.reverb_count[i] ? (float)batch.reverb_count[i] : 1.0f;
+		batch.reverb_gain[i] = batch.dry_gain[i]*scaled/reverbCount*batch.mul[i];
+		batch.dry_gain[i] *= batch.mul[i];
+	}
+}
+
+void EnvironmentNode::updateSources() {
+	//Gather.  This is a set of weak pointers.
+	killDeadWeakPointers(sources);
+	batch.resize((int)sources.size());
+	int count = 0;
+	filterWeakPointers(sources, [&](std::shared_ptr<SourceNode> &s) {
+		batch.sources[count] = s.get();
+		s->gatherUpdate(environment_info, batch, count);
+		count++;
+	});
+	if(count == 0) return;
+	//The other listeners first, since computeSourceUpdates overwrites the positions.
+	for(int l = 0; l < listeners.size(); l++) {
+		auto &listener = *listeners[l];
+		listener.batch = batch;
+		listener.info = environment_info;
+		listener.info.world_to_listener_transform = computeWorldToListenerTransform(listener.position, listener.orientation);
+		listener.info.panning_strategy = listener.panning_strategy;
+		computeSourceUpdates(listener.info, listener.batch);
+		for(int i = 0; i < count; i++) batch.sources[i]->applyListenerUpdate(l, listener, listener.batch, i);
+	}
+	gatherReflections();
+	computeSourceUpdates(environment_info, batch);
+	updateReflections();
+	//Scatter.
+	for(int i = 0; i < count; i++) batch.sources[i]->applyUpdate(environment_info, batch, i);
+}
+
+void EnvironmentNode::gatherReflections() {
+	int order = getProperty(Lav_ENVIRONMENT_REFLECTION_ORDER).getIntValue();
+	const float* origin = getProperty(Lav_ENVIRONMENT_ROOM_ORIGIN).getFloat3Value();
+	const float* size = getProperty(Lav_ENVIRONMENT_ROOM_SIZE).getFloat3Value();
+	if(size[0] <= 0.0f || size[1] <= 0.0f || size[2] <= 0.0f) order = 0;
+	if(order != reflection_images_order) {
+		reflection_images.clear();
+		for(int i = -order; i <= order; i++) {
+			for(int j = -order; j <= order; j++) {
+				for(int k = -order; k <= order; k++) {
+					int bounces = abs(i)+abs(j)+abs(k);
+					if(bounces >= 1 && bounces <= order) reflection_images.emplace_back(i, j, k);
+				}
+			}
+		}
+		reflection_images_order = order;
+	}
+	int images = (int)reflection_images.size();
+	int total = 0;
+	for(int i = 0; i < batch.count; i++) {
+		auto &taps = batch.sources[i]->getReflectionTaps();
+		//We don't know where head-relative sources are in the room.
+		if(images == 0 || batch.head_relative[i]) taps.clear();
+		else {
+			//A new order moves every image, so start over.
+			if(taps.size() != images) taps.assign(images, ReflectionTap());
+			total += images;
+		}
+	}
+	reflection_batch.resize(total);
+	reflection_owners.resize(total);
+	reflection_image_indices.resize(total);
+	if(total == 0) return;
+	float reflectivity = getProperty(Lav_ENVIRONMENT_WALL_REFLECTIVITY).getFloatValue();
+	float bounceGains[] = {1.0f, reflectivity, reflectivity*reflectivity, reflectivity*reflectivity*reflectivity};
+	int r = 0;
+	for(int i = 0; i < batch.count; i++) {
+		if(images == 0 || batch.head_relative[i]) continue;
+		float position[] = {batch.x[i]-origin[0], batch.y[i]-origin[1], batch.z[i]-origin[2]};
+		for(int m = 0; m < images; m++, r++) {
+			int rooms[] = {std::get<0>(reflection_images[m]), std::get<1>(reflection_images[m]), std::get<2>(reflection_images[m])};
+			float image[3];
+			for(int a = 0; a < 3; a++) {
+				//Every bounce off a wall on this axis mirrors us within the room, so an odd number leaves us flipped.
+				float p = rooms[a]%2 == 0 ? position[a] : size[a]-position[a];
+				image[a] = origin[a]+rooms[a]*size[a]+p;
+			}
+			reflection_batch.x[r] = image[0];
+			reflection_batch.y[r] = image[1];
+			reflection_batch.z[r] = image[2];
+			reflection_batch.head_relative[r] = 0;
+			reflection_batch.size[r] = batch.size[i];
+			reflection_batch.distance_model[r] = batch.distance_model[i];
+			reflection_batch.max_distance[r] = batch.max_distance[i];
+			reflection_batch.reverb_distance[r] = batch.reverb_distance[i];
+			reflection_batch.min_reverb_level[r] = batch.min_reverb_level[i];
+			reflection_batch.max_reverb_level[r] = batch.max_reverb_level[i];
+			reflection_batch.panning_strategy[r] = batch.panning_strategy[i];
+			reflection_batch.mul[r] = batch.mul[i]*bounceGains[abs(rooms[0])+abs(rooms[1])+abs(rooms[2])];
+			//The source occludes its input before the delay line, so reflections already have it.
+			reflection_batch.occlusion[r] = 0.0f;
+			reflection_batch.priority[r] = batch.priority[i];
+			reflection_batch.reverb_count[r] = 0;
+			reflection_owners[r] = i;
+			reflection_image_indices[r] = m;
+		}
+	}
+}
+
+void EnvironmentNode::updateReflections() {
+	if(reflection_batch.count == 0) return;
+	computeSourceUpdates(environment_info, reflection_batch);
+	float sr = server->getSr();
+	float maxDelay = environment_max_reflection_delay*sr;
+	//Reuse distance for the delay, which is all we need it for.
+	for(int r = 0; r < reflection_batch.count; r++) {
+		int owner = reflection_owners[r];
+		reflection_batch.distance[r] = (reflection_batch.distance[r]-batch.distance[owner])/environment_speed_of_sound*sr;
+	}
+	ranked_reflections.clear();
+	for(int r = 0; r < reflection_batch.count; r++) {
+		int owner = reflection_owners[r];
+		//With the listener in the room, images are never closer than their source, so culled sources have no reflections worth hearing.
+		if(batch.distance[owner] > batch.max_distance[owner]) continue;
+		if(reflection_batch.distance[r] > maxDelay || reflection_batch.dry_gain[r] <= 0.0f) continue;
+		ranked_reflections.emplace_back(reflection_batch.dry_gain[r], r);
+	}
+	int limit = getProperty(Lav_ENVIRONMENT_MAX_REFLECTIONS).getIntValue();
+	if(limit < ranked_reflections.size()) {
+		std::nth_element(ranked_reflections.begin(), ranked_reflections.begin()+limit, ranked_reflections.end(),
+		[] (const std::tuple<float, int> &a, const std::tuple<float, int> &b) {return std::get<0>(a) > std::get<0>(b);});
+		ranked_reflections.resize(limit);
+	}
+	//Everything not kept fades out.
+	for(int i = 0; i < batch.count; i++) {
+		for(auto &tap: batch.sources[i]->getReflectionTaps()) std::fill(tap.gains, tap.gains+8, 0.0f);
+	}
+	for(auto &k: ranked_reflections) {
+		int r = std::get<1>(k), owner = reflection_owners[r];
+		auto &tap = batch.sources[owner]->getReflectionTaps()[reflection_image_indices[r]];
+		int channels = 2;
+		switch(reflection_batch.panning_strategy[r]) {
+			case Lav_PANNING_STRATEGY_SURROUND40: channels = 4; break;
+			case Lav_PANNING_STRATEGY_SURROUND51: channels = 6; break;
+			case Lav_PANNING_STRATEGY_SURROUND71: channels = 8; break;
+		}
+		auto &table = reflection_tables[channels/2-1];
+		if(table == nullptr) table = getStandardAmplitudePannerTable(channels, amplitude_panner_default_table_resolution);
+		const auto &entry = table->lookup(reflection_batch.azimuth[r]);
+		float gain = reflection_batch.dry_gain[r];
+		tap.delay = std::max(0.0f, reflection_batch.distance[r]);
+		tap.channels = channels;
+		tap.gains[entry.channel1] += entry.weight1*gain;
+		tap.gains[entry.channel2] += entry.weight2*gain;
+	}
+}
+
+void EnvironmentNode::resizeVoicePool(int size) {
+	int oldSize = (int)voices.size();
+	if(size < oldSize) {
+		//Drop the voices past the end, whether playing or not.
+		auto removed = [&] (int i) {return i >= size;};
+		free_voices.erase(std::remove_if(free_voices.begin(), free_voices.end(), removed), free_voices.end());
+		active_voices.erase(std::remove_if(active_voices.begin(), active_voices.end(), removed), active_voices.end());
+		voices.resize(size);
+	}
+	for(int i = oldSize; i < size; i++) {
+		voices.emplace_back(new AsyncVoice(block_size, server->getSr(), hrtf));
+		free_voices.push_back(i);
+	}
+}
+
+bool EnvironmentNode::startVoice(std::shared_ptr<Buffer> buffer, float x, float y, float z, bool isDry) {
+	//An empty buffer never reaches its end, so it would hold a voice forever.  There's nothing to hear, so we're already done.
+	if(buffer->getLength() == 0) return true;
+	if(free_voices.empty()) return false;
+	int index = free_voices.back();
+	free_voices.pop_back();
+	auto &v = *voices[index];
+	v.player.setBuffer(buffer);
+	v.x = x;
+	v.y = y;
+	v.z = z;
+	v.is_dry = isDry;
+	v.is_new = true;
+	active_voices.push_back(index);
+	return true;
+}
+
+void EnvironmentNode::updateVoices() {
+	voice_batch.resize((int)active_voices.size());
+	if(voice_batch.count == 0) return;
+	float size = getProperty(Lav_ENVIRONMENT_DEFAULT_SIZE).getFloatValue();
+	int reverbCount = 0;
+	for(auto &send: effect_sends) reverbCount += send.is_reverb;
+	for(int i = 0; i < voice_batch.count; i++) {
+		auto &v = *voices[active_voices[i]];
+		voice_batch.x[i] = v.x;
+		voice_batch.y[i] = v.y;
+		voice_batch.z[i] = v.z;
+		voice_batch.head_relative[i] = 0;
+		voice_batch.size[i] = size;
+		voice_batch.distance_model[i] = environment_info.distance_model;
+		voice_batch.max_distance[i] = environment_info.max_distance;
+		voice_batch.reverb_distance[i] = environment_info.reverb_distance;
+		voice_batch.min_reverb_level[i] = environment_info.min_reverb_level;
+		voice_batch.max_reverb_level[i] = environment_info.max_reverb_level;
+		voice_batch.panning_strategy[i] = environment_info.panning_strategy;
+		voice_batch.mul[i] = 1.0f;
+		voice_batch.occlusion[i] = 0.0f;
+		voice_batch.priority[i] = 1.0f;
+		voice_batch.reverb_count[i] = v.is_dry ? 0 : reverbCount;
+	}
+	computeSourceUpdates(environment_info, voice_batch);
+	int order = environment_info.ambisonic_order;
+	for(int i = 0; i < voice_batch.count; i++) {
+		auto &v = *voices[active_voices[i]];
+		float azimuth = voice_batch.azimuth[i], elevation = std::min(90.0f, std::max(-90.0f, voice_batch.elevation[i]));
+		voice_batch.elevation[i] = elevation;
+		v.hrtf_panner.setAzimuth(azimuth);
+		v.hrtf_panner.setElevation(elevation);
+		std::copy(v.ambisonic_gains, v.ambisonic_gains+ambisonic_max_channels, v.prev_ambisonic_gains);
+		if(order) {
+			computeAmbisonicCoefficients(order, azimuth, elevation, v.ambisonic_gains);
+			scalarMultiplicationKernel(ambisonicChannelCount(order), voice_batch.dry_gain[i], v.ambisonic_gains, v.ambisonic_gains);
+		}
+		if(v.is_new) {
+			v.hrtf_panner.reset();
+			std::copy(v.ambisonic_gains, v.ambisonic_gains+ambisonic_max_channels, v.prev_ambisonic_gains);
+			v.is_new = false;
+		}
+	}
+}
+
+AccumulationBuffers& EnvironmentNode::getAccumulationBuffers() {
+	auto &a = accumulation_buffers[getCurrentJobGroup()];
+	//Effect sends can be added at any time, so this might have to grow.
+	while(a.source_buffers.size() < source_buffers.size()) a.source_buffers.push_back(allocArray<float>(block_size));
+	if(environment_info.ambisonic_order && a.ambisonic_buffers.empty()) {
+		for(int i = 0; i < ambisonic_max_channels; i++) a.ambisonic_buffers.push_back(allocArray<float>(block_size));
+	}
+	a.used = true;
+	return a;
+}
+
+void EnvironmentNode::reduceAccumulationBuffers() {
+	//Always in group order, so the sums are the same however the groups were scheduled.
+	for(auto &a: accumulation_buffers) {
+		if(a.used == false) continue;
+		for(int i = 0; i < a.source_buffers.size(); i++) {
+			additionKernel(block_size, source_buffers[i], a.source_buffers[i], source_buffers[i]);
+			std::fill(a.source_buffers[i], a.source_buffers[i]+block_size, 0.0f);
+		}
+		if(a.ambisonic_buffers.size()) {
+			for(int i = 0; i < ambisonic_max_channels; i++) {
+				additionKernel(block_size, ambisonic_buffers[i], a.ambisonic_buffers[i], ambisonic_buffers[i]);
+				std::fill(a.ambisonic_buffers[i], a.ambisonic_buffers[i]+block_size, 0.0f);
+			}
+		}
+		a.used = false;
+	}
+}
+
+AmplitudePanner* EnvironmentNode::getPannerForChannels(int channels) {
+	switch(channels) {
+		case 2: return &stereo_panner;
+		case 4: return &surround40_panner;
+		case 6: return &surround51_panner;
+		case 8: return &surround71_panner;
+	}
+	return nullptr;
+}
+
+void EnvironmentNode::renderVoices() {
+	if(voice_batch.count == 0) return;
+	float* ws = voice_workspace.get(block_size*9);
+	float* mono = ws;
+	float* panBuffers[] = {ws+block_size, ws+2*block_size, ws+3*block_size, ws+4*block_size, ws+5*block_size, ws+6*block_size, ws+7*block_size, ws+8*block_size};
+	int order = environment_info.ambisonic_order;
+	for(int i = 0; i < voice_batch.count; i++) {
+		auto &v = *voices[active_voices[i]];
+		//Out of range, so just keep time.
+		if(voice_batch.distance[i] > voice_batch.max_distance[i]) {
+			v.player.skip(block_size);
+			std::fill(v.ambisonic_gains, v.ambisonic_gains+ambisonic_max_channels, 0.0f);
+			continue;
+		}
+		std::fill(mono, mono+block_size, 0.0f);
+		v.player.process(1, &mono);
+		float dryGain = voice_batch.dry_gain[i], reverbGain = voice_batch.reverb_gain[i];
+		float azimuth = voice_batch.azimuth[i], elevation = voice_batch.elevation[i];
+		if(order) ambisonicEncode(block_size, order, mono, v.prev_ambisonic_gains, v.ambisonic_gains, &ambisonic_buffers[0]);
+		else {
+			int channels = 2;
+			if(environment_info.panning_strategy == Lav_PANNING_STRATEGY_HRTF) v.hrtf_panner.pan(mono, panBuffers[0], panBuffers[1]);
+			else {
+				switch(environment_info.panning_strategy) {
+					case Lav_PANNING_STRATEGY_SURROUND40: channels = 4; break;
+					case Lav_PANNING_STRATEGY_SURROUND51: channels = 6; break;
+					case Lav_PANNING_STRATEGY_SURROUND71: channels = 8; break;
+				}
+				auto p = getPannerForChannels(channels);
+				for(int c = 0; c < channels; c++) std::fill(panBuffers[c], panBuffers[c]+block_size, 0.0f);
+				p->setAzimuth(azimuth);
+				p->setElevation(elevation);
+				p->pan(mono, panBuffers);
+			}
+			for(int c = 0; c < channels; c++) multiplicationAdditionKernel(block_size, dryGain, panBuffers[c], source_buffers[c], source_buffers[c]);
+		}
+		if(v.is_dry) continue;
+		for(auto &send: effect_sends) {
+			float g = send.is_reverb ? reverbGain : dryGain;
+			if(send.channels == 1) {
+				multiplicationAdditionKernel(block_size, g, mono, source_buffers[send.start], source_buffers[send.start]);
+				continue;
+			}
+			auto p = getPannerForChannels(send.channels);
+			for(int c = 0; c < send.channels; c++) std::fill(panBuffers[c], panBuffers[c]+block_size, 0.0f);
+			p->setAzimuth(azimuth);
+			p->setElevation(elevation);
+			p->pan(mono, panBuffers);
+			for(int c = 0; c < send.channels; c++) multiplicationAdditionKernel(block_size, g, panBuffers[c], source_buffers[send.start+c], source_buffers[send.start+c]);
+		}
+	}
+	//Return finished voices to the pool.  The buffer is released here, on the audio thread, as it is when a buffer node's buffer is cleared.
+	for(auto i = active_voices.begin(); i != active_voices.end();) {
+		auto &v = *voices[*i];
+		if(v.player.getEndedCount() == 0) {
+			i++;
+			continue;
+		}
+		v.player.setBuffer(nullptr);
+		free_voices.push_back(*i);
+		i = active_voices.erase(i);
+	}
+	//voice_batch no longer lines up with active_voices.
+	voice_batch.resize(0);
+}
+
+void EnvironmentNode::manageVoices() {
+	ranked_sources.clear();
+	for(int i = 0; i < batch.count; i++) {
+		auto s = batch.sources[i];
+		if(s->getState() == Lav_NODESTATE_PAUSED || s->getAudibility() == 0.0f) continue;
+		ranked_sources.emplace_back(s->getAudibility()*batch.priority[i]*(s->isReal() ? environment_voice_hysteresis : 1.0f), s);
+	}
+	int limit = environment_info.max_voices;
+	int real = limit == 0 ? (int)ranked_sources.size() : std::min<int>(limit, (int)ranked_sources.size());
+	if(real < ranked_sources.size()) {
+		std::nth_element(ranked_sources.begin(), ranked_sources.begin()+real, ranked_sources.end(),
+		[] (const std::tuple<float, SourceNode*> &a, const std::tuple<float, SourceNode*> &b) {return std::get<0>(a) > std::get<0>(b);});
+	}
+	for(int i = 0; i < ranked_sources.size(); i++) std::get<1>(ranked_sources[i])->setVirtual(i >= real);
+	real_voice_count = real;
+	virtual_voice_count = (int)ranked_sources.size()-real;
+}
+
+void EnvironmentNode::getVoiceCounts(int* realVoices, int* virtualVoices) {
+	*realVoices = real_voice_count;
+	*virtualVoices = virtual_voice_count;
+}
+
+void EnvironmentNode::rankSources() {
+	ranked_sources.clear();
+	for(auto &i: sources) {
+		auto s = i.lock();
+		if(s == nullptr) continue;
+		//Only the environment's own listener uses the bus, so rank by what it hears.
+		float audibility = s->getMainAudibility();
+		if(s->getState() == Lav_NODESTATE_PAUSED || s->isVirtual() || audibility == 0.0f) s->setDirect(false);
+		else ranked_sources.emplace_back(audibility*(s->isDirect() ? environment_direct_hysteresis : 1.0f), s.get());
+	}
+	int direct = std::min<int>(environment_info.max_direct_sources, (int)ranked_sources.size());
+	//Only the split matters, not the order on either side of it.
+	if(direct < ranked_sources.size()) {
+		std::nth_element(ranked_sources.begin(), ranked_sources.begin()+direct, ranked_sources.end(),
+		[] (const std::tuple<float, SourceNode*> &a, const std::tuple<float, SourceNode*> &b) {return std::get<0>(a) > std::get<0>(b);});
+	}
+	for(int i = 0; i < ranked_sources.size(); i++) std::get<1>(ranked_sources[i])->setDirect(i < direct);
+}
+
+PannerPool& EnvironmentNode::getPannerPool() {
+	return *panner_pool;
+}
+
+void EnvironmentNode::preparePanners() {
+	int strategy = getProperty(Lav_ENVIRONMENT_PANNING_STRATEGY).getIntValue();
+	if(strategy == Lav_PANNING_STRATEGY_HRTF) panner_pool->prepare(0);
+	else if(strategy == Lav_PANNING_STRATEGY_STEREO) panner_pool->prepare(1);
+	else if(strategy == Lav_PANNING_STRATEGY_SURROUND40) panner_pool->prepare(2);
+	else if(strategy == Lav_PANNING_STRATEGY_SURROUND51) panner_pool->prepare(3);
+	else if(strategy == Lav_PANNING_STRATEGY_SURROUND71) panner_pool->prepare(4);
+	if(getProperty(Lav_ENVIRONMENT_REFLECTION_ORDER).getIntValue() > 0) panner_pool->prepare(panner_pool_reflection_line_kind);
+}
+
+void EnvironmentNode::configureAmbisonicDecoder() {
+	binaural_decoder.reset();
+	speaker_decoder.reset();
+	//environment_info catches up in the next willTick, before anything is encoded with the new order.
+	int order = getProperty(Lav_ENVIRONMENT_AMBISONIC_ORDER).getIntValue();
+	if(order == 0) return;
+	switch(getProperty(Lav_ENVIRONMENT_PANNING_STRATEGY).getIntValue()) {
+		case Lav_PANNING_STRATEGY_HRTF:
+		binaural_decoder = std::make_shared<AmbisonicBinauralDecoder>(block_size, order, hrtf);
+		break;
+		case Lav_PANNING_STRATEGY_STEREO:
+		speaker_decoder = std::make_shared<AmbisonicSpeakerDecoder>(order, 2, standard_panning_map_stereo);
+		break;
+		case Lav_PANNING_STRATEGY_SURROUND40:
+		speaker_decoder = std::make_shared<AmbisonicSpeakerDecoder>(order, 4, standard_panning_map_surround40);
+		break;
+		case Lav_PANNING_STRATEGY_SURROUND51:
+		speaker_decoder = std::make_shared<AmbisonicSpeakerDecoder>(order, 6, standard_panning_map_surround51);
+		break;
+		case Lav_PANNING_STRATEGY_SURROUND71:
+		speaker_decoder = std::make_shared<AmbisonicSpeakerDecoder>(order, 8, standard_panning_map_surround71);
+		break;
+	}
+}
+
+glm::mat4 computeWorldToListenerTransform(const float* pos, const float* atup) {
+	//Important: look at the glsl constructors. Glm copies them, and there is nonintuitive stuff here.
+	auto at = glm::vec3(atup[0], atup[1], atup[2]);
+	auto up = glm::vec3(atup[3], atup[4], atup[5]);
+	auto right = glm::cross(at, up);
+	auto m = glm::mat4(
+	right.x, up.x, -at.x, 0,
+	right.y, up.y, -at.y, 0,
+	right.z, up.z, -at.z, 0,
+	0, 0, 0, 1);
+	//Above is a rotation matrix, which works presuming the player is at (0, 0).
+	//Pass the translation through it, so that we can bake the translation in.
+	auto posvec = m*glm::vec4(pos[0], pos[1], pos[2], 1.0f);
+	//[column][row] because GLSL.
+	m[3][0] = -posvec.x;
+	m[3][1] = -posvec.y;
+	m[3][2] = -posvec.z;
+	return m;
+}
+
 void EnvironmentNode::updateEnvironmentInfo(bool force) {
 	if(force || werePropertiesModified(this, Lav_ENVIRONMENT_POSITION, Lav_ENVIRONMENT_ORIENTATION)) {
-		//update the matrix.
-		//Important: look at the glsl constructors. Glm copies them, and there is nonintuitive stuff here.
 		const float* pos = getProperty(Lav_ENVIRONMENT_POSITION).getFloat3Value();
 		const float* atup = getProperty(Lav_ENVIRONMENT_ORIENTATION).getFloat6Value();
-		auto at = glm::vec3(atup[0], atup[1], atup[2]);
-		auto up = glm::vec3(atup[3], atup[4], atup[5]);
-		auto right = glm::cross(at, up);
-		auto m = glm::mat4(
-		right.x, up.x, -at.x, 0,
-		right.y, up.y, -at.y, 0,
-		right.z, up.z, -at.z, 0,
-		0, 0, 0, 1);
-		//Above is a rotation matrix, which works presuming the player is at (0, 0).
-		//Pass the translation through it, so that we can bake the translation in.
-		auto posvec = m*glm::vec4(pos[0], pos[1], pos[2], 1.0f);
-		//[column][row] because GLSL.
-		m[3][0] = -posvec.x;
-		m[3][1] = -posvec.y;
-		m[3][2] = -posvec.z;
-		environment_info.world_to_listener_transform = m;
+		environment_info.world_to_listener_transform = computeWorldToListenerTransform(pos, atup);
 	}
 	environment_info.panning_strategy = getProperty(Lav_ENVIRONMENT_PANNING_STRATEGY).getIntValue();
 	environment_info.panning_strategy_changed = force || werePropertiesModified(this, Lav_ENVIRONMENT_PANNING_STRATEGY);
@@ -99,6 +607,9 @@ void EnvironmentNode::updateEnvironmentInfo(bool force) {
 	environment_info.reverb_distance = getProperty(Lav_ENVIRONMENT_REVERB_DISTANCE).getFloatValue();
 	environment_info.min_reverb_level = getProperty(Lav_ENVIRONMENT_MIN_REVERB_LEVEL).getFloatValue();
 	environment_info.max_reverb_level = getProperty(Lav_ENVIRONMENT_MAX_REVERB_LEVEL).getFloatValue();
+	environment_info.ambisonic_order = getProperty(Lav_ENVIRONMENT_AMBISONIC_ORDER).getIntValue();
+	environment_info.max_direct_sources = getProperty(Lav_ENVIRONMENT_MAX_DIRECT_SOURCES).getIntValue();
+	environment_info.max_voices = getProperty(Lav_ENVIRONMENT_MAX_VOICES).getIntValue();
 }
 
 EnvironmentInfo EnvironmentNode::getEnvironmentInfo() {
@@ -121,6 +632,9 @@ void EnvironmentNode::registerSourceForUpdates(std::shared_ptr<SourceNode> sourc
 }
 
 void EnvironmentNode::playAsync(std::shared_ptr<Buffer> buffer, float x, float y, float z, bool isDry) {
+	//Voices only pan for the environment's own listener, so with more than one we need a source.
+	//Voices also can't wait for a buffer to load, but buffer nodes can.
+	if(buffer && buffer->isLoading() == false && listeners.empty() && startVoice(buffer, x, y, z, isDry)) return;
 	auto e = std::static_pointer_cast<EnvironmentNode>(shared_from_this());
 	std::shared_ptr<BufferNode> b;
 	std::shared_ptr<SourceNode> s;
@@ -212,6 +726,54 @@ EffectSendConfiguration& EnvironmentNode::getEffectSend(int which) {
 	return effect_sends[which];
 }
 
+int EnvironmentNode::addListener(int panningStrategy) {
+	int channels;
+	switch(panningStrategy) {
+		case Lav_PANNING_STRATEGY_HRTF: channels = 2; break;
+		case Lav_PANNING_STRATEGY_STEREO: channels = 2; break;
+		case Lav_PANNING_STRATEGY_SURROUND40: channels = 4; break;
+		case Lav_PANNING_STRATEGY_SURROUND51: channels = 6; break;
+		case Lav_PANNING_STRATEGY_SURROUND71: channels = 8; break;
+		default: ERROR(Lav_ERROR_RANGE, "Invalid panning strategy for a listener.");
+	}
+	auto listener = new ListenerConfiguration();
+	listener->panning_strategy = panningStrategy;
+	listener->channels = channels;
+	//Outputs are laid out as for effect sends.
+	listener->start = (int)source_buffers.size();
+	int oldSize = source_buffers.size();
+	resize(0, oldSize+channels);
+	appendOutputConnection(oldSize, channels);
+	for(int i = 0; i < channels; i++) source_buffers.push_back(allocArray<float>(server->getBlockSize()));
+	listeners.emplace_back(listener);
+	panner_pool->prepare(panningStrategy == Lav_PANNING_STRATEGY_HRTF ? 0 : channels/2);
+	//Everything currently playing is heard by the new listener from the next block, so the plan might have changed.
+	server->invalidatePlan();
+	return (int)listeners.size();
+}
+
+ListenerConfiguration& EnvironmentNode::getListener(int which) {
+	if(which < 1 || which > listeners.size()) ERROR(Lav_ERROR_RANGE, "Invalid listener.");
+	return *listeners[which-1];
+}
+
+int EnvironmentNode::getListenerCount() {
+	return (int)listeners.size();
+}
+
+void EnvironmentNode::setListenerPosition(int which, float x, float y, float z) {
+	auto &l = getListener(which);
+	l.position[0] = x;
+	l.position[1] = y;
+	l.position[2] = z;
+}
+
+void EnvironmentNode::setListenerOrientation(int which, float atX, float atY, float atZ, float upX, float upY, float upZ) {
+	auto &l = getListener(which);
+	float o[] = {atX, atY, atZ, upX, upY, upZ};
+	std::copy(o, o+6, l.orientation);
+}
+
 int EnvironmentNode::getEffectSendCount() {
 	return (int)effect_sends.size();
 }
@@ -232,12 +794,28 @@ Lav_PUBLIC_FUNCTION LavError Lav_environmentNodePlayAsync(LavHandle nodeHandle,
 	PUB_BEGIN
 	auto e = incomingObject<EnvironmentNode>(nodeHandle);
 	auto b = incomingObject<Buffer>(bufferHandle);
+	if(b) b->throwIfCannotPlay();
 	LOCK(*e);
 	//==1 gets rid of a VC++ warning.
 	e->playAsync(b, x, y, z, isDry == 1);
 	PUB_END
 }
 
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodePlayAsyncBatch(LavHandle nodeHandle, int count, LavHandle* bufferHandles, float* positions, int isDry) {
+	PUB_BEGIN
+	if(count < 0) ERROR(Lav_ERROR_RANGE, "Count must not be negative.");
+	if(count > 0 && (bufferHandles == nullptr || positions == nullptr)) ERROR(Lav_ERROR_NULL_POINTER, "Buffers and positions must not be NULL.");
+	auto e = incomingObject<EnvironmentNode>(nodeHandle);
+	std::vector<std::shared_ptr<Buffer>> buffers;
+	for(int i = 0; i < count; i++) {
+		buffers.push_back(incomingObject<Buffer>(bufferHandles[i]));
+		if(buffers.back()) buffers.back()->throwIfCannotPlay();
+	}
+	LOCK(*e);
+	for(int i = 0; i < count; i++) e->playAsync(buffers[i], positions[3*i], positions[3*i+1], positions[3*i+2], isDry == 1);
+	PUB_END
+}
+
 Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeAddEffectSend(LavHandle nodeHandle, int channels, int isReverb, int connectByDefault, int* destination) {
 	PUB_BEGIN
 	auto e = incomingObject<EnvironmentNode>(nodeHandle);
@@ -249,4 +827,39 @@ Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeAddEffectSend(LavHandle nodeHand
 	PUB_END
 }
 
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeAddListener(LavHandle nodeHandle, int panningStrategy, int* listenerIndex, int* outputIndex) {
+	PUB_BEGIN
+	auto e = incomingObject<EnvironmentNode>(nodeHandle);
+	LOCK(*e);
+	int l = e->addListener(panningStrategy);
+	*listenerIndex = l;
+	//The output is the one after the last effect send or listener.
+	*outputIndex = e->getOutputConnectionCount()-1;
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeSetListenerPosition(LavHandle nodeHandle, int listener, float x, float y, float z) {
+	PUB_BEGIN
+	auto e = incomingObject<EnvironmentNode>(nodeHandle);
+	LOCK(*e);
+	e->setListenerPosition(listener, x, y, z);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeSetListenerOrientation(LavHandle nodeHandle, int listener, float atX, float atY, float atZ, float upX, float upY, float upZ) {
+	PUB_BEGIN
+	auto e = incomingObject<EnvironmentNode>(nodeHandle);
+	LOCK(*e);
+	e->setListenerOrientation(listener, atX, atY, atZ, upX, upY, upZ);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_environmentNodeGetVoiceCounts(LavHandle nodeHandle, int* realVoices, int* virtualVoices) {
+	PUB_BEGIN
+	auto e = incomingObject<EnvironmentNode>(nodeHandle);
+	LOCK(*e);
+	e->getVoiceCounts(realVoices, virtualVoices);
+	PUB_END
+}
+
 }
\ No newline at end of file
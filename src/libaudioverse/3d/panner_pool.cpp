@@ -0,0 +1,157 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/3d/panner_pool.hpp>
+#include <libaudioverse/private/hrtf.hpp>
+#include <libaudioverse/private/data.hpp>
+#include <powercores/utilities.hpp>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace libaudioverse_implementation {
+
+PannerPool::PannerPool(int blockSize, float sr, std::shared_ptr<HrtfData> hrtf, int reflectionDelay): block_size(blockSize), sr(sr), hrtf(hrtf), reflection_delay(reflectionDelay) {
+	hrtf_ready = std::unique_ptr<LockFreeRing<HrtfPanner*>>(new LockFreeRing<HrtfPanner*>(panner_pool_capacity));
+	hrtf_retired = std::unique_ptr<LockFreeRing<HrtfPanner*>>(new LockFreeRing<HrtfPanner*>(panner_pool_retired_capacity));
+	for(auto &r: amplitude_ready) r = std::unique_ptr<LockFreeRing<AmplitudePanner*>>(new LockFreeRing<AmplitudePanner*>(panner_pool_capacity));
+	amplitude_retired = std::unique_ptr<LockFreeRing<AmplitudePanner*>>(new LockFreeRing<AmplitudePanner*>(panner_pool_retired_capacity));
+	line_ready = std::unique_ptr<LockFreeRing<MultiTapDelayLine*>>(new LockFreeRing<MultiTapDelayLine*>(panner_pool_capacity));
+	line_retired = std::unique_ptr<LockFreeRing<MultiTapDelayLine*>>(new LockFreeRing<MultiTapDelayLine*>(panner_pool_retired_capacity));
+	for(auto &t: targets) t.store(0);
+	thread = powercores::safeStartThread(&PannerPool::threadFunction, this);
+}
+
+PannerPool::~PannerPool() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		running = false;
+	}
+	wake_condition.notify_all();
+	thread.join();
+	//The audio side is gone too, so everything left is ours.
+	HrtfPanner* h;
+	AmplitudePanner* a;
+	MultiTapDelayLine* l;
+	while(hrtf_ready->read(&h, 1)) delete h;
+	while(hrtf_retired->read(&h, 1)) delete h;
+	for(auto &r: amplitude_ready) {
+		while(r->read(&a, 1)) delete a;
+	}
+	while(amplitude_retired->read(&a, 1)) delete a;
+	while(line_ready->read(&l, 1)) delete l;
+	while(line_retired->read(&l, 1)) delete l;
+}
+
+HrtfPanner* PannerPool::takeHrtfPanner() {
+	HrtfPanner* p = nullptr;
+	touched = true;
+	if(hrtf_ready->read(&p, 1)) return p;
+	//Going without would drop the source's audio, so pay for one here and have the thread build more.
+	misses[0]++;
+	return new HrtfPanner(block_size, sr, hrtf);
+}
+
+AmplitudePanner* PannerPool::takeAmplitudePanner(int channels) {
+	AmplitudePanner* p = nullptr;
+	int kind = channels/2;
+	touched = true;
+	if(amplitude_ready[kind-1]->read(&p, 1)) return p;
+	misses[kind]++;
+	return buildAmplitudePanner(kind);
+}
+
+MultiTapDelayLine* PannerPool::takeReflectionLine() {
+	MultiTapDelayLine* l = nullptr;
+	touched = true;
+	if(line_ready->read(&l, 1) == 0) misses[panner_pool_reflection_line_kind]++;
+	return l;
+}
+
+bool PannerPool::giveBack(HrtfPanner* panner) {
+	touched = true;
+	return hrtf_retired->write(&panner, 1) == 1;
+}
+
+bool PannerPool::giveBack(AmplitudePanner* panner) {
+	touched = true;
+	return amplitude_retired->write(&panner, 1) == 1;
+}
+
+bool PannerPool::giveBack(MultiTapDelayLine* line) {
+	touched = true;
+	return line_retired->write(&line, 1) == 1;
+}
+
+void PannerPool::endBlock() {
+	if(touched == false) return;
+	for(int i = 0; i < panner_pool_kinds; i++) {
+		//Once a kind is used, keep spares of it, plus enough to cover a burst like this one next time.
+		//The target falls back to the spares once the misses stop.
+		if(misses[i]) targets[i].store(std::min(panner_pool_spares+misses[i], panner_pool_capacity));
+		else if(targets[i].load()) targets[i].store(panner_pool_spares);
+		misses[i] = 0;
+	}
+	touched = false;
+	woken.store(true);
+	wake_condition.notify_all();
+}
+
+void PannerPool::prepare(int kind) {
+	if(targets[kind].load() < panner_pool_spares) targets[kind].store(panner_pool_spares);
+	woken.store(true);
+	wake_condition.notify_all();
+}
+
+void PannerPool::threadFunction() {
+	std::unique_lock<std::mutex> l(mutex);
+	while(running) {
+		l.unlock();
+		work();
+		l.lock();
+		//A wake between work and the wait is caught by the flag.
+		wake_condition.wait_for(l, std::chrono::microseconds((long long)(panner_pool_max_sleep*1e6)), [&] () {return woken.load() || running == false;});
+		woken.store(false);
+	}
+}
+
+void PannerPool::work() {
+	HrtfPanner* h;
+	AmplitudePanner* a;
+	MultiTapDelayLine* l;
+	while(hrtf_retired->read(&h, 1)) delete h;
+	while(amplitude_retired->read(&a, 1)) delete a;
+	while(line_retired->read(&l, 1)) delete l;
+	while(hrtf_ready->getWritePosition()-hrtf_ready->getReadPosition() < targets[0].load()) {
+		h = new HrtfPanner(block_size, sr, hrtf);
+		hrtf_ready->write(&h, 1);
+	}
+	for(int kind = 1; kind < 5; kind++) {
+		auto &ring = amplitude_ready[kind-1];
+		while(ring->getWritePosition()-ring->getReadPosition() < targets[kind].load()) {
+			a = buildAmplitudePanner(kind);
+			ring->write(&a, 1);
+		}
+	}
+	while(line_ready->getWritePosition()-line_ready->getReadPosition() < targets[panner_pool_reflection_line_kind].load()) {
+		l = buildReflectionLine();
+		line_ready->write(&l, 1);
+	}
+}
+
+AmplitudePanner* PannerPool::buildAmplitudePanner(int kind) {
+	float* maps[] = {standard_panning_map_stereo, standard_panning_map_surround40, standard_panning_map_surround51, standard_panning_map_surround71};
+	auto p = new AmplitudePanner(block_size, sr);
+	p->readMap(kind*2, maps[kind-1]);
+	return p;
+}
+
+MultiTapDelayLine* PannerPool::buildReflectionLine() {
+	return new MultiTapDelayLine(reflection_delay, block_size);
+}
+
+}
@@ -30,6 +30,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <set>
 #include <vector>
 #include <map>
+#include <algorithm>
 
 namespace libaudioverse_implementation {
 
@@ -38,12 +39,13 @@ namespace libaudioverse_implementation {
 //primarily this is occlusion.
 thread_local Workspace<float> source_workspace;
 
+//While out of the plan, how many blocks go by between catching up the nodes upstream.
+const int source_out_of_plan_catch_up_interval = 100;
+//How many blocks a panner can go unused before we free it.
+//Long enough that a source moving back and forth across max_distance or the direct cutoff doesn't rebuild its panner every time.
+const int source_panner_grace_period = 500;
+
 SourceNode::SourceNode(std::shared_ptr<Server> server, std::shared_ptr<EnvironmentNode> environment): Node(Lav_OBJTYPE_SOURCE_NODE, server, 1, 0),
-hrtf_panner(server->getBlockSize(), server->getSr(), environment->getHrtf()),
-stereo_panner(server->getBlockSize(), server->getSr()),
-surround40_panner(server->getBlockSize(), server->getSr()),
-surround51_panner(server->getBlockSize(), server->getSr()),
-surround71_panner(server->getBlockSize(), server->getSr()),
 occlusion_filter(server->getSr()),
 hrtf_data(environment->getHrtf()) {
 	this->environment = environment;
@@ -51,10 +53,6 @@ hrtf_data(environment->getHrtf()) {
 	getProperty(Lav_SOURCE_SIZE).setFloatValue(environment->getProperty(Lav_ENVIRONMENT_DEFAULT_SIZE).getFloatValue());
 	updatePropertiesFromEnvironmentInfo(this->environment->getEnvironmentInfo());
 	appendInputConnection(0, 1);
-	stereo_panner.readMap(2, standard_panning_map_stereo);
-	surround40_panner.readMap(4, standard_panning_map_surround40);
-	surround51_panner.readMap(6, standard_panning_map_surround51);
-	surround71_panner.readMap(8, standard_panning_map_surround71);
 }
 
 SourceNode::~SourceNode() {
@@ -69,15 +67,10 @@ std::shared_ptr<SourceNode> createSourceNode(std::shared_ptr<Server> server, std
 void SourceNode::feedEffect(int which) {
 	if(which < 0 || which >= environment->getEffectSendCount()) ERROR(Lav_ERROR_RANGE, "Invalid effect send.");
 	if(fed_effects.count(which)) return; //no-op.
-	AmplitudePanner* p;
 	int c = environment->getEffectSend(which).channels;
-	if(c == 1) p = nullptr;
-	else if(c == 2) p = &stereo_panner;
-	else if(c == 4) p = &surround40_panner;
-	else if(c == 6) p = &surround51_panner;
-	else if(c == 8) p = &surround71_panner;
-	else ERROR(Lav_ERROR_INTERNAL, "Got invalid effect send count somehow.");
-	fed_effects[which] = p;
+	if(c != 1 && c != 2 && c != 4 && c != 6 && c != 8) ERROR(Lav_ERROR_INTERNAL, "Got invalid effect send count somehow.");
+	//The panner is made by updatePanners, before we next process.
+	fed_effects.insert(which);
 }
 
 void SourceNode::stopFeedingEffect(int which) {
@@ -86,134 +79,402 @@ void SourceNode::stopFeedingEffect(int which) {
 }
 
 void SourceNode::reset() {
+	std::copy(ambisonic_gains, ambisonic_gains+ambisonic_max_channels, prev_ambisonic_gains);
 }
 
-//helper function: calculates gains given distance models.
-double calculateGainForDistanceModel(int model, double distance, double maxDistance, double referenceDistance) {
-	double retval = 1.0;
-	double adjustedDistance = std::max<double>(0.0, distance-referenceDistance);
-	if(adjustedDistance > maxDistance) {
-		retval = 0.0;
-	}
-	else {
-		double distancePercent = adjustedDistance/maxDistance;
-		switch(model) {
-			case Lav_DISTANCE_MODEL_LINEAR: retval = 1.0-distancePercent; break;
-			case Lav_DISTANCE_MODEL_INVERSE: retval = 1.0/(1+315*distancePercent); break;
-			case Lav_DISTANCE_MODEL_INVERSE_SQUARE: retval = 1.0/(1+315*distancePercent*distancePercent); break;
-		}
-	}
-
-	//safety clamping.  Some of the equations above will go negative after max_distance.
-	if(retval < 0.0f) retval = 0.0f;
-	return retval;
+void SourceNode::update(EnvironmentInfo env) {
+	SourceUpdateBatch batch;
+	batch.resize(1);
+	gatherUpdate(env, batch, 0);
+	computeSourceUpdates(env, batch);
+	applyUpdate(env, batch, 0);
+	updatePlanMembership();
+	updatePanners();
 }
 
-void SourceNode::update(EnvironmentInfo env) {
+void SourceNode::gatherUpdate(EnvironmentInfo env, SourceUpdateBatch &batch, int index) {
 	updateEnvironmentInfoFromProperties(env);
-	//first, extract the vector of our position.
 	const float* pos = getProperty(Lav_SOURCE_POSITION).getFloat3Value();
-	bool isHeadRelative = getProperty(Lav_SOURCE_HEAD_RELATIVE).getIntValue() == 1;
-	glm::vec4 npos;
-	if(isHeadRelative) npos = glm::vec4(pos[0], pos[1], pos[2], 1.0);
-	else npos = env.world_to_listener_transform*glm::vec4(pos[0], pos[1], pos[2], 1.0f);
-	//npos is now easy to work with.
-	double distance = glm::length(npos);
-	float maxDistance = env.max_distance;
+	batch.x[index] = pos[0];
+	batch.y[index] = pos[1];
+	batch.z[index] = pos[2];
+	batch.head_relative[index] = getProperty(Lav_SOURCE_HEAD_RELATIVE).getIntValue() == 1;
+	batch.size[index] = getProperty(Lav_SOURCE_SIZE).getFloatValue();
+	batch.distance_model[index] = env.distance_model;
+	batch.max_distance[index] = env.max_distance;
+	batch.reverb_distance[index] = env.reverb_distance;
+	batch.min_reverb_level[index] = env.min_reverb_level;
+	batch.max_reverb_level[index] = env.max_reverb_level;
+	batch.panning_strategy[index] = env.panning_strategy;
+	batch.mul[index] = getProperty(Lav_NODE_MUL).getFloatValue();
+	batch.occlusion[index] = getProperty(Lav_SOURCE_OCCLUSION).getFloatValue();
+	batch.priority[index] = getProperty(Lav_SOURCE_PRIORITY).getFloatValue();
+	int reverbCount = 0;
+	for(auto s: fed_effects) reverbCount += environment->getEffectSend(s).is_reverb;
+	batch.reverb_count[index] = reverbCount;
+}
+
+void SourceNode::applyUpdate(const EnvironmentInfo &env, SourceUpdateBatch &batch, int index) {
+	panning_strategy = batch.panning_strategy[index];
+	//Other listeners may still hear us, so this comes before culling.
+	if(batch.occlusion[index] != last_occlusion) handleOcclusion();
 	//Decide if we're culled. if we are, bale out now and mark us as such.
-	if(distance > maxDistance) {
+	if(batch.distance[index] > batch.max_distance[index]) {
 		culled = true;
+		//Fade in from silence if we come back.
+		std::fill(prev_ambisonic_gains, prev_ambisonic_gains+ambisonic_max_channels, 0.0f);
+		was_direct = false;
 		return;
 	}
-	else culled = false;
-	float xz = sqrtf(npos.x*npos.x+npos.z*npos.z);
-	//elevation and azimuth, in degrees.
-	float elevation = atan2f(npos.y, xz)/PI*180.0f;
-	float azimuth = atan2(npos.x, -npos.z)/PI*180.0f;
+	else if(culled) {
+		culled = false;
+		//The reflection line stopped while we were culled.
+		if(reflection_line) reflection_line->reset();
+	}
+	float azimuth = batch.azimuth[index], elevation = batch.elevation[index];
 	//Elevation can be slightly over or under due to floating point error.
 	//This would trigger an exception because elevation is a property with a range.
 	if(elevation > 90.0f) elevation = 90.0f;
 	if(elevation < -90.0f) elevation = -90.0f;
-	int distanceModel = env.distance_model;
-	float referenceDistance = getProperty(Lav_SOURCE_SIZE).getFloatValue();
-	float reverbDistance = env.reverb_distance;
-	dry_gain = (float)calculateGainForDistanceModel(distanceModel, distance, maxDistance, referenceDistance);
-	float unscaledReverbMultiplier = 1.0f-(float)calculateGainForDistanceModel(distanceModel, distance, reverbDistance, 0.0f);
-	float minReverbLevel = env.min_reverb_level;
-	float maxReverbLevel = env.max_reverb_level;
-	float scaledReverbMultiplier = minReverbLevel+(maxReverbLevel-minReverbLevel)*unscaledReverbMultiplier;
-	reverb_gain = dry_gain*scaledReverbMultiplier;
-	int reverbCount = 0;
-	for(auto s: fed_effects) reverbCount += environment->getEffectSend(s.first).is_reverb;
-	//The logic here is that this is the average gain for all the diffuse field.
-	if(reverbCount) reverb_gain /= reverbCount;
-	//Bring in mul.
-	float mul = getProperty(Lav_NODE_MUL).getFloatValue();
-	dry_gain*=mul;
-	reverb_gain*=mul;
-	//Apply these.
-	hrtf_panner.setAzimuth(azimuth);
-	hrtf_panner.setElevation(elevation);
-	stereo_panner.setAzimuth(azimuth);
-	stereo_panner.setElevation(elevation);
-	surround40_panner.setAzimuth(azimuth);
-	surround40_panner.setElevation(elevation);
-	surround51_panner.setAzimuth(azimuth);
-	surround51_panner.setElevation(elevation);
-	surround71_panner.setAzimuth(azimuth);
-	surround71_panner.setElevation(elevation);
-	handleOcclusion();
-	panning_strategy = env.panning_strategy;
+	//Only touch what changed: most sources are still most of the time.
+	bool moved = azimuth != last_azimuth || elevation != last_elevation;
+	bool gainChanged = batch.dry_gain[index] != dry_gain;
+	dry_gain = batch.dry_gain[index];
+	reverb_gain = batch.reverb_gain[index];
+	if(env.ambisonic_order != ambisonic_order) {
+		std::fill(prev_ambisonic_gains, prev_ambisonic_gains+ambisonic_max_channels, 0.0f);
+		ambisonic_order = env.ambisonic_order;
+		gainChanged = true;
+	}
+	if(ambisonic_order && (moved || gainChanged)) {
+		computeAmbisonicCoefficients(ambisonic_order, azimuth, elevation, ambisonic_gains);
+		scalarMultiplicationKernel(ambisonicChannelCount(ambisonic_order), dry_gain, ambisonic_gains, ambisonic_gains);
+	}
+	if(moved) {
+		if(hrtf_panner) {
+			hrtf_panner->setAzimuth(azimuth);
+			hrtf_panner->setElevation(elevation);
+		}
+		for(auto &p: amplitude_panners) {
+			if(p == nullptr) continue;
+			p->setAzimuth(azimuth);
+			p->setElevation(elevation);
+		}
+		last_azimuth = azimuth;
+		last_elevation = elevation;
+	}
+}
+
+void SourceNode::applyListenerUpdate(int which, const ListenerConfiguration &listener, SourceUpdateBatch &batch, int index) {
+	while(listener_states.size() <= which) listener_states.emplace_back(new SourceListenerState());
+	auto &state = *listener_states[which];
+	state.listener = &listener;
+	state.culled = batch.distance[index] > batch.max_distance[index];
+	if(state.culled) return;
+	state.dry_gain = batch.dry_gain[index];
+	float azimuth = batch.azimuth[index], elevation = std::min(90.0f, std::max(-90.0f, batch.elevation[index]));
+	if(azimuth == state.last_azimuth && elevation == state.last_elevation) return;
+	if(state.hrtf_panner) {
+		state.hrtf_panner->setAzimuth(azimuth);
+		state.hrtf_panner->setElevation(elevation);
+	}
+	if(state.amplitude_panner) {
+		state.amplitude_panner->setAzimuth(azimuth);
+		state.amplitude_panner->setElevation(elevation);
+	}
+	state.last_azimuth = azimuth;
+	state.last_elevation = elevation;
+}
+
+bool SourceNode::isCulledForOtherListeners() {
+	for(auto &state: listener_states) {
+		if(state->culled == false) return false;
+	}
+	return true;
 }
 
 void SourceNode::process() {
-	if(culled) return; //nothing to do.
+	if(culled && isCulledForOtherListeners()) return; //nothing to do.
 	//8 for up to 7.1 panning, then one more for occlusion.
 	float* ws = source_workspace.get(block_size*9);
 	float* occluded = ws;
 	float* panBuffers[] = {ws+block_size, ws+2*block_size, ws+3*block_size, ws+4*block_size, ws+5*block_size, ws+6*block_size, ws+7*block_size, ws+8*block_size};
 	for(int i = 0; i < block_size; i++) occluded[i] = occlusion_filter.tick(input_buffers[0][i]);
+	//Fading in or out because the environment's voice limit changed its mind about us.
+	if(voice_gain != voice_target) {
+		float gain = voice_gain, delta = (voice_target-voice_gain)/block_size;
+		for(int i = 0; i < block_size; i++) {
+			occluded[i] *= gain;
+			gain += delta;
+		}
+		voice_gain = voice_target;
+	}
+	//Other sources may be running at the same time, so we add to our group's buffers rather than the environment's.
+	auto &accumulation = environment->getAccumulationBuffers();
+	float** outputs = &accumulation.source_buffers[0];
+	if(culled == false) {
+		processMainListener(occluded, panBuffers, outputs);
+		if(reflection_line) processReflections(occluded, panBuffers[0], outputs);
+	}
+	processOtherListeners(occluded, panBuffers, outputs);
+}
+
+void SourceNode::processMainListener(float* occluded, float** panBuffers, float** outputs) {
+	if(ambisonic_order == 0) panDirect(occluded, panBuffers, outputs, dry_gain, dry_gain);
+	else {
+		float** busBuffers = &environment->getAccumulationBuffers().ambisonic_buffers[0];
+		float silence[ambisonic_max_channels] = {};
+		//The ambisonic gains already include dry_gain.
+		if(direct && was_direct) panDirect(occluded, panBuffers, outputs, dry_gain, dry_gain);
+		else if(direct) {
+			//Promoted: fade our panner in and the bus out.  The panner's history is stale.
+			if(hrtf_panner) hrtf_panner->reset();
+			panDirect(occluded, panBuffers, outputs, 0.0f, dry_gain);
+			ambisonicEncode(block_size, ambisonic_order, occluded, prev_ambisonic_gains, silence, busBuffers);
+		}
+		else if(was_direct) {
+			panDirect(occluded, panBuffers, outputs, dry_gain, 0.0f);
+			ambisonicEncode(block_size, ambisonic_order, occluded, silence, ambisonic_gains, busBuffers);
+		}
+		else ambisonicEncode(block_size, ambisonic_order, occluded, prev_ambisonic_gains, ambisonic_gains, busBuffers);
+		std::copy(ambisonic_gains, ambisonic_gains+ambisonic_max_channels, prev_ambisonic_gains);
+		was_direct = direct;
+	}
+	for(auto s: fed_effects) {
+		auto &send = environment->getEffectSend(s);
+		float g = send.is_reverb ? reverb_gain : dry_gain;
+		if(send.channels == 1) multiplicationAdditionKernel(block_size, g, occluded, outputs[send.start], outputs[send.start]);
+		else {
+			amplitude_panners[send.channels/2-1]->pan(occluded, panBuffers);
+			for(int i = 0; i < send.channels; i++) multiplicationAdditionKernel(block_size, g, panBuffers[i], outputs[send.start+i], outputs[send.start+i]);
+		}
+	}
+}
+
+void SourceNode::processOtherListeners(float* occluded, float** panBuffers, float** outputs) {
+	for(auto &s: listener_states) {
+		auto &state = *s;
+		if(state.culled) continue;
+		int channels = state.listener->channels, start = state.listener->start;
+		if(state.hrtf_panner) state.hrtf_panner->pan(occluded, panBuffers[0], panBuffers[1]);
+		else state.amplitude_panner->pan(occluded, panBuffers);
+		for(int i = 0; i < channels; i++) multiplicationAdditionKernel(block_size, state.dry_gain, panBuffers[i], outputs[start+i], outputs[start+i]);
+	}
+}
+
+void SourceNode::processReflections(float* input, float* scratch, float** outputs) {
+	reflection_line->write(input);
+	for(auto &tap: reflection_taps) {
+		//Taps dropped by the budget stay silent once they've faded out.
+		bool audible = false, wasAudible = false;
+		for(int c = 0; c < 8; c++) {
+			audible |= tap.gains[c] != 0.0f;
+			wasAudible |= tap.prev_gains[c] != 0.0f;
+		}
+		//A tap fading in starts where it is, rather than sweeping from wherever it was last heard.
+		if(wasAudible == false) tap.prev_delay = tap.delay;
+		if(audible == false && wasAudible == false) continue;
+		reflection_line->read(tap.prev_delay, tap.delay, scratch);
+		tap.prev_delay = tap.delay;
+		for(int c = 0; c < 8; c++) {
+			float start = tap.prev_gains[c], end = tap.gains[c];
+			if(start == end) {
+				if(end != 0.0f) multiplicationAdditionKernel(block_size, end, scratch, outputs[c], outputs[c]);
+			}
+			else gainRampMultiplicationAdditionKernel(block_size, start, end, scratch, outputs[c], outputs[c]);
+		}
+		std::copy(tap.gains, tap.gains+8, tap.prev_gains);
+	}
+}
+
+void SourceNode::panDirect(float* input, float** panBuffers, float** outputs, float gainStart, float gainEnd) {
 	int channels = 0;
 	//The following could be replaced with a multipanner.
 	//if we did that, however, we'd have some extra, unavoidable copies.  So we don't.
+	//updatePanners made the one we need.
 	switch(panning_strategy) {
 		case Lav_PANNING_STRATEGY_HRTF:
-		hrtf_panner.pan(occluded, panBuffers[0], panBuffers[1]);
+		hrtf_panner->pan(input, panBuffers[0], panBuffers[1]);
 		channels = 2;
 		break;
 		case Lav_PANNING_STRATEGY_STEREO:
-		stereo_panner.pan(occluded, panBuffers);
-		channels = 2;
-		break;
 		case Lav_PANNING_STRATEGY_SURROUND40:
-		surround40_panner.pan(occluded, panBuffers);
-		channels = 4;
-		break;
 		case Lav_PANNING_STRATEGY_SURROUND51:
-		surround51_panner.pan(occluded, panBuffers);
-		channels = 6;
-		break;
 		case Lav_PANNING_STRATEGY_SURROUND71:
-		surround71_panner.pan(occluded, panBuffers);
-		channels = 8;
+		channels = panning_strategy == Lav_PANNING_STRATEGY_STEREO ? 2 : panning_strategy == Lav_PANNING_STRATEGY_SURROUND40 ? 4 : panning_strategy == Lav_PANNING_STRATEGY_SURROUND51 ? 6 : 8;
+		amplitude_panners[channels/2-1]->pan(input, panBuffers);
 		break;
 	}
-	for(int i = 0; i < channels; i++) if(panBuffers[i]) multiplicationAdditionKernel(block_size, dry_gain, panBuffers[i], environment->source_buffers[i], environment->source_buffers[i]);
-	for(auto &s: fed_effects) {
-		auto &send = environment->getEffectSend(s.first);
-		auto &p = s.second;
-		float g = send.is_reverb ? reverb_gain : dry_gain;
-		if(send.channels == 1) multiplicationAdditionKernel(block_size, g, occluded, environment->source_buffers[send.start], environment->source_buffers[send.start]);
+	for(int i = 0; i < channels; i++) {
+		float* out = outputs[i];
+		if(gainStart == gainEnd) {
+			multiplicationAdditionKernel(block_size, gainEnd, panBuffers[i], out, out);
+			continue;
+		}
+		float gain = gainStart, delta = (gainEnd-gainStart)/block_size;
+		for(int j = 0; j < block_size; j++) {
+			out[j] += gain*panBuffers[i][j];
+			gain += delta;
+		}
+	}
+}
+
+bool SourceNode::canCull() {
+	return out_of_plan || Node::canCull();
+}
+
+void SourceNode::setVirtual(bool v) {
+	if(v) {
+		//Play a block fading out before leaving the plan, unless we're already out of it.
+		if(voice_gain == 0.0f || out_of_plan) {
+			is_virtual = true;
+			voice_gain = 0.0f;
+		}
+		voice_target = 0.0f;
+	}
+	else {
+		if(is_virtual) voice_gain = 0.0f;
+		is_virtual = false;
+		voice_target = 1.0f;
+	}
+}
+
+bool SourceNode::isVirtual() {
+	return is_virtual;
+}
+
+bool SourceNode::isReal() {
+	return voice_target == 1.0f;
+}
+
+void SourceNode::updatePlanMembership() {
+	bool out = (culled && isCulledForOtherListeners()) || is_virtual;
+	int tick = server->getTickCount();
+	if(out != out_of_plan) {
+		//Take us and everything only we need out of the plan, or put it all back.
+		server->invalidatePlan();
+		out_of_plan = out;
+		if(out) out_of_plan_since = tick;
 		else {
-			p->pan(occluded, panBuffers);
-			for(int i = 0; i < send.channels; i++) multiplicationAdditionKernel(block_size, g, panBuffers[i], environment->source_buffers[send.start+i], environment->source_buffers[send.start+i]);
+			catchUp(tick-out_of_plan_since);
+			//Whatever is in the line is from before we left.
+			if(reflection_line) reflection_line->reset();
 		}
 	}
+	//Every so often, let buffers upstream of us move forward anyway, so that end callbacks fire on time.
+	//Without this, playAsync sources that end out of range would never be recycled.
+	else if(out && (tick-out_of_plan_since)%source_out_of_plan_catch_up_interval == 0) catchUp(tick-out_of_plan_since);
+}
+
+float SourceNode::getAudibility() {
+	//The loudest we are to any listener.
+	float audibility = culled ? 0.0f : dry_gain;
+	for(auto &state: listener_states) {
+		if(state->culled == false) audibility = std::max(audibility, state->dry_gain);
+	}
+	return audibility;
+}
+
+float SourceNode::getMainAudibility() {
+	return culled ? 0.0f : dry_gain;
+}
+
+void SourceNode::setDirect(bool d) {
+	direct = d;
+}
+
+bool SourceNode::isDirect() {
+	return direct;
+}
+
+void SourceNode::updatePanners() {
+	int tick = server->getTickCount();
+	//Nothing is needed if we won't process.  The panner for the panning strategy is needed unless everything goes to the ambisonic bus.
+	if(out_of_plan == false && culled == false) {
+		if(ambisonic_order == 0 || direct || was_direct) {
+			if(panning_strategy == Lav_PANNING_STRATEGY_HRTF) getHrtfPanner();
+			else if(panning_strategy == Lav_PANNING_STRATEGY_STEREO) getAmplitudePanner(2);
+			else if(panning_strategy == Lav_PANNING_STRATEGY_SURROUND40) getAmplitudePanner(4);
+			else if(panning_strategy == Lav_PANNING_STRATEGY_SURROUND51) getAmplitudePanner(6);
+			else if(panning_strategy == Lav_PANNING_STRATEGY_SURROUND71) getAmplitudePanner(8);
+		}
+		for(auto s: fed_effects) {
+			int c = environment->getEffectSend(s).channels;
+			if(c > 1) getAmplitudePanner(c);
+		}
+	}
+	auto &pool = environment->getPannerPool();
+	for(auto &s: listener_states) {
+		auto &state = *s;
+		if(out_of_plan == false && state.culled == false && state.hrtf_panner == nullptr && state.amplitude_panner == nullptr) {
+			//applyListenerUpdate has already run, so face the direction it saw.
+			if(state.listener->panning_strategy == Lav_PANNING_STRATEGY_HRTF) {
+				state.hrtf_panner = std::unique_ptr<HrtfPanner>(pool.takeHrtfPanner());
+				state.hrtf_panner->setAzimuth(state.last_azimuth);
+				state.hrtf_panner->setElevation(state.last_elevation);
+			}
+			else {
+				state.amplitude_panner = std::unique_ptr<AmplitudePanner>(pool.takeAmplitudePanner(state.listener->channels));
+				state.amplitude_panner->setAzimuth(state.last_azimuth);
+				state.amplitude_panner->setElevation(state.last_elevation);
+			}
+		}
+		if(out_of_plan == false && state.culled == false) state.panner_last_used = tick;
+		else if(tick-state.panner_last_used > source_panner_grace_period) {
+			if(state.hrtf_panner && pool.giveBack(state.hrtf_panner.get())) state.hrtf_panner.release();
+			if(state.amplitude_panner && pool.giveBack(state.amplitude_panner.get())) state.amplitude_panner.release();
+		}
+	}
+	//The line is only needed while the budget keeps one of our taps or one is fading out, and doesn't depend on direction, so there's no grace period.
+	//Most sources in a busy room have no taps kept, so most sources have no line.
+	bool heard = false;
+	for(auto &tap: reflection_taps) {
+		for(int c = 0; c < 8; c++) heard |= tap.gains[c] != 0.0f || tap.prev_gains[c] != 0.0f;
+	}
+	if(heard == false) {
+		if(reflection_line && pool.giveBack(reflection_line.get())) reflection_line.release();
+	}
+	//Until the pool has one, our taps wait at silence and fade in once it arrives.
+	else if(reflection_line == nullptr && out_of_plan == false && culled == false) reflection_line = std::unique_ptr<MultiTapDelayLine>(pool.takeReflectionLine());
+	//Panners go back to the pool to be destroyed off the audio thread.  If it's full, we try again next block.
+	if(hrtf_panner && tick-hrtf_panner_last_used > source_panner_grace_period && pool.giveBack(hrtf_panner.get())) hrtf_panner.release();
+	for(int i = 0; i < 4; i++) {
+		if(amplitude_panners[i] && tick-amplitude_panner_last_used[i] > source_panner_grace_period && pool.giveBack(amplitude_panners[i].get())) amplitude_panners[i].release();
+	}
+}
+
+std::vector<ReflectionTap>& SourceNode::getReflectionTaps() {
+	return reflection_taps;
+}
+
+HrtfPanner* SourceNode::getHrtfPanner() {
+	hrtf_panner_last_used = server->getTickCount();
+	if(hrtf_panner) return hrtf_panner.get();
+	//The environment's pool builds these off the audio thread.
+	hrtf_panner = std::unique_ptr<HrtfPanner>(environment->getPannerPool().takeHrtfPanner());
+	if(isnan(last_azimuth) == false) {
+		hrtf_panner->setAzimuth(last_azimuth);
+		hrtf_panner->setElevation(last_elevation);
+	}
+	return hrtf_panner.get();
+}
+
+AmplitudePanner* SourceNode::getAmplitudePanner(int channels) {
+	int i = channels/2-1;
+	amplitude_panner_last_used[i] = server->getTickCount();
+	if(amplitude_panners[i]) return amplitude_panners[i].get();
+	amplitude_panners[i] = std::unique_ptr<AmplitudePanner>(environment->getPannerPool().takeAmplitudePanner(channels));
+	if(isnan(last_azimuth) == false) {
+		amplitude_panners[i]->setAzimuth(last_azimuth);
+		amplitude_panners[i]->setElevation(last_elevation);
+	}
+	return amplitude_panners[i].get();
 }
 
 void 	SourceNode::handleOcclusion() {
 	//We need a db gain and a frequency from the linear occlusion value.
 	float occlusionPercent = getProperty(Lav_SOURCE_OCCLUSION).getFloatValue();
+	last_occlusion = occlusionPercent;
 	if(occlusionPercent == 0.0f) {
 		//Configure as wire and return.
 		//We can go back and forth from any filter type to identity without a problem; this is safe.
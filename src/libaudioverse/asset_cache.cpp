@@ -0,0 +1,184 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/private/asset_cache.hpp>
+#include <libaudioverse/private/buffer.hpp>
+#include <libaudioverse/private/file.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/error.hpp>
+#include <libaudioverse/private/macros.hpp>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace libaudioverse_implementation {
+
+//(path, modification time, sr, format).
+typedef std::tuple<std::string, long long, int, int> AssetKey;
+
+class AssetCacheEntry {
+	public:
+	std::shared_ptr<BufferData> data;
+	//Where we are in asset_cache_lru.
+	std::list<AssetKey>::iterator position;
+};
+
+//All protected by asset_cache_mutex.
+std::mutex *asset_cache_mutex;
+std::map<AssetKey, AssetCacheEntry> *asset_cache;
+//Most recently used first.
+std::list<AssetKey> *asset_cache_lru;
+size_t *asset_cache_budget;
+int *asset_cache_hits, *asset_cache_misses;
+
+void initializeAssetCache() {
+	asset_cache_mutex = new std::mutex();
+	asset_cache = new std::map<AssetKey, AssetCacheEntry>();
+	asset_cache_lru = new std::list<AssetKey>();
+	asset_cache_budget = new size_t(0);
+	asset_cache_hits = new int(0);
+	asset_cache_misses = new int(0);
+}
+
+void shutdownAssetCache() {
+	delete asset_cache;
+	delete asset_cache_lru;
+	delete asset_cache_budget;
+	delete asset_cache_hits;
+	delete asset_cache_misses;
+	delete asset_cache_mutex;
+	//Buffers which outlive us trim on their way out, which must do nothing.
+	asset_cache_mutex = nullptr;
+}
+
+std::shared_ptr<BufferData> decodeAsset(const std::string &path, int sr, int format) {
+	FileReader f{};
+	f.open(path.c_str());
+	float* data = allocArray<float>(f.getSampleCount());
+	f.readAll(data);
+	auto ret = makeBufferData(f.getSr(), sr, f.getChannelCount(), f.getSampleCount()/f.getChannelCount(), data);
+	freeArray(data);
+	return convertBufferData(ret, format);
+}
+
+//Call with asset_cache_mutex held.
+void trimAssetCacheLocked() {
+	//If only we hold an entry, nothing is using it.
+	size_t unused = 0;
+	for(auto &i: *asset_cache) {
+		if(i.second.data.use_count() == 1) unused += i.second.data->getSize();
+	}
+	auto i = asset_cache_lru->end();
+	while(unused > *asset_cache_budget && i != asset_cache_lru->begin()) {
+		i--;
+		auto entry = asset_cache->find(*i);
+		if(entry->second.data.use_count() != 1) continue;
+		unused -= entry->second.data->getSize();
+		asset_cache->erase(entry);
+		i = asset_cache_lru->erase(i);
+	}
+}
+
+std::shared_ptr<BufferData> loadAsset(const std::string &path, int sr, int format) {
+	struct stat info;
+	//Without a modification time we can't tell when the file changes, so don't cache it.
+	if(stat(path.c_str(), &info) != 0) return decodeAsset(path, sr, format);
+	auto key = AssetKey(path, (long long)info.st_mtime, sr, format);
+	{
+		std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+		auto i = asset_cache->find(key);
+		if(i != asset_cache->end()) {
+			(*asset_cache_hits)++;
+			asset_cache_lru->splice(asset_cache_lru->begin(), *asset_cache_lru, i->second.position);
+			return i->second.data;
+		}
+		(*asset_cache_misses)++;
+	}
+	//Decoding is slow, so other threads may use the cache meanwhile.
+	auto data = decodeAsset(path, sr, format);
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	//Someone else may have decoded the same file first, in which case we share theirs.
+	auto i = asset_cache->find(key);
+	if(i != asset_cache->end()) return i->second.data;
+	asset_cache_lru->push_front(key);
+	auto &entry = (*asset_cache)[key];
+	entry.data = data;
+	entry.position = asset_cache_lru->begin();
+	trimAssetCacheLocked();
+	return data;
+}
+
+void trimAssetCache() {
+	if(asset_cache_mutex == nullptr) return;
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	trimAssetCacheLocked();
+}
+
+void setAssetCacheBudget(size_t bytes) {
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	*asset_cache_budget = bytes;
+	trimAssetCacheLocked();
+}
+
+size_t getAssetCacheBudget() {
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	return *asset_cache_budget;
+}
+
+void getAssetCacheStats(int* hits, int* misses, size_t* bytes) {
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	*hits = *asset_cache_hits;
+	*misses = *asset_cache_misses;
+	*bytes = 0;
+	for(auto &i: *asset_cache) *bytes += i.second.data->getSize();
+}
+
+void resetAssetCacheStats() {
+	std::lock_guard<std::mutex> guard(*asset_cache_mutex);
+	*asset_cache_hits = 0;
+	*asset_cache_misses = 0;
+}
+
+//begin public api.
+
+Lav_PUBLIC_FUNCTION LavError Lav_setAssetCacheBudget(int kilobytes) {
+	PUB_BEGIN
+	INITCHECK;
+	if(kilobytes < 0) ERROR(Lav_ERROR_RANGE, "The asset cache budget cannot be negative.");
+	setAssetCacheBudget((size_t)kilobytes*1024);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_getAssetCacheBudget(int* destination) {
+	PUB_BEGIN
+	INITCHECK;
+	*destination = (int)(getAssetCacheBudget()/1024);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_getAssetCacheStats(int* hits, int* misses, int* kilobytes) {
+	PUB_BEGIN
+	INITCHECK;
+	size_t bytes;
+	getAssetCacheStats(hits, misses, &bytes);
+	*kilobytes = (int)(bytes/1024);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_resetAssetCacheStats() {
+	PUB_BEGIN
+	INITCHECK;
+	resetAssetCacheStats();
+	PUB_END
+}
+
+}
@@ -9,17 +9,142 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/libaudioverse.h>
 #include <libaudioverse/private/file.hpp>
 #include <libaudioverse/private/buffer.hpp>
+#include <libaudioverse/private/asset_cache.hpp>
+#include <libaudioverse/private/paged_audio.hpp>
 #include <libaudioverse/private/server.hpp>
 #include <libaudioverse/private/kernels.hpp>
 #include <libaudioverse/private/memory.hpp>
 #include <libaudioverse/private/error.hpp>
 #include <libaudioverse/private/macros.hpp>
+#include <libaudioverse/private/logging.hpp>
+#include <powercores/thread_pool.hpp>
 #include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
 
 
 namespace libaudioverse_implementation {
 
+BufferData::BufferData(int channels, int frames, float* data): channels(channels), frames(frames), data(data) {
+}
+
+BufferData::BufferData(const BufferData &source, int format): format(format), channels(source.channels), frames(source.frames) {
+	int length = channels*frames;
+	switch(format) {
+		case Lav_BUFFER_STORAGE_FORMAT_FLOAT:
+		data = new float[length];
+		std::copy(source.data, source.data+length, data);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_INT16:
+		int16_data = new int16_t[length];
+		floatToInt16Kernel(length, source.data, int16_data);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_HALF:
+		half_data = new uint16_t[length];
+		floatToHalfKernel(length, source.data, half_data);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_ADPCM:
+		adpcm_blocks = (frames+adpcm_block_frames-1)/adpcm_block_frames;
+		adpcm_data = new unsigned char[channels*adpcm_blocks*adpcm_block_bytes];
+		for(int ch = 0; ch < channels; ch++) {
+			int index = 0;
+			for(int b = 0; b < adpcm_blocks; b++) {
+				int start = b*adpcm_block_frames;
+				adpcmEncodeKernel(std::min(adpcm_block_frames, frames-start), source.data+ch*frames+start, &index, adpcm_data+(ch*adpcm_blocks+b)*adpcm_block_bytes);
+			}
+		}
+		break;
+	}
+}
+
+BufferData::BufferData(std::shared_ptr<PagedAudio> paged): channels(paged->getChannels()), frames(paged->getFrames()), paged(paged) {
+}
+
+BufferData::~BufferData() {
+	if(data) delete[] data;
+	if(int16_data) delete[] int16_data;
+	if(half_data) delete[] half_data;
+	if(adpcm_data) delete[] adpcm_data;
+}
+
+size_t BufferData::getSize() {
+	if(paged) return paged->getSize();
+	switch(format) {
+		case Lav_BUFFER_STORAGE_FORMAT_INT16: return sizeof(int16_t)*channels*frames;
+		case Lav_BUFFER_STORAGE_FORMAT_HALF: return sizeof(uint16_t)*channels*frames;
+		case Lav_BUFFER_STORAGE_FORMAT_ADPCM: return (size_t)channels*adpcm_blocks*adpcm_block_bytes;
+	}
+	return sizeof(float)*channels*frames;
+}
+
+void BufferData::decode(int channel, int frame, int count, float* destination) {
+	if(paged) {
+		paged->read(channel, frame, count, destination);
+		return;
+	}
+	switch(format) {
+		case Lav_BUFFER_STORAGE_FORMAT_FLOAT:
+		std::copy(data+channel*frames+frame, data+channel*frames+frame+count, destination);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_INT16:
+		int16ToFloatKernel(count, int16_data+channel*frames+frame, destination);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_HALF:
+		halfToFloatKernel(count, half_data+channel*frames+frame, destination);
+		break;
+		case Lav_BUFFER_STORAGE_FORMAT_ADPCM: {
+			float block[adpcm_block_frames];
+			while(count > 0) {
+				int b = frame/adpcm_block_frames, start = frame%adpcm_block_frames;
+				int needed = std::min(count, adpcm_block_frames-start);
+				adpcmDecodeKernel(start+needed, adpcm_data+(channel*adpcm_blocks+b)*adpcm_block_bytes, block);
+				std::copy(block+start, block+start+needed, destination);
+				frame += needed;
+				destination += needed;
+				count -= needed;
+			}
+		}
+		break;
+	}
+}
+
+float BufferData::getSample(int frame, int channel) {
+	float ret;
+	decode(channel, frame, 1, &ret);
+	return ret;
+}
+
+std::shared_ptr<BufferData> makeBufferData(int inputSr, int outputSr, int channels, int frames, float* interleaved) {
+	float* newData;
+	int newFrames;
+	staticResamplerKernel(inputSr, outputSr, channels, frames, interleaved, &newFrames, &newData);
+	if(newData==nullptr) ERROR(Lav_ERROR_MEMORY);
+	if(channels == 1) return std::make_shared<BufferData>(channels, newFrames, newData);
+	//Uninterleave the data and delete the old one.
+	float* newDataUninterleaved = new float[channels*newFrames];
+	for(int ch = 0; ch < channels; ch++) {
+		for(int i = 0; i < newFrames; i++) {
+			newDataUninterleaved[ch*newFrames+i] = newData[channels*i+ch];
+		}
+	}
+	delete[] newData;
+	return std::make_shared<BufferData>(channels, newFrames, newDataUninterleaved);
+}
+
+std::shared_ptr<BufferData> convertBufferData(std::shared_ptr<BufferData> source, int format) {
+	if(source == nullptr || source->format == format || source->paged) return source;
+	if(source->format != Lav_BUFFER_STORAGE_FORMAT_FLOAT) {
+		float* decoded = new float[source->channels*source->frames];
+		for(int ch = 0; ch < source->channels; ch++) source->decode(ch, 0, source->frames, decoded+ch*source->frames);
+		source = std::make_shared<BufferData>(source->channels, source->frames, decoded);
+		if(format == Lav_BUFFER_STORAGE_FORMAT_FLOAT) return source;
+	}
+	return std::make_shared<BufferData>(*source, format);
+}
+
 Buffer::Buffer(std::shared_ptr<Server> server): ExternalObject(Lav_OBJTYPE_BUFFER) {
 	this->server = server;
 }
@@ -29,7 +154,8 @@ std::shared_ptr<Buffer> createBuffer(std::shared_ptr<Server>server) {
 }
 
 Buffer::~Buffer() {
-	if(data) delete[] data;
+	contents.reset();
+	if(contents_from_cache) trimAssetCache();
 }
 
 std::shared_ptr<Server> Buffer::getServer() {
@@ -50,43 +176,88 @@ int Buffer::getChannels() {
 
 void Buffer::loadFromArray(int sr, int channels, int frames, float* inputData) {
 	int serverSr= (int)server->getSr();
-	float* newData;
-	int newFrames;
-	staticResamplerKernel(sr, serverSr, channels, frames, inputData, &newFrames, &newData);
-	if(newData==nullptr) ERROR(Lav_ERROR_MEMORY);
-	float* newDataUninterleaved;
-	if(channels != 1) {
-		//Uninterleave the data and delete the old one.
-		newDataUninterleaved = new float[channels*frames];
-		for(int ch = 0; ch < channels; ch++) {
-			for(int i = 0; i < newFrames; i++) {
-				newDataUninterleaved[ch*newFrames+i] = newData[channels*i+ch];
-			}
-		}
-	} else {
-		newDataUninterleaved = newData;
-	}
+	auto newContents = convertBufferData(makeBufferData(sr, serverSr, channels, frames, inputData), storage_format.load());
+	LOCK(*this);
+	setContents(newContents, false);
+}
+
+void Buffer::loadFromAsset(std::shared_ptr<BufferData> asset) {
 	LOCK(*this);
-	if(this->data) delete[] this->data;
-	this->channels = channels;
-	this->frames = newFrames;
-	this->data = newDataUninterleaved;
+	setContents(asset, true);
+}
+
+void Buffer::loadPaged(std::shared_ptr<PagedAudio> paged) {
+	auto newContents = std::make_shared<BufferData>(paged);
+	LOCK(*this);
+	setContents(newContents, false);
+}
+
+void Buffer::setContents(std::shared_ptr<BufferData> newContents, bool fromCache) {
+	bool wasFromCache = contents_from_cache;
+	contents = newContents;
+	contents_from_cache = fromCache;
+	channels = contents ? contents->channels : 0;
+	frames = contents ? contents->frames : 0;
+	data = contents ? contents->data : nullptr;
+	if(wasFromCache) trimAssetCache();
 }
 
 float Buffer::getSample(int frame, int channel) {
-	return data[frames*channel+frame];
+	if(data) return data[frames*channel+frame];
+	return contents->getSample(frame, channel);
 }
 
 float* Buffer::getPointer(int frame, int channel) {
 	return data+channel*frames+frame;
 }
 
+bool Buffer::isDirect() {
+	return data != nullptr;
+}
+
+void Buffer::decode(int channel, int frame, int count, float* destination) {
+	contents->decode(channel, frame, count, destination);
+}
+
+void Buffer::prefetch(int frame, bool looping) {
+	if(contents && contents->paged) contents->paged->prefetch(frame, looping);
+}
+
+int Buffer::getStorageFormat() {
+	return storage_format.load();
+}
+
+void Buffer::setStorageFormat(int format) {
+	storage_format.store(format);
+	if(contents && contents->format != format && contents->paged == nullptr) setContents(convertBufferData(contents, format), false);
+}
+
+size_t Buffer::getSize() {
+	return contents ? contents->getSize() : 0;
+}
+
+int Buffer::getUnderruns() {
+	return contents && contents->paged ? contents->paged->getUnderruns() : 0;
+}
+
 void Buffer::normalize() {
-	float min = *std::min_element(data, data+channels*frames);
-	float max = *std::max_element(data, data+channels*frames);
+	if(contents == nullptr) return;
+	//Paged buffers can't be modified, but can be scaled as they're read.
+	if(contents->paged) {
+		contents->paged->setGain(1.0f/contents->paged->computePeak());
+		return;
+	}
+	//Work on float data of our own, and encode it again afterwards if needed.
+	auto floats = contents;
+	if(contents->format != Lav_BUFFER_STORAGE_FORMAT_FLOAT) floats = convertBufferData(contents, Lav_BUFFER_STORAGE_FORMAT_FLOAT);
+	else if(contents.use_count() > 2) floats = std::make_shared<BufferData>(*contents, Lav_BUFFER_STORAGE_FORMAT_FLOAT);
+	float* d = floats->data;
+	float min = *std::min_element(d, d+channels*frames);
+	float max = *std::max_element(d, d+channels*frames);
 	float normfactor = std::max(fabs(min), fabs(max));
 	normfactor = 1.0f/normfactor;
-	scalarMultiplicationKernel(channels*frames, normfactor, data, data);
+	scalarMultiplicationKernel(channels*frames, normfactor, d, d);
+	if(floats != contents) setContents(convertBufferData(floats, storage_format.load()), false);
 }
 
 void Buffer::lock() {
@@ -111,6 +282,106 @@ void Buffer::throwIfInUse() {
 	}
 }
 
+void Buffer::beginLoading() {
+	throwIfLoading();
+	throwIfInUse();
+	//Empty until loaded, so that anything which plays us meanwhile plays silence.
+	setContents(nullptr, false);
+	load_error = Lav_ERROR_NONE;
+	load_state.store(Lav_BUFFER_LOAD_STATE_LOADING);
+}
+
+void Buffer::finishLoading(LavError error) {
+	LOCK(*this);
+	load_error = error;
+	load_state.store(error == Lav_ERROR_NONE ? Lav_BUFFER_LOAD_STATE_READY : Lav_BUFFER_LOAD_STATE_FAILED);
+}
+
+bool Buffer::isLoading() {
+	return load_state.load() == Lav_BUFFER_LOAD_STATE_LOADING;
+}
+
+int Buffer::getLoadState() {
+	return load_state.load();
+}
+
+LavError Buffer::getLoadError() {
+	LOCK(*this);
+	return load_error;
+}
+
+void Buffer::setPlaysWhileLoading(bool p) {
+	plays_while_loading.store(p);
+}
+
+bool Buffer::getPlaysWhileLoading() {
+	return plays_while_loading.load();
+}
+
+void Buffer::throwIfLoading() {
+	if(isLoading()) ERROR(Lav_ERROR_BUFFER_LOADING, "This buffer is still loading.");
+}
+
+void Buffer::throwIfCannotPlay() {
+	if(isLoading() && getPlaysWhileLoading() == false) ERROR(Lav_ERROR_BUFFER_LOADING, "This buffer is still loading, and is configured not to play until it finishes.");
+}
+
+powercores::ThreadPool *buffer_loader_pool;
+//Protects the thread count; the pool is threadsafe.
+std::mutex *buffer_loader_mutex;
+int *buffer_loader_threads;
+
+void initializeBufferLoader() {
+	buffer_loader_mutex = new std::mutex();
+	buffer_loader_threads = new int(2);
+	buffer_loader_pool = new powercores::ThreadPool(*buffer_loader_threads);
+	buffer_loader_pool->start();
+}
+
+void shutdownBufferLoader() {
+	//Waits for loads in progress, which may still be holding buffers.
+	buffer_loader_pool->stop();
+	delete buffer_loader_pool;
+	delete buffer_loader_threads;
+	delete buffer_loader_mutex;
+}
+
+void setBufferLoaderThreads(int threads) {
+	std::lock_guard<std::mutex> guard(*buffer_loader_mutex);
+	if(threads == *buffer_loader_threads) return;
+	buffer_loader_pool->setThreadCount(threads);
+	*buffer_loader_threads = threads;
+}
+
+int getBufferLoaderThreads() {
+	std::lock_guard<std::mutex> guard(*buffer_loader_mutex);
+	return *buffer_loader_threads;
+}
+
+void loadBufferAsync(std::shared_ptr<Buffer> buffer, std::function<void(Buffer&)> load, LavBufferLoadedCallback callback, void* userdata) {
+	buffer_loader_pool->submitJob([=] () {
+		LavError error = Lav_ERROR_NONE;
+		try {
+			load(*buffer);
+		}
+		catch(ErrorException &e) {
+			error = e.error;
+			logDebug("Asynchronous load of a buffer failed with error %i: %s", e.error, e.message.c_str());
+		}
+		catch(std::bad_alloc &) {
+			error = Lav_ERROR_MEMORY;
+		}
+		catch(...) {
+			error = Lav_ERROR_UNKNOWN;
+		}
+		buffer->finishLoading(error);
+		if(callback) {
+			auto server = buffer->getServer();
+			server->enqueueTask([=] () {callback(outgoingObject(buffer), error, userdata);});
+		}
+	});
+}
+
 //begin public api
 
 Lav_PUBLIC_FUNCTION LavError Lav_createBuffer(LavHandle serverHandle, LavHandle* destination) {
@@ -128,22 +399,43 @@ Lav_PUBLIC_FUNCTION LavError Lav_bufferGetServer(LavHandle handle, LavHandle* de
 	PUB_END
 }
 
-void loadFromFileReader(Buffer& buff, FileReader& fr) {
+//Doesn't check if the buffer can be modified: asynchronous loads already did.
+void decodeFromFileReader(Buffer& buff, FileReader& fr) {
 	float* data = allocArray<float>(fr.getSampleCount());
 	fr.readAll(data);
-	// The following two calls manage locks themselves.
-	// This is because resampling can take a long time.
-	buff.throwIfInUse();
+	//This manages the lock itself, because resampling can take a long time.
 	buff.loadFromArray(fr.getSr(), fr.getChannelCount(), fr.getSampleCount()/fr.getChannelCount(), data);
 	freeArray(data);
 }
 
+void loadFromFileReader(Buffer& buff, FileReader& fr) {
+	buff.throwIfLoading();
+	buff.throwIfInUse();
+	decodeFromFileReader(buff, fr);
+}
+
 Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFile(LavHandle bufferHandle, const char* path) {
 	PUB_BEGIN
 	auto buff =incomingObject<Buffer>(bufferHandle);
-	FileReader f{};
-	f.open(path);
-	loadFromFileReader(*buff, f);
+	buff->throwIfLoading();
+	buff->throwIfInUse();
+	//The cache decodes outside the lock, if it has to decode at all.
+	buff->loadFromAsset(loadAsset(path, (int)buff->getServer()->getSr(), buff->getStorageFormat()));
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFilePaged(LavHandle bufferHandle, const char* path) {
+	PUB_BEGIN
+	auto buff = incomingObject<Buffer>(bufferHandle);
+	buff->throwIfLoading();
+	buff->throwIfInUse();
+	int sr = (int)buff->getServer()->getSr();
+	auto paged = openPagedAudio(path, sr);
+	if(paged) buff->loadPaged(paged);
+	else {
+		logInfo("%s is not at the server's sampling rate, so it can't be paged.  Loading all of it.", path);
+		buff->loadFromAsset(loadAsset(path, sr, buff->getStorageFormat()));
+	}
 	PUB_END
 }
 
@@ -151,6 +443,7 @@ Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromArray(LavHandle bufferHandle, int
 	PUB_BEGIN
 	auto buff=incomingObject<Buffer>(bufferHandle);
 	LOCK(*buff);
+	buff->throwIfLoading();
 	buff->throwIfInUse();
 	buff->loadFromArray(sr, channels, frames, data);
 	PUB_END
@@ -169,6 +462,7 @@ Lav_PUBLIC_FUNCTION LavError Lav_bufferNormalize(LavHandle bufferHandle) {
 	PUB_BEGIN
 	auto b = incomingObject<Buffer>(bufferHandle);
 	LOCK(*b);
+	b->throwIfLoading();
 	b->throwIfInUse();
 	b->normalize();
 	PUB_END
@@ -190,4 +484,114 @@ Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLengthInSamples(LavHandle bufferHandle
 	PUB_END
 }
 
+Lav_PUBLIC_FUNCTION LavError Lav_bufferLoadFromFileAsync(LavHandle bufferHandle, const char* path, LavBufferLoadedCallback callback, void* userdata) {
+	PUB_BEGIN
+	auto buff = incomingObject<Buffer>(bufferHandle);
+	std::string p = path;
+	int format;
+	{
+		LOCK(*buff);
+		buff->beginLoading();
+		format = buff->getStorageFormat();
+	}
+	loadBufferAsync(buff, [p, format] (Buffer& b) {
+		b.loadFromAsset(loadAsset(p, (int)b.getServer()->getSr(), format));
+	}, callback, userdata);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferDecodeFromArrayAsync(LavHandle bufferHandle, char* data, int datalen, LavBufferLoadedCallback callback, void* userdata) {
+	PUB_BEGIN
+	auto buff = incomingObject<Buffer>(bufferHandle);
+	//The caller may free data as soon as we return.
+	auto copy = std::make_shared<std::vector<char>>(data, data+datalen);
+	{
+		LOCK(*buff);
+		buff->beginLoading();
+	}
+	loadBufferAsync(buff, [copy] (Buffer& b) {
+		FileReader fr{};
+		fr.openFromBuffer(copy->data(), copy->size());
+		decodeFromFileReader(b, fr);
+	}, callback, userdata);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLoadState(LavHandle bufferHandle, int* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	*destination = b->getLoadState();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetLoadError(LavHandle bufferHandle, LavError* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	*destination = b->getLoadError();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferSetPlaysWhileLoading(LavHandle bufferHandle, int playsWhileLoading) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	b->setPlaysWhileLoading(playsWhileLoading != 0);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetPlaysWhileLoading(LavHandle bufferHandle, int* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	*destination = b->getPlaysWhileLoading();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_setBufferLoaderThreads(int threads) {
+	PUB_BEGIN
+	INITCHECK;
+	if(threads < 1) ERROR(Lav_ERROR_RANGE, "There must be at least one loader thread.");
+	setBufferLoaderThreads(threads);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_getBufferLoaderThreads(int* destination) {
+	PUB_BEGIN
+	INITCHECK;
+	*destination = getBufferLoaderThreads();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferSetStorageFormat(LavHandle bufferHandle, int format) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	if(format < Lav_BUFFER_STORAGE_FORMAT_FLOAT || format > Lav_BUFFER_STORAGE_FORMAT_ADPCM) ERROR(Lav_ERROR_RANGE, "Unknown storage format.");
+	LOCK(*b);
+	b->throwIfLoading();
+	b->throwIfInUse();
+	b->setStorageFormat(format);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetStorageFormat(LavHandle bufferHandle, int* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	*destination = b->getStorageFormat();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetSizeInBytes(LavHandle bufferHandle, int* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	LOCK(*b);
+	*destination = (int)b->getSize();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_bufferGetUnderruns(LavHandle bufferHandle, int* destination) {
+	PUB_BEGIN
+	auto b = incomingObject<Buffer>(bufferHandle);
+	LOCK(*b);
+	*destination = b->getUnderruns();
+	PUB_END
+}
+
 }
\ No newline at end of file
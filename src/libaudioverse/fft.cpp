@@ -0,0 +1,63 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/private/fft.hpp>
+#include <libaudioverse/private/error.hpp>
+#include <libaudioverse/private/macros.hpp>
+#include <kiss_fftr.h>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+namespace libaudioverse_implementation {
+
+//Plans die with their last user.
+std::map<std::tuple<int, bool>, std::weak_ptr<FftPlan>> *fft_plan_cache;
+std::mutex *fft_plan_cache_mutex;
+
+std::shared_ptr<FftPlan> getFftPlan(int size, bool inverse) {
+	if(size < 2 || size%2) ERROR(Lav_ERROR_RANGE, "Real ffts must be of even size.");
+	std::lock_guard<std::mutex> guard(*fft_plan_cache_mutex);
+	auto key = std::make_tuple(size, inverse);
+	auto &entry = (*fft_plan_cache)[key];
+	auto plan = entry.lock();
+	if(plan) return plan;
+	//The SSE backend knows which sizes it can do.
+	plan = createSseFftPlan(size, inverse);
+	if(plan == nullptr) plan = createKissFftPlan(size, inverse);
+	if(plan == nullptr) ERROR(Lav_ERROR_MEMORY, "Could not allocate fft.");
+	entry = plan;
+	return plan;
+}
+
+int nextFastFftSize(int minimum) {
+	#if defined(LIBAUDIOVERSE_USE_SSE2)
+	//The SSE backend wants multiples of 32 with no factors but 2, 3, and 5.
+	for(int size = std::max(32, (minimum+31)/32*32);; size += 32) {
+		int remaining = size;
+		for(int r: {2, 3, 5}) while(remaining%r == 0) remaining /= r;
+		if(remaining == 1) return size;
+	}
+	#else
+	return kiss_fftr_next_fast_size_real(minimum);
+	#endif
+}
+
+void initializeFftPlanCache() {
+	fft_plan_cache = new std::map<std::tuple<int, bool>, std::weak_ptr<FftPlan>>();
+	fft_plan_cache_mutex = new std::mutex();
+}
+
+void shutdownFftPlanCache() {
+	delete fft_plan_cache_mutex;
+	delete fft_plan_cache;
+}
+
+}
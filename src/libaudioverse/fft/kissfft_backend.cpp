@@ -0,0 +1,105 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**The portable fft backend.
+
+kiss_fftr keeps scratch space inside its configuration, so a configuration can't be shared between threads.
+We instead keep only the complex kiss_fft state and do kiss_fftr's twiddle pass ourselves with thread-local scratch.*/
+#include <libaudioverse/private/fft.hpp>
+#include <kiss_fft.h>
+#include <math.h>
+#include <vector>
+#include <memory>
+
+namespace libaudioverse_implementation {
+
+//This file is also built into the fft benchmark, so it avoids the rest of Libaudioverse.
+thread_local std::vector<kiss_fft_cpx> kiss_fft_plan_workspace;
+
+class KissFftPlan: public FftPlan {
+	public:
+	KissFftPlan(int size, bool inverse);
+	~KissFftPlan();
+	void fft(const float* input, kiss_fft_cpx* output) override;
+	void ifft(const kiss_fft_cpx* input, float* output) override;
+	kiss_fft_cfg substate = nullptr;
+	std::vector<kiss_fft_cpx> super_twiddles;
+};
+
+KissFftPlan::KissFftPlan(int size, bool inverse): FftPlan(size, inverse) {
+	int ncfft = size/2;
+	substate = kiss_fft_alloc(ncfft, inverse, nullptr, nullptr);
+	super_twiddles.resize(ncfft/2+1);
+	for(int i = 0; i < ncfft/2; i++) {
+		double phase = -3.141592653589793*((double)(i+1)/ncfft+0.5);
+		if(inverse) phase *= -1;
+		super_twiddles[i].r = (float)cos(phase);
+		super_twiddles[i].i = (float)sin(phase);
+	}
+}
+
+KissFftPlan::~KissFftPlan() {
+	if(substate) kiss_fft_free(substate);
+}
+
+void KissFftPlan::fft(const float* input, kiss_fft_cpx* output) {
+	int ncfft = size/2;
+	if(kiss_fft_plan_workspace.size() < ncfft) kiss_fft_plan_workspace.resize(ncfft);
+	kiss_fft_cpx* tmp = kiss_fft_plan_workspace.data();
+	kiss_fft(substate, (const kiss_fft_cpx*)input, tmp);
+	output[0].r = tmp[0].r+tmp[0].i;
+	output[ncfft].r = tmp[0].r-tmp[0].i;
+	output[0].i = output[ncfft].i = 0.0f;
+	for(int k = 1; k <= ncfft/2; k++) {
+		kiss_fft_cpx fpk = tmp[k], fpnk, f1k, f2k, tw;
+		fpnk.r = tmp[ncfft-k].r;
+		fpnk.i = -tmp[ncfft-k].i;
+		f1k.r = fpk.r+fpnk.r;
+		f1k.i = fpk.i+fpnk.i;
+		f2k.r = fpk.r-fpnk.r;
+		f2k.i = fpk.i-fpnk.i;
+		tw.r = f2k.r*super_twiddles[k-1].r-f2k.i*super_twiddles[k-1].i;
+		tw.i = f2k.r*super_twiddles[k-1].i+f2k.i*super_twiddles[k-1].r;
+		output[k].r = 0.5f*(f1k.r+tw.r);
+		output[k].i = 0.5f*(f1k.i+tw.i);
+		output[ncfft-k].r = 0.5f*(f1k.r-tw.r);
+		output[ncfft-k].i = 0.5f*(tw.i-f1k.i);
+	}
+}
+
+void KissFftPlan::ifft(const kiss_fft_cpx* input, float* output) {
+	int ncfft = size/2;
+	if(kiss_fft_plan_workspace.size() < ncfft) kiss_fft_plan_workspace.resize(ncfft);
+	kiss_fft_cpx* tmp = kiss_fft_plan_workspace.data();
+	tmp[0].r = input[0].r+input[ncfft].r;
+	tmp[0].i = input[0].r-input[ncfft].r;
+	for(int k = 1; k <= ncfft/2; k++) {
+		kiss_fft_cpx fk = input[k], fnkc, fek, fok, t;
+		fnkc.r = input[ncfft-k].r;
+		fnkc.i = -input[ncfft-k].i;
+		fek.r = fk.r+fnkc.r;
+		fek.i = fk.i+fnkc.i;
+		t.r = fk.r-fnkc.r;
+		t.i = fk.i-fnkc.i;
+		fok.r = t.r*super_twiddles[k-1].r-t.i*super_twiddles[k-1].i;
+		fok.i = t.r*super_twiddles[k-1].i+t.i*super_twiddles[k-1].r;
+		tmp[k].r = fek.r+fok.r;
+		tmp[k].i = fek.i+fok.i;
+		tmp[ncfft-k].r = fek.r-fok.r;
+		tmp[ncfft-k].i = -(fek.i-fok.i);
+	}
+	kiss_fft(substate, tmp, (kiss_fft_cpx*)output);
+}
+
+std::shared_ptr<FftPlan> createKissFftPlan(int size, bool inverse) {
+	auto p = std::make_shared<KissFftPlan>(size, inverse);
+	if(p->substate == nullptr) return nullptr;
+	return p;
+}
+
+}
@@ -0,0 +1,332 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**The SSE fft backend.
+
+A real fft of size n is a complex fft of size n/2 plus a twiddle pass, as in kiss_fftr.
+The complex fft is a mixed-radix (4, 2, 3, 5) Stockham fft on split real and imaginary arrays.
+The first stage is always radix 4 and is vectorized across butterflies, finishing with a 4x4 transpose.
+After it, the stride between butterfly inputs is a multiple of 4, so every later stage is vectorized across the stride with one twiddle per butterfly.
+This is why sizes must be multiples of 32.*/
+#include <libaudioverse/private/fft.hpp>
+#include <kiss_fft.h>
+#include <math.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#if defined(LIBAUDIOVERSE_USE_SSE2)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+namespace libaudioverse_implementation {
+
+#if defined(LIBAUDIOVERSE_USE_SSE2)
+
+//This file is also built into the fft benchmark, so it avoids the rest of Libaudioverse.
+thread_local std::vector<float> sse_fft_plan_workspace;
+
+struct SseComplex {
+	__m128 r, i;
+};
+
+inline SseComplex operator+(SseComplex a, SseComplex b) {
+	return {_mm_add_ps(a.r, b.r), _mm_add_ps(a.i, b.i)};
+}
+
+inline SseComplex operator-(SseComplex a, SseComplex b) {
+	return {_mm_sub_ps(a.r, b.r), _mm_sub_ps(a.i, b.i)};
+}
+
+inline SseComplex operator*(SseComplex a, SseComplex b) {
+	return {_mm_sub_ps(_mm_mul_ps(a.r, b.r), _mm_mul_ps(a.i, b.i)), _mm_add_ps(_mm_mul_ps(a.r, b.i), _mm_mul_ps(a.i, b.r))};
+}
+
+inline SseComplex scale(SseComplex a, __m128 c) {
+	return {_mm_mul_ps(a.r, c), _mm_mul_ps(a.i, c)};
+}
+
+//a*(i*c).
+inline SseComplex rotate(SseComplex a, __m128 c) {
+	return {_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(a.i, c)), _mm_mul_ps(a.r, c)};
+}
+
+inline SseComplex load(const float* r, const float* i) {
+	return {_mm_loadu_ps(r), _mm_loadu_ps(i)};
+}
+
+inline void store(float* r, float* i, SseComplex v) {
+	_mm_storeu_ps(r, v.r);
+	_mm_storeu_ps(i, v.i);
+}
+
+//Four interleaved kiss_fft_cpx to and from split form.
+inline SseComplex loadInterleaved(const kiss_fft_cpx* p) {
+	__m128 a = _mm_loadu_ps((const float*)p), b = _mm_loadu_ps((const float*)p+4);
+	return {_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))};
+}
+
+inline void storeInterleaved(float* p, SseComplex v) {
+	_mm_storeu_ps(p, _mm_unpacklo_ps(v.r, v.i));
+	_mm_storeu_ps(p+4, _mm_unpackhi_ps(v.r, v.i));
+}
+
+inline SseComplex reverse(SseComplex v) {
+	return {_mm_shuffle_ps(v.r, v.r, _MM_SHUFFLE(0, 1, 2, 3)), _mm_shuffle_ps(v.i, v.i, _MM_SHUFFLE(0, 1, 2, 3))};
+}
+
+//Butterfly constants with the direction folded into the sines.
+struct ButterflyConstants {
+	__m128 sign, half, sin3, cos5_1, cos5_2, sin5_1, sin5_2;
+};
+
+template<int R>
+void butterfly(SseComplex* a, const ButterflyConstants &c);
+
+template<>
+inline void butterfly<2>(SseComplex* a, const ButterflyConstants &c) {
+	SseComplex t = a[0]-a[1];
+	a[0] = a[0]+a[1];
+	a[1] = t;
+}
+
+template<>
+inline void butterfly<3>(SseComplex* a, const ButterflyConstants &c) {
+	SseComplex t = a[1]+a[2];
+	SseComplex m = a[0]-scale(t, c.half);
+	SseComplex e = rotate(a[1]-a[2], c.sin3);
+	a[0] = a[0]+t;
+	a[1] = m+e;
+	a[2] = m-e;
+}
+
+template<>
+inline void butterfly<4>(SseComplex* a, const ButterflyConstants &c) {
+	SseComplex t0 = a[0]+a[2], t1 = a[0]-a[2], t2 = a[1]+a[3];
+	SseComplex t3 = rotate(a[1]-a[3], c.sign);
+	a[0] = t0+t2;
+	a[1] = t1+t3;
+	a[2] = t0-t2;
+	a[3] = t1-t3;
+}
+
+template<>
+inline void butterfly<5>(SseComplex* a, const ButterflyConstants &c) {
+	SseComplex t1 = a[1]+a[4], t2 = a[2]+a[3], t3 = a[1]-a[4], t4 = a[2]-a[3];
+	SseComplex p1 = a[0]+scale(t1, c.cos5_1)+scale(t2, c.cos5_2);
+	SseComplex p2 = a[0]+scale(t1, c.cos5_2)+scale(t2, c.cos5_1);
+	SseComplex e1 = rotate(t3, c.sin5_1)+rotate(t4, c.sin5_2);
+	SseComplex e2 = rotate(t3, c.sin5_2)-rotate(t4, c.sin5_1);
+	a[0] = a[0]+t1+t2;
+	a[1] = p1+e1;
+	a[4] = p1-e1;
+	a[2] = p2+e2;
+	a[3] = p2-e2;
+}
+
+class SseFftPlan: public FftPlan {
+	public:
+	SseFftPlan(int size, bool inverse);
+	void fft(const float* input, kiss_fft_cpx* output) override;
+	void ifft(const kiss_fft_cpx* input, float* output) override;
+	private:
+	struct Stage {
+		int radix, m, s, twiddle_offset;
+	};
+	//Runs the complex fft from (re, im), using (scratchRe, scratchIm).  The result is in whichever pair is returned in re and im.
+	void complexFft(float* &re, float* &im, float* &scratchRe, float* &scratchIm);
+	void firstStage(const Stage &stage, const float* xr, const float* xi, float* yr, float* yi);
+	template<int R>
+	void stage(const Stage &stage, const float* xr, const float* xi, float* yr, float* yi);
+	int ncfft;
+	ButterflyConstants constants;
+	std::vector<Stage> stages;
+	std::vector<float> twiddles_re, twiddles_im, super_twiddles_re, super_twiddles_im;
+};
+
+SseFftPlan::SseFftPlan(int size, bool inverse): FftPlan(size, inverse) {
+	const double pi = 3.141592653589793;
+	double sign = inverse ? 1.0 : -1.0;
+	ncfft = size/2;
+	constants.sign = _mm_set1_ps((float)sign);
+	constants.half = _mm_set1_ps(0.5f);
+	constants.sin3 = _mm_set1_ps((float)(sign*sin(2*pi/3)));
+	constants.cos5_1 = _mm_set1_ps((float)cos(2*pi/5));
+	constants.cos5_2 = _mm_set1_ps((float)cos(4*pi/5));
+	constants.sin5_1 = _mm_set1_ps((float)(sign*sin(2*pi/5)));
+	constants.sin5_2 = _mm_set1_ps((float)(sign*sin(4*pi/5)));
+	//Radix 4 first, as many 4s as possible, then the rest.
+	std::vector<int> radixes;
+	int remaining = ncfft;
+	while(remaining%4 == 0) {
+		radixes.push_back(4);
+		remaining /= 4;
+	}
+	for(int r: {2, 3, 5}) {
+		while(remaining%r == 0) {
+			radixes.push_back(r);
+			remaining /= r;
+		}
+	}
+	int s = 1, n = ncfft;
+	for(int r: radixes) {
+		Stage st;
+		st.radix = r;
+		st.m = n/r;
+		st.s = s;
+		st.twiddle_offset = (int)twiddles_re.size();
+		for(int k = 1; k < r; k++) {
+			for(int p = 0; p < st.m; p++) {
+				double phase = sign*2*pi*p*k/n;
+				twiddles_re.push_back((float)cos(phase));
+				twiddles_im.push_back((float)sin(phase));
+			}
+		}
+		stages.push_back(st);
+		s *= r;
+		n /= r;
+	}
+	super_twiddles_re.resize(ncfft/2+4);
+	super_twiddles_im.resize(ncfft/2+4);
+	for(int i = 0; i < ncfft/2; i++) {
+		double phase = sign*pi*((double)(i+1)/ncfft+0.5);
+		super_twiddles_re[i] = (float)cos(phase);
+		super_twiddles_im[i] = (float)sin(phase);
+	}
+}
+
+void SseFftPlan::firstStage(const Stage &st, const float* xr, const float* xi, float* yr, float* yi) {
+	int m = st.m;
+	const float* twr = twiddles_re.data()+st.twiddle_offset, *twi = twiddles_im.data()+st.twiddle_offset;
+	for(int p = 0; p < m; p += 4) {
+		SseComplex a[4];
+		for(int j = 0; j < 4; j++) a[j] = load(xr+p+j*m, xi+p+j*m);
+		butterfly<4>(a, constants);
+		for(int k = 1; k < 4; k++) a[k] = a[k]*load(twr+(k-1)*m+p, twi+(k-1)*m+p);
+		//a[k] holds output k of butterflies p..p+3, which belongs at 4*(p+lane)+k.
+		_MM_TRANSPOSE4_PS(a[0].r, a[1].r, a[2].r, a[3].r);
+		_MM_TRANSPOSE4_PS(a[0].i, a[1].i, a[2].i, a[3].i);
+		for(int l = 0; l < 4; l++) store(yr+4*(p+l), yi+4*(p+l), a[l]);
+	}
+}
+
+template<int R>
+void SseFftPlan::stage(const Stage &st, const float* xr, const float* xi, float* yr, float* yi) {
+	int m = st.m, s = st.s;
+	const float* twr = twiddles_re.data()+st.twiddle_offset, *twi = twiddles_im.data()+st.twiddle_offset;
+	for(int p = 0; p < m; p++) {
+		SseComplex w[R];
+		for(int k = 1; k < R; k++) w[k] = {_mm_set1_ps(twr[(k-1)*m+p]), _mm_set1_ps(twi[(k-1)*m+p])};
+		for(int q = 0; q < s; q += 4) {
+			SseComplex a[R];
+			for(int j = 0; j < R; j++) a[j] = load(xr+q+s*(p+j*m), xi+q+s*(p+j*m));
+			butterfly<R>(a, constants);
+			store(yr+q+s*R*p, yi+q+s*R*p, a[0]);
+			for(int k = 1; k < R; k++) store(yr+q+s*(R*p+k), yi+q+s*(R*p+k), a[k]*w[k]);
+		}
+	}
+}
+
+void SseFftPlan::complexFft(float* &re, float* &im, float* &scratchRe, float* &scratchIm) {
+	for(auto &st: stages) {
+		if(st.s == 1) firstStage(st, re, im, scratchRe, scratchIm);
+		else if(st.radix == 4) stage<4>(st, re, im, scratchRe, scratchIm);
+		else if(st.radix == 2) stage<2>(st, re, im, scratchRe, scratchIm);
+		else if(st.radix == 3) stage<3>(st, re, im, scratchRe, scratchIm);
+		else stage<5>(st, re, im, scratchRe, scratchIm);
+		std::swap(re, scratchRe);
+		std::swap(im, scratchIm);
+	}
+}
+
+void SseFftPlan::fft(const float* input, kiss_fft_cpx* output) {
+	if(sse_fft_plan_workspace.size() < 4*ncfft) sse_fft_plan_workspace.resize(4*ncfft);
+	float* re = sse_fft_plan_workspace.data(), *im = re+ncfft, *scratchRe = im+ncfft, *scratchIm = scratchRe+ncfft;
+	//Even samples are the real part and odd samples the imaginary part.
+	for(int i = 0; i < ncfft; i += 4) {
+		__m128 a = _mm_loadu_ps(input+2*i), b = _mm_loadu_ps(input+2*i+4);
+		_mm_storeu_ps(re+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(im+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	complexFft(re, im, scratchRe, scratchIm);
+	output[0].r = re[0]+im[0];
+	output[ncfft].r = re[0]-im[0];
+	output[0].i = output[ncfft].i = 0.0f;
+	int half = ncfft/2, k = 1;
+	const __m128 halfr = _mm_set1_ps(0.5f);
+	for(; k+3 < half; k += 4) {
+		SseComplex fpk = load(re+k, im+k);
+		SseComplex fpnk = reverse(load(re+ncfft-k-3, im+ncfft-k-3));
+		fpnk.i = _mm_sub_ps(_mm_setzero_ps(), fpnk.i);
+		SseComplex f1k = fpk+fpnk, f2k = fpk-fpnk;
+		SseComplex tw = f2k*load(super_twiddles_re.data()+k-1, super_twiddles_im.data()+k-1);
+		storeInterleaved((float*)(output+k), scale(f1k+tw, halfr));
+		SseComplex low = {_mm_mul_ps(_mm_sub_ps(f1k.r, tw.r), halfr), _mm_mul_ps(_mm_sub_ps(tw.i, f1k.i), halfr)};
+		storeInterleaved((float*)(output+ncfft-k-3), reverse(low));
+	}
+	for(; k <= half; k++) {
+		float fpkr = re[k], fpki = im[k], fpnkr = re[ncfft-k], fpnki = -im[ncfft-k];
+		float f1kr = fpkr+fpnkr, f1ki = fpki+fpnki, f2kr = fpkr-fpnkr, f2ki = fpki-fpnki;
+		float twr = f2kr*super_twiddles_re[k-1]-f2ki*super_twiddles_im[k-1];
+		float twi = f2kr*super_twiddles_im[k-1]+f2ki*super_twiddles_re[k-1];
+		output[k].r = 0.5f*(f1kr+twr);
+		output[k].i = 0.5f*(f1ki+twi);
+		output[ncfft-k].r = 0.5f*(f1kr-twr);
+		output[ncfft-k].i = 0.5f*(twi-f1ki);
+	}
+}
+
+void SseFftPlan::ifft(const kiss_fft_cpx* input, float* output) {
+	if(sse_fft_plan_workspace.size() < 4*ncfft) sse_fft_plan_workspace.resize(4*ncfft);
+	float* re = sse_fft_plan_workspace.data(), *im = re+ncfft, *scratchRe = im+ncfft, *scratchIm = scratchRe+ncfft;
+	re[0] = input[0].r+input[ncfft].r;
+	im[0] = input[0].r-input[ncfft].r;
+	int half = ncfft/2, k = 1;
+	for(; k+3 < half; k += 4) {
+		SseComplex fk = loadInterleaved(input+k);
+		SseComplex fnkc = reverse(loadInterleaved(input+ncfft-k-3));
+		fnkc.i = _mm_sub_ps(_mm_setzero_ps(), fnkc.i);
+		SseComplex fek = fk+fnkc;
+		SseComplex fok = (fk-fnkc)*load(super_twiddles_re.data()+k-1, super_twiddles_im.data()+k-1);
+		store(re+k, im+k, fek+fok);
+		SseComplex low = fek-fok;
+		low.i = _mm_sub_ps(_mm_setzero_ps(), low.i);
+		low = reverse(low);
+		store(re+ncfft-k-3, im+ncfft-k-3, low);
+	}
+	for(; k <= half; k++) {
+		float fkr = input[k].r, fki = input[k].i, fnkcr = input[ncfft-k].r, fnkci = -input[ncfft-k].i;
+		float fekr = fkr+fnkcr, feki = fki+fnkci, tr = fkr-fnkcr, ti = fki-fnkci;
+		float fokr = tr*super_twiddles_re[k-1]-ti*super_twiddles_im[k-1];
+		float foki = tr*super_twiddles_im[k-1]+ti*super_twiddles_re[k-1];
+		re[k] = fekr+fokr;
+		im[k] = feki+foki;
+		re[ncfft-k] = fekr-fokr;
+		im[ncfft-k] = -(feki-foki);
+	}
+	complexFft(re, im, scratchRe, scratchIm);
+	for(int i = 0; i < ncfft; i += 4) storeInterleaved(output+2*i, load(re+i, im+i));
+}
+
+std::shared_ptr<FftPlan> createSseFftPlan(int size, bool inverse) {
+	if(size < 32 || size%32) return nullptr;
+	int remaining = size;
+	for(int r: {2, 3, 5}) while(remaining%r == 0) remaining /= r;
+	if(remaining != 1) return nullptr;
+	return std::make_shared<SseFftPlan>(size, inverse);
+}
+
+#else
+
+std::shared_ptr<FftPlan> createSseFftPlan(int size, bool inverse) {
+	return nullptr;
+}
+
+#endif
+
+}
@@ -25,18 +25,29 @@ FileWriter::~FileWriter() {
 	if(handle) close(); //make sure the file gets closed behind us.
 }
 
-void FileWriter::open(const char* path, int sr, int channels) {
+void FileWriter::open(const char* path, int sr, int channels, int format) {
 	if(handle) close();
 	if(sr<= 0) ERROR(Lav_ERROR_RANGE, "sr must be positive.");
 	if(channels <= 0) ERROR(Lav_ERROR_RANGE, "Channels must be positive.");
-	int length = strlen(path);
-	if(length < 4) ERROR(Lav_ERROR_FILE, "File must have a 3-character extension.");
-	if(path[length-4] != '.') ERROR(Lav_ERROR_FILE, "File must have a 3-letter extension.");
+	const char* dot = strrchr(path, '.');
+	if(dot == nullptr || dot[1] == '\0') ERROR(Lav_ERROR_FILE, "File must have an extension.");
 	//convert to a C++ string for sanity.
-	std::string extension(path+length-3);
-	if(extension =="wav") info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+	std::string extension(dot+1);
+	int subtype;
+	switch(format) {
+		case Lav_RECORDING_FORMAT_PCM16: subtype = SF_FORMAT_PCM_16; break;
+		case Lav_RECORDING_FORMAT_PCM24: subtype = SF_FORMAT_PCM_24; break;
+		case Lav_RECORDING_FORMAT_FLOAT: subtype = SF_FORMAT_FLOAT; break;
+		default: ERROR(Lav_ERROR_RANGE, "Unknown recording format.");
+	}
+	if(extension =="wav") info.format = SF_FORMAT_WAV | subtype;
+	else if(extension == "caf") info.format = SF_FORMAT_CAF | subtype;
+	else if(extension == "flac") {
+		if(format == Lav_RECORDING_FORMAT_FLOAT) ERROR(Lav_ERROR_FILE, "FLAC can't hold floating point samples.");
+		info.format = SF_FORMAT_FLAC | subtype;
+	}
 	else if(extension == "ogg") info.format = SF_FORMAT_OGG | SF_FORMAT_VORBIS;
-	else ERROR(Lav_ERROR_FILE, "Cannot handle extension"+extension);
+	else ERROR(Lav_ERROR_FILE, "Cannot handle extension "+extension);
 	info.samplerate =sr;
 	info.channels=channels;
 	#ifdef WIN32
@@ -49,6 +60,8 @@ void FileWriter::open(const char* path, int sr, int channels) {
 	if(handle == nullptr) {
 		ERROR(Lav_ERROR_FILE, std::string("Libsndfile failed to open ")+path+" for writing.");
 	}
+	//Libsndfile wraps samples louder than 1.0 around when converting to integers unless told otherwise.
+	sf_command(handle, SFC_SET_CLIPPING, nullptr, SF_TRUE);
 }
 
 void FileWriter::close() {
@@ -20,12 +20,12 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/data.hpp>
 #include <libaudioverse/private/memory.hpp>
 #include <libaudioverse/private/utf8.hpp>
+#include <libaudioverse/private/fft.hpp>
 #include <powercores/thread_local_variable.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <math.h>
-#include <kiss_fftr.h>
 #include <memory>
 #include <algorithm>
 #include <map>
@@ -51,6 +51,9 @@ void reverse_endianness(char* buffer, unsigned int count, unsigned int window) {
 //this makes sure that we aren't about to do something silently dangerous and tels us at compile time.
 static_assert(sizeof(float) == 4, "Sizeof float is not 4; cannot safely work with hrtfs");
 
+//Every hrir in the slab starts on a boundary of this many bytes.
+const int hrtf_slab_alignment = 64;
+
 HrtfData::HrtfData():
 //We have to give the thread-local variables constructors and destructors.
 temporary_buffer1([&]() {
@@ -75,14 +78,13 @@ temporary_buffer2([&] () {
 }
 
 HrtfData::~HrtfData() {
-	if(hrirs == nullptr) return; //we never loaded one.
-	for(int i = 0; i < elev_count; i++) {
-		//The staticResamplerKernel allocates with new[], not allocArray.
-		for(int j = 0; j < azimuth_counts[i]; j++) delete[] hrirs[i][j];
-		delete[] hrirs[i];
-	}
-	delete[] hrirs;
-	delete[] azimuth_counts;
+	//Cached hrtfs have no allocation; the slab belongs to cache_mapping.
+	if(hrir_allocation) freeArray(hrir_allocation);
+	if(azimuth_counts) delete[] azimuth_counts;
+	if(elevation_offsets) delete[] elevation_offsets;
+	if(delays) delete[] delays;
+	if(grid) freeArray(grid);
+	if(grid_delays) delete[] grid_delays;
 }
 
 int HrtfData::getLength() {
@@ -147,6 +149,11 @@ void HrtfData::loadFromBuffer(unsigned int length, char* buffer, unsigned int fo
 	int32_t sum_sanity_check = 0;
 	for(int i = 0; i < elev_count; i++) sum_sanity_check +=azimuth_counts[i];
 	if(sum_sanity_check != hrir_count) ERROR(Lav_ERROR_HRTF_INVALID, "Not enough or too many responses.");
+	elevation_offsets = new int[elev_count];
+	for(int i = 0, offset = 0; i < elev_count; i++) {
+		elevation_offsets[i] = offset;
+		offset += azimuth_counts[i];
+	}
 
 	int before_hrir_length = convi(iterator);
 	iterator += window_size;
@@ -157,34 +164,255 @@ void HrtfData::loadFromBuffer(unsigned int length, char* buffer, unsigned int fo
 	size_t hrir_size = before_hrir_length*hrir_count*sizeof(float);
 	if(hrir_size != size_remaining) ERROR(Lav_ERROR_HRTF_INVALID, "Not enough HRIR data.");
 
-	//last step.  Initialize the HRIR array.
-	hrirs = new float**[elev_count];
-	//do the azimuth dimension.
-	for(int i = 0; i < elev_count; i++) {
-		hrirs[i] = new float*[azimuth_counts[i]];
-	}
-
-	//the above gives us what amounts to a 2d array.  The first dimension represents elevation.  The second dimension represents azimuth going clockwise.
-	//fill it.
+	//last step.  Resample the hrirs, which come in file order: by elevation, then by azimuth going clockwise.
+	//We don't know the resampled length until the first one, so they go into the slab afterwords.
 	float* tempBuffer = allocArray<float>(before_hrir_length);
+	float** resampled = new float*[hrir_count];
 	int final_hrir_length = 0;
-	for(int elev = 0; elev < elev_count; elev++) {
-		for(int azimuth = 0; azimuth < azimuth_counts[elev]; azimuth++) {
-			memcpy(tempBuffer, iterator, sizeof(float)*before_hrir_length);
-			staticResamplerKernel(samplerate, forSr, 1, before_hrir_length, tempBuffer, &final_hrir_length, &hrirs[elev][azimuth]);
-			iterator+=before_hrir_length*sizeof(float);
-		}
+	for(int i = 0; i < hrir_count; i++) {
+		memcpy(tempBuffer, iterator, sizeof(float)*before_hrir_length);
+		staticResamplerKernel(samplerate, forSr, 1, before_hrir_length, tempBuffer, &final_hrir_length, &resampled[i]);
+		iterator+=before_hrir_length*sizeof(float);
 	}
+	freeArray(tempBuffer);
 	hrir_length = final_hrir_length;
 	samplerate = forSr;
-	freeArray(tempBuffer);
+	allocateSlab();
+	for(int i = 0; i < hrir_count; i++) {
+		std::copy(resampled[i], resampled[i]+hrir_length, hrir_slab+i*hrir_stride);
+		//The staticResamplerKernel allocates with new[], not allocArray.
+		delete[] resampled[i];
+	}
+	delete[] resampled;
 }
 
-//a complete HRTF for stereo is two calls to this function.
-//some final preparation is done afterwords.
+void HrtfData::allocateSlab() {
+	const int floatsPerLine = hrtf_slab_alignment/sizeof(float);
+	hrir_stride = (hrir_length+floatsPerLine-1)/floatsPerLine*floatsPerLine;
+	//allocArray only promises LIBAUDIOVERSE_MALLOC_ALIGNMENT, so overallocate by a line and round up.
+	hrir_allocation = allocArray<float>(hrir_stride*hrir_count+floatsPerLine);
+	hrir_slab = (float*)(((uintptr_t)hrir_allocation+hrtf_slab_alignment-1)&~(uintptr_t)(hrtf_slab_alignment-1));
+}
+
+float* HrtfData::getHrir(int elevation, int azimuth) {
+	return hrir_slab+(elevation_offsets[elevation]+azimuth)*hrir_stride;
+}
+
+//Where the response starts: the fractional position at which it first reaches this fraction of its peak.
+const float hrtf_onset_threshold = 0.1f;
+
+float findOnset(int length, float* response) {
+	float peak = 0.0f;
+	for(int i = 0; i < length; i++) peak = std::max(peak, fabsf(response[i]));
+	float threshold = peak*hrtf_onset_threshold;
+	for(int i = 0; i < length; i++) {
+		float current = fabsf(response[i]);
+		if(current < threshold) continue;
+		if(i == 0) return 0.0f;
+		float previous = fabsf(response[i-1]);
+		return i-1+(threshold-previous)/(current-previous);
+	}
+	return 0.0f;
+}
+
+void HrtfData::convertToMinimumPhase(int length) {
+	if(length <= 0 || delays) return;
+	//Real cepstrum method: fold the cepstrum of the log magnitude onto positive time and exponentiate.
+	//The fft has to be long compared to the hrir, or the cepstrum aliases.
+	int fftSize = nextFastFftSize(std::max(8*hrir_length, 512));
+	int binCount = fftSize/2+1;
+	auto fft = getFftPlan(fftSize, false);
+	auto ifft = getFftPlan(fftSize, true);
+	float* time = allocArray<float>(fftSize);
+	kiss_fft_cpx* spectrum = allocArray<kiss_fft_cpx>(binCount);
+	int newLength = std::min(length, hrir_length);
+	float* oldAllocation = hrir_allocation, *oldSlab = hrir_slab;
+	int oldStride = hrir_stride, oldLength = hrir_length;
+	hrir_length = newLength;
+	allocateSlab();
+	delays = new float[hrir_count];
+	minimum_phase_length = length;
+	float scale = 1.0f/fftSize;
+	for(int i = 0; i < hrir_count; i++) {
+		float* hrir = oldSlab+i*oldStride;
+		delays[i] = findOnset(oldLength, hrir);
+		std::fill(time, time+fftSize, 0.0f);
+		std::copy(hrir, hrir+oldLength, time);
+		fft->fft(time, spectrum);
+		for(int j = 0; j < binCount; j++) {
+			//The floor keeps spectral zeros from becoming infinities.
+			spectrum[j].r = logf(std::max(hypotf(spectrum[j].r, spectrum[j].i), 1e-9f));
+			spectrum[j].i = 0.0f;
+		}
+		ifft->ifft(spectrum, time);
+		time[0] *= scale;
+		for(int j = 1; j < fftSize/2; j++) time[j] *= 2.0f*scale;
+		time[fftSize/2] *= scale;
+		std::fill(time+fftSize/2+1, time+fftSize, 0.0f);
+		fft->fft(time, spectrum);
+		for(int j = 0; j < binCount; j++) {
+			float magnitude = expf(spectrum[j].r), phase = spectrum[j].i;
+			spectrum[j].r = magnitude*cosf(phase);
+			spectrum[j].i = magnitude*sinf(phase);
+		}
+		ifft->ifft(spectrum, time);
+		scalarMultiplicationKernel(hrir_length, scale, time, hrir_slab+i*hrir_stride);
+	}
+	//Delay common to every response is latency, not localization.
+	float minDelay = *std::min_element(delays, delays+hrir_count);
+	max_delay = 0.0f;
+	for(int i = 0; i < hrir_count; i++) {
+		delays[i] -= minDelay;
+		max_delay = std::max(max_delay, delays[i]);
+	}
+	freeArray(time);
+	freeArray(spectrum);
+	freeArray(oldAllocation);
+}
+
+bool HrtfData::hasDelays() {
+	return delays != nullptr;
+}
+
+float HrtfData::getMaxDelay() {
+	return max_delay;
+}
+
+int HrtfData::getSr() {
+	return samplerate;
+}
+
+int HrtfData::getMinimumPhaseLength() {
+	return minimum_phase_length;
+}
+
+/**The on-disk cache format.
+All sections start on hrtf_slab_alignment boundaries, so the slab can be used straight out of a mapping:
+the header, then azimuth_counts, then delays if has_delays is set, then the slab.
+Everything is in native byte order; endianness tells us if the file came from elsewhere.*/
+const char hrtf_cache_magic[8] = {'L', 'A', 'V', 'H', 'R', 'T', 'F', 'C'};
+const int32_t hrtf_cache_version = 1;
+
+struct HrtfCacheHeader {
+	char magic[8];
+	int32_t version, endianness;
+	char identity[16];
+	int32_t samplerate, hrir_count, elev_count, min_elevation, max_elevation;
+	int32_t hrir_length, hrir_stride, minimum_phase_length, has_delays;
+	float max_delay;
+};
+
+size_t alignCacheOffset(size_t offset) {
+	return (offset+hrtf_slab_alignment-1)/hrtf_slab_alignment*hrtf_slab_alignment;
+}
+
+//Offsets of each section, and the total size.
+struct HrtfCacheLayout {
+	size_t azimuth_counts, delays, slab, size;
+};
+
+HrtfCacheLayout computeCacheLayout(const HrtfCacheHeader &header) {
+	HrtfCacheLayout layout;
+	layout.azimuth_counts = alignCacheOffset(sizeof(HrtfCacheHeader));
+	layout.delays = alignCacheOffset(layout.azimuth_counts+sizeof(int32_t)*header.elev_count);
+	layout.slab = header.has_delays ? alignCacheOffset(layout.delays+sizeof(float)*header.hrir_count) : layout.delays;
+	layout.size = layout.slab+sizeof(float)*(size_t)header.hrir_count*header.hrir_stride;
+	return layout;
+}
+
+void writeCachePadding(boost::filesystem::ofstream &f, size_t to) {
+	while((size_t)f.tellp() < to) f.put(0);
+}
+
+void HrtfData::saveToCache(std::string path, const char* identity) {
+	HrtfCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, hrtf_cache_magic, 8);
+	header.version = hrtf_cache_version;
+	header.endianness = 1;
+	memcpy(header.identity, identity, 16);
+	header.samplerate = samplerate;
+	header.hrir_count = hrir_count;
+	header.elev_count = elev_count;
+	header.min_elevation = min_elevation;
+	header.max_elevation = max_elevation;
+	header.hrir_length = hrir_length;
+	header.hrir_stride = hrir_stride;
+	header.minimum_phase_length = minimum_phase_length;
+	header.has_delays = delays != nullptr;
+	header.max_delay = max_delay;
+	auto layout = computeCacheLayout(header);
+	boost::filesystem::ofstream f(boost::filesystem::path(utf8ToWide(path)), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(f.good() == false) ERROR(Lav_ERROR_FILE, std::string("Could not open HRTF cache ")+path+" for writing.");
+	f.write((char*)&header, sizeof(header));
+	writeCachePadding(f, layout.azimuth_counts);
+	for(int i = 0; i < elev_count; i++) {
+		int32_t count = azimuth_counts[i];
+		f.write((char*)&count, sizeof(count));
+	}
+	writeCachePadding(f, layout.delays);
+	if(delays) {
+		f.write((char*)delays, sizeof(float)*hrir_count);
+		writeCachePadding(f, layout.slab);
+	}
+	f.write((char*)hrir_slab, sizeof(float)*(size_t)hrir_count*hrir_stride);
+	if(f.good() == false) ERROR(Lav_ERROR_FILE, std::string("Could not write HRTF cache ")+path);
+}
+
+void HrtfData::loadFromCache(std::string path, char* identity) {
+	std::shared_ptr<boost::iostreams::mapped_file_source> map;
+	try {
+		map = std::make_shared<boost::iostreams::mapped_file_source>(boost::filesystem::path(utf8ToWide(path)));
+	}
+	catch(std::ios_base::failure &e) {
+		ERROR(Lav_ERROR_FILE, std::string("Could not open HRTF cache ")+path);
+	}
+	const char* data = map->data();
+	HrtfCacheHeader header;
+	if(map->size() < sizeof(header)) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache is truncated.");
+	memcpy(&header, data, sizeof(header));
+	if(memcmp(header.magic, hrtf_cache_magic, 8) != 0) ERROR(Lav_ERROR_HRTF_INVALID, "Not an HRTF cache.");
+	if(header.endianness != 1) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache was made on a machine with a different byte order.");
+	if(header.version != hrtf_cache_version) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache is from a different version of Libaudioverse.");
+	if(header.elev_count <= 0 || header.hrir_count <= 0 || header.hrir_length <= 0 || header.hrir_stride < header.hrir_length
+	|| header.hrir_stride%(hrtf_slab_alignment/sizeof(float)) != 0) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache header is corrupt.");
+	auto layout = computeCacheLayout(header);
+	if(map->size() != layout.size) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache is the wrong size.");
+	samplerate = header.samplerate;
+	hrir_count = header.hrir_count;
+	elev_count = header.elev_count;
+	min_elevation = header.min_elevation;
+	max_elevation = header.max_elevation;
+	hrir_length = header.hrir_length;
+	hrir_stride = header.hrir_stride;
+	minimum_phase_length = header.minimum_phase_length;
+	max_delay = header.max_delay;
+	azimuth_counts = new int[elev_count];
+	elevation_offsets = new int[elev_count];
+	int sum = 0;
+	for(int i = 0; i < elev_count; i++) {
+		int32_t count;
+		memcpy(&count, data+layout.azimuth_counts+i*sizeof(int32_t), sizeof(count));
+		if(count < 1) ERROR(Lav_ERROR_HRTF_INVALID, "Every elevation needs at least one response.");
+		azimuth_counts[i] = count;
+		elevation_offsets[i] = sum;
+		sum += count;
+	}
+	if(sum != hrir_count) ERROR(Lav_ERROR_HRTF_INVALID, "Not enough or too many responses.");
+	if(header.has_delays) {
+		delays = new float[hrir_count];
+		memcpy(delays, data+layout.delays, sizeof(float)*hrir_count);
+	}
+	//Mappings are page-aligned and the format aligns the slab, so nothing needs copying.
+	hrir_slab = (float*)(data+layout.slab);
+	cache_mapping = map;
+	memcpy(identity, header.identity, 16);
+}
+
+//This works out which 4 measured responses make up a direction and how to weight them.
 //This is very complicated, thus the heavy commenting.
 //todo: can this be made simpler?
-void HrtfData::computeCoefficientsMono(float elevation, float azimuth, float* out) {
+void HrtfData::computeTaps(float elevation, float azimuth, HrtfTap* taps) {
 	//clamp the elevation.
 	if(elevation < min_elevation) {elevation = (float)min_elevation;}
 	else if(elevation > max_elevation) {elevation = (float)max_elevation;}
@@ -215,10 +443,8 @@ void HrtfData::computeCoefficientsMono(float elevation, float azimuth, float* ou
 	elevationWeights[0] = (degreesPerElevation-ringmoddedElevation)/degreesPerElevation;
 	elevationWeights[1] = ringmoddedElevation/degreesPerElevation;
 
-	memset(out, 0, sizeof(float)*hrir_length);
 	for(int i = 0; i < 2; i++) {
 		//ElevationIndex lets us get an array of azimuth coefficients.  Go ahead and pull it out now, so we can conceptually forget about all the above variables.
-		float** azimuths = hrirs[elevationIndex[i]];
 		int azimuthCount = azimuth_counts[elevationIndex[i]];
 		float degreesPerAzimuth = 360.0f/azimuthCount;
 		int azimuthIndex1, azimuthIndex2;
@@ -232,13 +458,39 @@ void HrtfData::computeCoefficientsMono(float elevation, float azimuth, float* ou
 		azimuthIndex1 = ringmodi(azimuthIndex1, azimuthCount);
 		azimuthIndex2 = ringmodi(azimuthIndex2, azimuthCount);
 
-		//this is probably the only part of this that can't go wrong, assuming the above calculations are all correct.  Interpolate between the two azimuths.
-		for(int j = 0; j < hrir_length; j++) {
-			out[j] += elevationWeights[i]*(azimuthWeight1*azimuths[azimuthIndex1][j]+azimuthWeight2*azimuths[azimuthIndex2][j]);
-		}
+		taps[2*i] = {elevationIndex[i], azimuthIndex1, (float)(elevationWeights[i]*azimuthWeight1)};
+		taps[2*i+1] = {elevationIndex[i], azimuthIndex2, (float)(elevationWeights[i]*azimuthWeight2)};
 	}
 }
 
+//a complete HRTF for stereo is two calls to this function.
+//some final preparation is done afterwords.
+void HrtfData::computeCoefficientsMono(float elevation, float azimuth, float* out) {
+	HrtfTap taps[4];
+	computeTaps(elevation, azimuth, taps);
+	memset(out, 0, sizeof(float)*hrir_length);
+	//this is probably the only part of this that can't go wrong, assuming the above calculations are all correct.  Interpolate between the four responses.
+	for(int i = 0; i < 4; i++) {
+		multiplicationAdditionKernel(hrir_length, taps[i].weight, getHrir(taps[i].elevation, taps[i].azimuth), out, out);
+	}
+}
+
+float HrtfData::computeDelayMono(float elevation, float azimuth) {
+	HrtfTap taps[4];
+	computeTaps(elevation, azimuth, taps);
+	float delay = 0.0f;
+	for(int i = 0; i < 4; i++) delay += taps[i].weight*delays[elevation_offsets[taps[i].elevation]+taps[i].azimuth];
+	return delay;
+}
+
+void HrtfData::computeDelaysStereo(float elevation, float azimuth, float* left, float* right) {
+	//Same reflection as computeCoefficientsStereo.
+	azimuth = ringmodf(azimuth, 360.0f);
+	*right = computeDelayMono(elevation, azimuth);
+	azimuth = ringmodf(360-azimuth, 360.0f);
+	*left = computeDelayMono(elevation, azimuth);
+}
+
 void HrtfData::computeCoefficientsStereo(float elevation, float azimuth, float *left, float* right) {
 	//wrap azimuth to be > 0 and < 360.
 	azimuth = ringmodf(azimuth, 360.0f);
@@ -249,6 +501,129 @@ void HrtfData::computeCoefficientsStereo(float elevation, float azimuth, float *
 	computeCoefficientsMono(elevation, azimuth, left);
 }
 
+//Grid resolutions as (elevation step, azimuth step) in degrees, finest first.
+const int hrtf_grid_resolutions[][2] = {
+	{1, 1}, {1, 2}, {1, 5}, {2, 5}, {5, 5}, {5, 10}, {10, 10}, {10, 15},
+};
+
+bool HrtfData::buildGrid(size_t budget) {
+	if(grid) freeArray(grid);
+	if(grid_delays) delete[] grid_delays;
+	grid = nullptr;
+	grid_delays = nullptr;
+	grid_elevation_count = grid_azimuth_count = 0;
+	if(budget == 0) return false;
+	for(auto &resolution: hrtf_grid_resolutions) {
+		int elevationStep = resolution[0], azimuthStep = resolution[1];
+		//Round up so that max_elevation has a point of its own.
+		int elevations = (max_elevation-min_elevation+elevationStep-1)/elevationStep+1;
+		int azimuths = 360/azimuthStep;
+		size_t size = (size_t)elevations*azimuths*hrir_length*sizeof(float);
+		if(size > budget) continue;
+		grid = allocArray<float>((size_t)elevations*azimuths*hrir_length);
+		if(delays) grid_delays = new float[elevations*azimuths];
+		for(int elev = 0; elev < elevations; elev++) {
+			float elevation = (float)std::min(min_elevation+elev*elevationStep, max_elevation);
+			for(int azimuth = 0; azimuth < azimuths; azimuth++) {
+				int index = elev*azimuths+azimuth;
+				computeCoefficientsMono(elevation, (float)(azimuth*azimuthStep), grid+(size_t)index*hrir_length);
+				if(delays) grid_delays[index] = computeDelayMono(elevation, (float)(azimuth*azimuthStep));
+			}
+		}
+		grid_elevation_step = elevationStep;
+		grid_azimuth_step = azimuthStep;
+		grid_elevation_count = elevations;
+		grid_azimuth_count = azimuths;
+		return true;
+	}
+	return false;
+}
+
+bool HrtfData::hasGrid() {
+	return grid != nullptr;
+}
+
+int HrtfData::computeGridIndex(float elevation, float azimuth) {
+	int elev = (int)roundf((elevation-min_elevation)/grid_elevation_step);
+	elev = std::min(std::max(elev, 0), grid_elevation_count-1);
+	int az = ringmodi((int)roundf(azimuth/grid_azimuth_step), grid_azimuth_count);
+	return elev*grid_azimuth_count+az;
+}
+
+void HrtfData::computeGridIndicesStereo(float elevation, float azimuth, int* left, int* right) {
+	//Same reflection as computeCoefficientsStereo.
+	azimuth = ringmodf(azimuth, 360.0f);
+	*right = computeGridIndex(elevation, azimuth);
+	azimuth = ringmodf(360-azimuth, 360.0f);
+	*left = computeGridIndex(elevation, azimuth);
+}
+
+float* HrtfData::getGridResponse(int index) {
+	return grid+(size_t)index*hrir_length;
+}
+
+kiss_fft_cpx* HrtfData::getGridSpectrum(HrtfSpectra* spectra, int index) {
+	return spectra->grid_spectra+(size_t)index*spectra->bin_count;
+}
+
+float HrtfData::getGridDelay(int index) {
+	return grid_delays[index];
+}
+
+HrtfSpectra::HrtfSpectra(int fftSize, int hrirCount, int gridPoints): fft_size(fftSize) {
+	bin_count = fft_size/2+1;
+	spectra = allocArray<kiss_fft_cpx>(bin_count*hrirCount);
+	if(gridPoints) grid_spectra = allocArray<kiss_fft_cpx>((size_t)bin_count*gridPoints);
+}
+
+HrtfSpectra::~HrtfSpectra() {
+	freeArray(spectra);
+	if(grid_spectra) freeArray(grid_spectra);
+}
+
+std::shared_ptr<HrtfSpectra> HrtfData::getSpectra(int fftSize) {
+	if(fftSize <= hrir_length) ERROR(Lav_ERROR_RANGE, "FFT size must be greater than the HRIR length.");
+	std::lock_guard<std::mutex> guard(spectra_mutex);
+	auto s = spectra_cache[fftSize];
+	if(s) return s;
+	int gridPoints = grid_elevation_count*grid_azimuth_count;
+	s = std::make_shared<HrtfSpectra>(fftSize, hrir_count, gridPoints);
+	auto plan = getFftPlan(fftSize, false);
+	float* padded = allocArray<float>(fftSize);
+	for(int elev = 0; elev < elev_count; elev++) {
+		for(int azimuth = 0; azimuth < azimuth_counts[elev]; azimuth++) {
+			std::copy(getHrir(elev, azimuth), getHrir(elev, azimuth)+hrir_length, padded);
+			plan->fft(padded, s->spectra+(elevation_offsets[elev]+azimuth)*s->bin_count);
+		}
+	}
+	for(int i = 0; i < gridPoints; i++) {
+		std::copy(getGridResponse(i), getGridResponse(i)+hrir_length, padded);
+		plan->fft(padded, s->grid_spectra+(size_t)i*s->bin_count);
+	}
+	freeArray(padded);
+	spectra_cache[fftSize] = s;
+	return s;
+}
+
+void HrtfData::computeSpectraMono(HrtfSpectra* spectra, float elevation, float azimuth, kiss_fft_cpx* out) {
+	HrtfTap taps[4];
+	computeTaps(elevation, azimuth, taps);
+	int floats = spectra->bin_count*2;
+	memset(out, 0, sizeof(float)*floats);
+	for(int i = 0; i < 4; i++) {
+		float* spectrum = (float*)(spectra->spectra+(elevation_offsets[taps[i].elevation]+taps[i].azimuth)*spectra->bin_count);
+		multiplicationAdditionKernel(floats, taps[i].weight, spectrum, (float*)out, (float*)out);
+	}
+}
+
+void HrtfData::computeSpectraStereo(HrtfSpectra* spectra, float elevation, float azimuth, kiss_fft_cpx* left, kiss_fft_cpx* right) {
+	//Same as computeCoefficientsStereo.
+	azimuth = ringmodf(azimuth, 360.0f);
+	computeSpectraMono(spectra, elevation, azimuth, right);
+	azimuth = ringmodf(360-azimuth, 360.0f);
+	computeSpectraMono(spectra, elevation, azimuth, left);
+}
+
 //Create and free buffers.
 //These are used by the thread locals.
 
@@ -266,6 +641,7 @@ This only accounts for the file itself.  See below for the caching.*/
 class HrtfId {
 	public:
 	HrtfId(boost::filesystem::fstream &f);
+	HrtfId(const char* id);
 	char identity[16];
 };
 
@@ -274,33 +650,91 @@ HrtfId::HrtfId(boost::filesystem::fstream &f) {
 	if(f.gcount() != 16) ERROR(Lav_ERROR_HRTF_INVALID, "Could not read HRTF ID.");
 }
 
+HrtfId::HrtfId(const char* id) {
+	memcpy(identity, id, 16);
+}
+
 bool operator==(const HrtfId& a, const HrtfId& b) {
 	return memcmp(a.identity, b.identity, 16) == 0;
 }
 
 bool operator<(const HrtfId &a, const HrtfId& b) {
-	return memcmp(a.identity, b.identity, 16) == -1;
+	return memcmp(a.identity, b.identity, 16) < 0;
 }
 
 bool operator>(const HrtfId& a, const HrtfId& b) {
-	return memcmp(a.identity, b.identity, 16) == 1;
+	return memcmp(a.identity, b.identity, 16) > 0;
+}
+
+//The id the default hrtf is cached under.
+HrtfId getDefaultHrtfId() {
+	return HrtfId(default_hrtf);
+}
+
+HrtfId readHrtfId(std::string path) {
+	if(path == "default") return getDefaultHrtfId();
+	boost::filesystem::fstream f(boost::filesystem::path(utf8ToWide(path)), boost::filesystem::fstream::in | boost::filesystem::fstream::binary);
+	if(f.good() == false) ERROR(Lav_ERROR_FILE, std::string("Could not find HRTF file ")+path);
+	return HrtfId(f);
 }
 
 std::map<int, std::shared_ptr<HrtfData>> *default_hrtf_cache;
 //Tuple of (forSr, HrtfId).
 std::map<std::tuple<int, HrtfId>, std::shared_ptr<HrtfData>> *file_hrtf_cache;
 std::mutex *hrtf_cache_mutex;
+//Protected by hrtf_cache_mutex.
+size_t *hrtf_grid_budget;
+int *hrtf_minimum_phase_length;
 
 void initializeHrtfCaches() {
 	default_hrtf_cache = new std::map<int, std::shared_ptr<HrtfData>>();
 	file_hrtf_cache = new std::map<std::tuple<int, HrtfId>, std::shared_ptr<HrtfData>>();
 	hrtf_cache_mutex = new std::mutex();
+	hrtf_grid_budget = new size_t(0);
+	hrtf_minimum_phase_length = new int(0);
 }
 
 void shutdownHrtfCaches() {
 	delete hrtf_cache_mutex;
 	delete default_hrtf_cache;
 	delete file_hrtf_cache;
+	delete hrtf_grid_budget;
+	delete hrtf_minimum_phase_length;
+}
+
+void setHrtfGridBudget(size_t budget) {
+	std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
+	if(*hrtf_grid_budget == budget) return;
+	*hrtf_grid_budget = budget;
+	//Grids can't be built under panners which are already using an HrtfData, so start over.
+	//Existing users keep what they have.
+	default_hrtf_cache->clear();
+	file_hrtf_cache->clear();
+}
+
+size_t getHrtfGridBudget() {
+	std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
+	return *hrtf_grid_budget;
+}
+
+void setHrtfMinimumPhaseLength(int length) {
+	std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
+	if(*hrtf_minimum_phase_length == length) return;
+	*hrtf_minimum_phase_length = length;
+	//As with the grid budget.
+	default_hrtf_cache->clear();
+	file_hrtf_cache->clear();
+}
+
+int getHrtfMinimumPhaseLength() {
+	std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
+	return *hrtf_minimum_phase_length;
+}
+
+//Apply the load-time settings.  Call with hrtf_cache_mutex held.
+void prepareHrtf(std::shared_ptr<HrtfData> h) {
+	h->convertToMinimumPhase(*hrtf_minimum_phase_length);
+	h->buildGrid(*hrtf_grid_budget);
 }
 
 std::shared_ptr<HrtfData> createHrtfFromString(std::string path, int forSr) {
@@ -309,21 +743,80 @@ std::shared_ptr<HrtfData> createHrtfFromString(std::string path, int forSr) {
 		if(default_hrtf_cache->count(forSr)) return default_hrtf_cache->at(forSr);
 		auto h = std::make_shared<HrtfData>();
 		h->loadFromDefault(forSr);
+		prepareHrtf(h);
 		(*default_hrtf_cache)[forSr] = h;
 		return h;
 	}
 	else {
-		boost::filesystem::fstream f(boost::filesystem::path(utf8ToWide(path)), boost::filesystem::fstream::in | boost::filesystem::fstream::binary);
-		if(f.good() == false) ERROR(Lav_ERROR_FILE, std::string("Could not find HRTF file ")+path);
-		auto identity = HrtfId(f);
-		f.close();
+		auto identity = readHrtfId(path);
 		std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
 		if(file_hrtf_cache->count(std::make_tuple(forSr, identity))) return file_hrtf_cache->at(std::make_tuple(forSr, identity));
 		auto h = std::make_shared<HrtfData>();
 		h->loadFromFile(path, forSr);
+		prepareHrtf(h);
 		(*file_hrtf_cache)[std::make_tuple(forSr, identity)] = h;
 		return h;
 	}
 }
 
-}
\ No newline at end of file
+void saveHrtfCache(std::string path, int forSr, std::string cachePath) {
+	auto identity = readHrtfId(path);
+	auto h = createHrtfFromString(path, forSr);
+	h->saveToCache(cachePath, identity.identity);
+}
+
+void loadHrtfCache(std::string cachePath) {
+	auto h = std::make_shared<HrtfData>();
+	char id[16];
+	h->loadFromCache(cachePath, id);
+	auto identity = HrtfId(id);
+	int sr = h->getSr();
+	std::lock_guard<std::mutex> guard(*hrtf_cache_mutex);
+	if(h->getMinimumPhaseLength() != *hrtf_minimum_phase_length) ERROR(Lav_ERROR_HRTF_INVALID, "HRTF cache was made with a different minimum-phase length.");
+	h->buildGrid(*hrtf_grid_budget);
+	if(identity == getDefaultHrtfId()) (*default_hrtf_cache)[sr] = h;
+	else (*file_hrtf_cache)[std::make_tuple(sr, identity)] = h;
+}
+
+//begin public api.
+
+Lav_PUBLIC_FUNCTION LavError Lav_setHrtfGridBudget(int kilobytes) {
+	PUB_BEGIN
+	if(kilobytes < 0) ERROR(Lav_ERROR_RANGE, "The grid budget cannot be negative.");
+	setHrtfGridBudget((size_t)kilobytes*1024);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_getHrtfGridBudget(int* destination) {
+	PUB_BEGIN
+	*destination = (int)(getHrtfGridBudget()/1024);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_setHrtfMinimumPhaseLength(int length) {
+	PUB_BEGIN
+	if(length < 0) ERROR(Lav_ERROR_RANGE, "The minimum-phase length cannot be negative.");
+	setHrtfMinimumPhaseLength(length);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_getHrtfMinimumPhaseLength(int* destination) {
+	PUB_BEGIN
+	*destination = getHrtfMinimumPhaseLength();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_saveHrtfCache(const char* hrtfPath, int sr, const char* cachePath) {
+	PUB_BEGIN
+	if(sr <= 0) ERROR(Lav_ERROR_RANGE, "Sample rate must be positive.");
+	saveHrtfCache(hrtfPath, sr, cachePath);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_loadHrtfCache(const char* cachePath) {
+	PUB_BEGIN
+	loadHrtfCache(cachePath);
+	PUB_END
+}
+
+}
@@ -0,0 +1,221 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/constants.hpp>
+#include <libaudioverse/private/hrtf.hpp>
+#include <libaudioverse/private/fft.hpp>
+#include <libaudioverse/implementations/ambisonics.hpp>
+#include <libaudioverse/implementations/amplitude_panner.hpp>
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include <string.h>
+
+namespace libaudioverse_implementation {
+
+//Enough virtual speakers to sample third order without aliasing much.
+const int ambisonic_virtual_speaker_count = 50;
+
+int ambisonicChannelCount(int order) {
+	return (order+1)*(order+1);
+}
+
+void computeAmbisonicCoefficients(int order, float azimuth, float elevation, float* out) {
+	//Azimuth runs clockwise from the front, so left is negative.
+	float a = (float)(azimuth*PI/180.0), e = (float)(elevation*PI/180.0);
+	float x = cosf(e)*cosf(a), y = -cosf(e)*sinf(a), z = sinf(e);
+	out[0] = 1.0f;
+	if(order < 1) return;
+	out[1] = sqrtf(3.0f)*y;
+	out[2] = sqrtf(3.0f)*z;
+	out[3] = sqrtf(3.0f)*x;
+	if(order < 2) return;
+	out[4] = sqrtf(15.0f)*x*y;
+	out[5] = sqrtf(15.0f)*y*z;
+	out[6] = sqrtf(5.0f)/2.0f*(3.0f*z*z-1.0f);
+	out[7] = sqrtf(15.0f)*x*z;
+	out[8] = sqrtf(15.0f)/2.0f*(x*x-y*y);
+	if(order < 3) return;
+	out[9] = sqrtf(35.0f/8.0f)*y*(3.0f*x*x-y*y);
+	out[10] = sqrtf(105.0f)*x*y*z;
+	out[11] = sqrtf(21.0f/8.0f)*y*(5.0f*z*z-1.0f);
+	out[12] = sqrtf(7.0f)/2.0f*z*(5.0f*z*z-3.0f);
+	out[13] = sqrtf(21.0f/8.0f)*x*(5.0f*z*z-1.0f);
+	out[14] = sqrtf(105.0f)/2.0f*z*(x*x-y*y);
+	out[15] = sqrtf(35.0f/8.0f)*x*(x*x-3.0f*y*y);
+}
+
+void ambisonicEncode(int blockSize, int order, float* input, float* from, float* to, float** bus) {
+	int channels = ambisonicChannelCount(order);
+	for(int c = 0; c < channels; c++) {
+		if(from[c] == to[c]) {
+			multiplicationAdditionKernel(blockSize, to[c], input, bus[c], bus[c]);
+			continue;
+		}
+		float gain = from[c], delta = (to[c]-from[c])/blockSize;
+		float* out = bus[c];
+		for(int i = 0; i < blockSize; i++) {
+			out[i] += gain*input[i];
+			gain += delta;
+		}
+	}
+}
+
+//Virtual speaker directions, as (azimuth, elevation) pairs, on a Fibonacci lattice.
+std::vector<float> computeVirtualSpeakers() {
+	std::vector<float> speakers;
+	float goldenAngle = (float)(PI*(3.0-sqrt(5.0)));
+	for(int i = 0; i < ambisonic_virtual_speaker_count; i++) {
+		float z = 1.0f-(2.0f*i+1.0f)/ambisonic_virtual_speaker_count;
+		speakers.push_back((float)(fmodf(goldenAngle*i, (float)(2*PI))*180.0/PI));
+		speakers.push_back((float)(asinf(z)*180.0/PI));
+	}
+	return speakers;
+}
+
+//The gains which turn the bus into the virtual speakers: ambisonic_virtual_speaker_count rows of channels gains.
+//This is the sampling decoder, weighted per order for max-rE and scaled so that the gains for any direction sum to 1.
+std::vector<float> computeVirtualSpeakerDecoder(int order) {
+	int channels = ambisonicChannelCount(order);
+	float x = cosf((float)(137.9/(order+1.51)*PI/180.0));
+	float orderWeights[] = {1.0f, x, (3.0f*x*x-1.0f)/2.0f, (5.0f*x*x*x-3.0f*x)/2.0f};
+	auto speakers = computeVirtualSpeakers();
+	std::vector<float> decoder(ambisonic_virtual_speaker_count*channels);
+	for(int k = 0; k < ambisonic_virtual_speaker_count; k++) {
+		float* row = &decoder[k*channels];
+		computeAmbisonicCoefficients(order, speakers[2*k], speakers[2*k+1], row);
+		for(int c = 0; c < channels; c++) {
+			int n = (int)sqrtf((float)c);
+			row[c] *= orderWeights[n]/ambisonic_virtual_speaker_count;
+		}
+	}
+	return decoder;
+}
+
+AmbisonicBinauralDecoder::AmbisonicBinauralDecoder(int blockSize, int order, std::shared_ptr<HrtfData> hrtf): block_size(blockSize) {
+	channels = ambisonicChannelCount(order);
+	int hrirLength = hrtf->getLength();
+	//Minimum-phase hrirs need their delays back, since the virtual speakers are summed into one filter.
+	int delayLength = hrtf->hasDelays() ? (int)ceilf(hrtf->getMaxDelay())+1 : 0;
+	int responseLength = hrirLength+delayLength;
+	fft_size = nextFastFftSize(block_size+responseLength-1);
+	bin_count = fft_size/2+1;
+	fft = getFftPlan(fft_size, false);
+	ifft = getFftPlan(fft_size, true);
+	auto speakers = computeVirtualSpeakers();
+	auto decoder = computeVirtualSpeakerDecoder(order);
+	float* hrirLeft = allocArray<float>(hrirLength), *hrirRight = allocArray<float>(hrirLength);
+	std::vector<float*> leftResponses, rightResponses;
+	for(int c = 0; c < channels; c++) {
+		leftResponses.push_back(allocArray<float>(fft_size));
+		rightResponses.push_back(allocArray<float>(fft_size));
+	}
+	for(int k = 0; k < ambisonic_virtual_speaker_count; k++) {
+		hrtf->computeCoefficientsStereo(speakers[2*k+1], speakers[2*k], hrirLeft, hrirRight);
+		float leftDelay = 0.0f, rightDelay = 0.0f;
+		if(delayLength) hrtf->computeDelaysStereo(speakers[2*k+1], speakers[2*k], &leftDelay, &rightDelay);
+		int leftOffset = (int)leftDelay, rightOffset = (int)rightDelay;
+		float leftFraction = leftDelay-leftOffset, rightFraction = rightDelay-rightOffset;
+		for(int c = 0; c < channels; c++) {
+			float g = decoder[k*channels+c];
+			if(g == 0.0f) continue;
+			//Fractional delays are split between the two nearest samples.
+			float* l = leftResponses[c]+leftOffset, *r = rightResponses[c]+rightOffset;
+			multiplicationAdditionKernel(hrirLength, g*(1.0f-leftFraction), hrirLeft, l, l);
+			multiplicationAdditionKernel(hrirLength, g*leftFraction, hrirLeft, l+1, l+1);
+			multiplicationAdditionKernel(hrirLength, g*(1.0f-rightFraction), hrirRight, r, r);
+			multiplicationAdditionKernel(hrirLength, g*rightFraction, hrirRight, r+1, r+1);
+		}
+	}
+	for(int c = 0; c < channels; c++) {
+		left_filters.push_back(allocArray<kiss_fft_cpx>(bin_count));
+		right_filters.push_back(allocArray<kiss_fft_cpx>(bin_count));
+		fft->fft(leftResponses[c], left_filters[c]);
+		fft->fft(rightResponses[c], right_filters[c]);
+		freeArray(leftResponses[c]);
+		freeArray(rightResponses[c]);
+		histories.push_back(allocArray<float>(fft_size));
+	}
+	freeArray(hrirLeft);
+	freeArray(hrirRight);
+	input_spectrum = allocArray<kiss_fft_cpx>(bin_count);
+	left_accumulator = allocArray<kiss_fft_cpx>(bin_count);
+	right_accumulator = allocArray<kiss_fft_cpx>(bin_count);
+	workspace = allocArray<float>(fft_size);
+}
+
+AmbisonicBinauralDecoder::~AmbisonicBinauralDecoder() {
+	for(int c = 0; c < channels; c++) {
+		freeArray(histories[c]);
+		freeArray(left_filters[c]);
+		freeArray(right_filters[c]);
+	}
+	freeArray(input_spectrum);
+	freeArray(left_accumulator);
+	freeArray(right_accumulator);
+	freeArray(workspace);
+}
+
+void AmbisonicBinauralDecoder::decode(float** bus, float* left, float* right) {
+	memset(left_accumulator, 0, sizeof(kiss_fft_cpx)*bin_count);
+	memset(right_accumulator, 0, sizeof(kiss_fft_cpx)*bin_count);
+	//Overlap-save, as in the HrtfPanner, but summing every channel's product before going back to the time domain.
+	for(int c = 0; c < channels; c++) {
+		float* history = histories[c];
+		std::copy(history+block_size, history+fft_size, history);
+		std::copy(bus[c], bus[c]+block_size, history+fft_size-block_size);
+		fft->fft(history, input_spectrum);
+		complexMultiplicationAdditionKernel(bin_count, (float*)input_spectrum, (float*)left_filters[c], (float*)left_accumulator);
+		complexMultiplicationAdditionKernel(bin_count, (float*)input_spectrum, (float*)right_filters[c], (float*)right_accumulator);
+	}
+	float scale = 1.0f/fft_size;
+	float* valid = workspace+fft_size-block_size;
+	ifft->ifft(left_accumulator, workspace);
+	multiplicationAdditionKernel(block_size, scale, valid, left, left);
+	ifft->ifft(right_accumulator, workspace);
+	multiplicationAdditionKernel(block_size, scale, valid, right, right);
+}
+
+void AmbisonicBinauralDecoder::reset() {
+	for(auto h: histories) std::fill(h, h+fft_size, 0.0f);
+}
+
+AmbisonicSpeakerDecoder::AmbisonicSpeakerDecoder(int order, int speakerCount, float* map): speaker_count(speakerCount) {
+	channels = ambisonicChannelCount(order);
+	matrix.resize(speaker_count*channels, 0.0f);
+	auto speakers = computeVirtualSpeakers();
+	auto decoder = computeVirtualSpeakerDecoder(order);
+	//Pan a unit sample from each virtual speaker to find its gains.
+	AmplitudePanner panner(1, 0.0f);
+	panner.readMap(speaker_count, map);
+	panner.setShouldCrossfade(false);
+	std::vector<float> gains(speaker_count);
+	std::vector<float*> outputs(speaker_count);
+	for(int s = 0; s < speaker_count; s++) outputs[s] = &gains[s];
+	float one = 1.0f;
+	for(int k = 0; k < ambisonic_virtual_speaker_count; k++) {
+		std::fill(gains.begin(), gains.end(), 0.0f);
+		panner.setAzimuth(speakers[2*k]);
+		panner.pan(&one, &outputs[0]);
+		for(int s = 0; s < speaker_count; s++) {
+			for(int c = 0; c < channels; c++) matrix[s*channels+c] += gains[s]*decoder[k*channels+c];
+		}
+	}
+}
+
+void AmbisonicSpeakerDecoder::decode(int blockSize, float** bus, float** outputs) {
+	for(int s = 0; s < speaker_count; s++) {
+		for(int c = 0; c < channels; c++) {
+			float g = matrix[s*channels+c];
+			if(g != 0.0f) multiplicationAdditionKernel(blockSize, g, bus[c], outputs[s], outputs[s]);
+		}
+	}
+}
+
+}
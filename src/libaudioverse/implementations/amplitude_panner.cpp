@@ -9,38 +9,19 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/dspmath.hpp>
 #include <libaudioverse/implementations/amplitude_panner.hpp>
 #include <libaudioverse/private/constants.hpp>
-#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/data.hpp>
 #include <algorithm>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <memory>
 #include <math.h>
 
 namespace libaudioverse_implementation {
 
-AmplitudePanner::AmplitudePanner(int _block_size, float _sr):
-sr(_sr), block_size(_block_size) {
-}
-
-void AmplitudePanner::clearMap() {
-	channels.clear();
-}
-
-void AmplitudePanner::addEntry(float angle, int channel) {
-	channels.emplace_back(ringmodf(angle, 360.0f), channel);
-	std::sort(channels.begin(), channels.end(),
-	[](AmplitudePannerEntry &a, AmplitudePannerEntry& b) {return a.angle < b.angle;});
-}
-
-void AmplitudePanner::pan(float* input, float** outputs) {
-	//TODO: move all this logic into something that's only called when needed.
-	//the two degenerates: 0 and 1 channels.
-	if(input == nullptr || outputs == nullptr || channels.size() == 0) return;
-	if(channels.size() == 1) {
-		std::copy(input, input+block_size, outputs[channels[0].channel]);
-		return;
-	}
-	//We need a local copy.
-	float angle = azimuth;
-	angle = ringmodf(angle, 360.0f);
+//Find the two channels around angle and their weights.  channels must be sorted and have at least 2 entries.
+void computeAmplitudePannerWeights(const std::vector<AmplitudePannerEntry> &channels, float angle, AmplitudePannerTableEntry &out) {
 	int left = 0, right = 0;
 	bool found_right= false;
 	for(int i = 0; i < channels.size(); i++) {
@@ -57,8 +38,6 @@ void AmplitudePanner::pan(float* input, float** outputs) {
 	else {
 		left = right == 0 ? channels.size()-1 : right-1;
 	}
-	int channel1 = channels[left].channel;
-	int channel2 = channels[right].channel;
 	//two cases: we wrapped or didn't.
 	float angle1, angle2, angleSum;
 	if(right == 0) { //left is all the way around, special handling is needed.
@@ -76,15 +55,119 @@ void AmplitudePanner::pan(float* input, float** outputs) {
 		angle2 = fabs(channels[right].angle-angle);
 	}
 	angleSum = angle1+angle2;
-	float weight2 = angle1/angleSum;
-	float weight1 = angle2/angleSum;
-	scalarMultiplicationKernel(block_size, weight1, input, outputs[channel1]);
-	scalarMultiplicationKernel(block_size, weight2, input, outputs[channel2]);
+	out.channel1 = channels[left].channel;
+	out.channel2 = channels[right].channel;
+	out.weight1 = angle2/angleSum;
+	out.weight2 = angle1/angleSum;
+}
+
+AmplitudePannerTable::AmplitudePannerTable(const std::vector<AmplitudePannerEntry> &channels, int resolution): resolution(resolution) {
+	entries.resize(360*resolution);
+	for(int i = 0; i < entries.size(); i++) computeAmplitudePannerWeights(channels, (float)i/resolution, entries[i]);
+}
+
+const AmplitudePannerTableEntry& AmplitudePannerTable::lookup(float azimuth) {
+	int i = (int)floorf(ringmodf(azimuth, 360.0f)*resolution+0.5f);
+	if(i >= (int)entries.size()) i -= entries.size();
+	//Only reachable for NaN.
+	if(i < 0 || i >= (int)entries.size()) i = 0;
+	return entries[i];
+}
+
+std::mutex *standard_amplitude_panner_tables_mutex = new std::mutex();
+std::map<std::pair<int, int>, std::shared_ptr<AmplitudePannerTable>> *standard_amplitude_panner_tables = new std::map<std::pair<int, int>, std::shared_ptr<AmplitudePannerTable>>();
+
+float* standardPanningMap(int channels) {
+	switch(channels) {
+		case 2: return standard_panning_map_stereo;
+		case 4: return standard_panning_map_surround40;
+		case 6: return standard_panning_map_surround51;
+		case 8: return standard_panning_map_surround71;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<AmplitudePannerTable> getStandardAmplitudePannerTable(int channels, int resolution) {
+	std::lock_guard<std::mutex> guard(*standard_amplitude_panner_tables_mutex);
+	auto key = std::make_pair(channels, resolution);
+	auto i = standard_amplitude_panner_tables->find(key);
+	if(i != standard_amplitude_panner_tables->end()) return i->second;
+	//The same entries that readMap would make.
+	std::vector<AmplitudePannerEntry> entries;
+	float* map = standardPanningMap(channels);
+	for(int c = 0; c < channels; c++) if(map[c] != INFINITY) entries.emplace_back(ringmodf(map[c], 360.0f), c);
+	std::sort(entries.begin(), entries.end(),
+	[](const AmplitudePannerEntry &a, const AmplitudePannerEntry& b) {return a.angle < b.angle;});
+	auto table = std::make_shared<AmplitudePannerTable>(entries, resolution);
+	(*standard_amplitude_panner_tables)[key] = table;
+	return table;
+}
+
+AmplitudePanner::AmplitudePanner(int _block_size, float _sr):
+sr(_sr), block_size(_block_size) {
+}
+
+void AmplitudePanner::clearMap() {
+	channels.clear();
+	table = nullptr;
+	standard_channels = 0;
+	output_count = 0;
+	has_panned = false;
+}
+
+void AmplitudePanner::addEntry(float angle, int channel) {
+	channels.emplace_back(ringmodf(angle, 360.0f), channel);
+	std::sort(channels.begin(), channels.end(),
+	[](AmplitudePannerEntry &a, AmplitudePannerEntry& b) {return a.angle < b.angle;});
+	output_count = std::max(output_count, channel+1);
+	table = nullptr;
+	standard_channels = 0;
+}
+
+void AmplitudePanner::pan(float* input, float** outputs) {
+	//the two degenerates: 0 and 1 channels.
+	if(input == nullptr || outputs == nullptr || channels.size() == 0) return;
+	if(channels.size() == 1) {
+		for(int c = 0; c < output_count; c++) {
+			if(c == channels[0].channel) std::copy(input, input+block_size, outputs[c]);
+			else std::fill(outputs[c], outputs[c]+block_size, 0.0f);
+		}
+		return;
+	}
+	//Only reached if someone used addEntry directly.
+	if(table == nullptr) buildTable();
+	const auto &entry = table->lookup(azimuth);
+	if(target_gains.size() != output_count) {
+		gains.resize(output_count, 0.0f);
+		target_gains.resize(output_count, 0.0f);
+	}
+	std::fill(target_gains.begin(), target_gains.end(), 0.0f);
+	target_gains[entry.channel1] = entry.weight1;
+	target_gains[entry.channel2] += entry.weight2;
+	if(should_crossfade == false || has_panned == false) std::copy(target_gains.begin(), target_gains.end(), gains.begin());
+	has_panned = true;
+	for(int c = 0; c < output_count; c++) {
+		float from = gains[c], to = target_gains[c];
+		if(from != to) gainRampKernel(block_size, from, to, input, outputs[c]);
+		else if(to == 0.0f) std::fill(outputs[c], outputs[c]+block_size, 0.0f);
+		else scalarMultiplicationKernel(block_size, to, input, outputs[c]);
+	}
+	std::copy(target_gains.begin(), target_gains.end(), gains.begin());
 }
 
 void AmplitudePanner::readMap(int entries, float* map) {
 	clearMap();
 	for(int i = 0; i < entries; i++) if(map[i] != INFINITY) addEntry(map[i], i);
+	output_count = entries;
+	float* standard = standardPanningMap(entries);
+	if(standard && std::equal(map, map+entries, standard)) standard_channels = entries;
+	buildTable();
+}
+
+void AmplitudePanner::buildTable() {
+	if(channels.size() < 2) return;
+	if(standard_channels) table = getStandardAmplitudePannerTable(standard_channels, table_resolution);
+	else table = std::make_shared<AmplitudePannerTable>(channels, table_resolution);
 }
 
 float AmplitudePanner::getAzimuth() {
@@ -103,4 +186,22 @@ void AmplitudePanner::setElevation(float e) {
 	elevation = e;
 }
 
+void AmplitudePanner::setShouldCrossfade(bool cf) {
+	should_crossfade = cf;
+}
+
+bool AmplitudePanner::getShouldCrossfade() {
+	return should_crossfade;
+}
+
+void AmplitudePanner::setTableResolution(int r) {
+	if(r == table_resolution) return;
+	table_resolution = r;
+	buildTable();
+}
+
+int AmplitudePanner::getTableResolution() {
+	return table_resolution;
+}
+
 }
\ No newline at end of file
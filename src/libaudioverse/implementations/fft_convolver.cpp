@@ -8,11 +8,12 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/dspmath.hpp>
 #include <libaudioverse/private/kernels.hpp>
 #include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/fft.hpp>
 #include <libaudioverse/implementations/convolvers.hpp>
 #include <algorithm>
 #include <functional>
 #include <math.h>
-#include <kiss_fftr.h>
+#include <kiss_fft.h>
 
 namespace libaudioverse_implementation {
 
@@ -24,12 +25,12 @@ FftConvolver::FftConvolver(int blockSize): block_size(blockSize) {
 FftConvolver::~FftConvolver() {
 	if(workspace) freeArray(workspace);
 	if(tail) freeArray(tail);
-	if(fft) kiss_fftr_free(fft);
-	if(ifft) kiss_fftr_free(ifft);
+	if(response_fft) freeArray(response_fft);
+	if(block_fft) freeArray(block_fft);
 }
 
 void FftConvolver::setResponse(int length, float* newResponse) {
-	int neededLength= kiss_fftr_next_fast_size_real	(block_size+length);
+	int neededLength= nextFastFftSize(block_size+length);
 	int newTailSize=neededLength-block_size;
 	if(neededLength !=fft_size || tail_size !=newTailSize) {
 		if(workspace) freeArray(workspace);
@@ -39,10 +40,8 @@ void FftConvolver::setResponse(int length, float* newResponse) {
 		fft_size=neededLength/2+1;
 		workspace_size=neededLength;
 		tail_size=newTailSize;
-		if(fft) kiss_fftr_free(fft);
-		fft = kiss_fftr_alloc(workspace_size, 0, nullptr, nullptr);
-		if(ifft) kiss_fftr_free(ifft);
-		ifft=kiss_fftr_alloc(workspace_size, 1, nullptr, nullptr);
+		fft = getFftPlan(workspace_size, false);
+		ifft = getFftPlan(workspace_size, true);
 		if(response_fft) freeArray(response_fft);
 		response_fft=allocArray<kiss_fft_cpx>(fft_size);
 		if(block_fft) freeArray(block_fft);
@@ -51,7 +50,7 @@ void FftConvolver::setResponse(int length, float* newResponse) {
 	memset(workspace, 0, sizeof(float)*workspace_size);
 	//Store the fft of the response.
 	std::copy(newResponse, newResponse+length, workspace);
-	kiss_fftr(fft, workspace, response_fft);
+	fft->fft(workspace, response_fft);
 }
 
 void FftConvolver::convolve(float* input, float* output) {
@@ -67,20 +66,13 @@ kiss_fft_cpx *FftConvolver::getFft(float* input) {
 	std::fill(workspace+block_size, workspace+workspace_size, 0.0);
 	//Copy input to the workspace, and take its fft.
 	std::copy(input, input+block_size, workspace);
-	kiss_fftr(fft, workspace, block_fft);
+	fft->fft(workspace, block_fft);
 	return block_fft;
 }
 
 void FftConvolver::convolveFft(kiss_fft_cpx *fft, float* output) {
-	//Do a complex multiply.
-	//Note that the first line is subtraction because of the i^2.
-	for(int i=0; i < fft_size; i++) {
-		kiss_fft_cpx tmp;
-		tmp.r = fft[i].r*response_fft[i].r-fft[i].i*response_fft[i].i;
-		tmp.i = fft[i].r*response_fft[i].i+fft[i].i*response_fft[i].r;
-		block_fft[i] = tmp;
-	}
-	kiss_fftri(ifft, block_fft, workspace);
+	complexMultiplicationKernel(fft_size, (float*)fft, (float*)response_fft, (float*)block_fft);
+	ifft->ifft(block_fft, workspace);
 	//Add the tail over the block.
 	additionKernel(tail_size, tail, workspace, workspace);
 	//Downscale the first part, our output.
@@ -9,82 +9,168 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/implementations/file_streamer.hpp>
 #include <libaudioverse/private/server.hpp>
 #include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/lock_free_ring.hpp>
+#include <libaudioverse/private/logging.hpp>
+#include <libaudioverse/private/error.hpp>
 #include <speex_resampler_cpp.hpp>
 #include <algorithm>
+#include <limits>
+#include <math.h>
 #include <inttypes.h>
 
 namespace libaudioverse_implementation {
 
-FileStreamer::FileStreamer(std::string path, int _block_size, float _sr):
-block_size(_block_size), sr(_sr) {
+//Room beyond the prefetch, so that the I/O thread can always read a whole chunk.
+int ringCapacityFor(int prefetchFrames, int channels) {
+	return (prefetchFrames+file_streamer_read_frames)*channels;
+}
+
+FileStreamer::FileStreamer(std::string path, int _block_size, float _sr, std::shared_ptr<StreamingScheduler> _scheduler):
+block_size(_block_size), sr(_sr), scheduler(_scheduler.get()) {
 	reader.open(path.c_str());
-	duration = reader.getFrameCount()/(double)reader.getSr();
-	position_per_sample = 1.0/reader.getSr();
-	resampler = speex_resampler_cpp::createResampler(block_size, reader.getChannelCount(), reader.getSr(), sr);
-	workspace_before_resampling = allocArray<float>(block_size*reader.getChannelCount());
-	workspace_after_resampling = allocArray<float>(block_size*reader.getChannelCount());
+	channels = reader.getChannelCount();
+	frame_count = reader.getFrameCount();
+	file_sr = reader.getSr();
+	duration = frame_count/(double)file_sr;
+	end_point.store(std::numeric_limits<long long>::max());
+	resampler = speex_resampler_cpp::createResampler(block_size, channels, file_sr, sr);
+	workspace_before_resampling = allocArray<float>(block_size*channels);
+	workspace_after_resampling = allocArray<float>(block_size*channels);
+	read_workspace = allocArray<float>(file_streamer_read_frames*channels);
+	prefetch_frames.store((int)(file_sr*0.5));
+	ring = new LockFreeRing<float>(ringCapacityFor(prefetch_frames.load(), channels));
+	requestFlush(0, ring->getCapacity());
+	scheduler->addStream(this);
 }
 
+//Only ever called by the scheduler, which has already forgotten us.
 FileStreamer::~FileStreamer() {
+	delete ring;
 	freeArray(workspace_before_resampling);
 	freeArray(workspace_after_resampling);
+	freeArray(read_workspace);
 }
 
 void FileStreamer::process(float** outputs) {
 	int got = 0;
 	float* ptr = workspace_after_resampling;
 	while(got < block_size) {
-		int gotThisIteration = resampler->write(workspace_after_resampling, block_size-got);
+		int gotThisIteration = resampler->write(ptr, block_size-got);
 		if(gotThisIteration == 0 && ended_before_resampling == false) feedResampler();
 		else if(gotThisIteration == 0) break;
 		got += gotThisIteration;
-		ptr += gotThisIteration*reader.getChannelCount();
+		ptr += gotThisIteration*channels;
 	}
-	std::fill(ptr, workspace_after_resampling+block_size*reader.getChannelCount(), 0.0f);
+	std::fill(ptr, workspace_after_resampling+block_size*channels, 0.0f);
 	if(got == 0 && ended_before_resampling) ended_after_resampling = true;
-	uninterleaveSamples(reader.getChannelCount(), block_size, workspace_after_resampling, reader.getChannelCount(), outputs);
+	uninterleaveSamples(channels, block_size, workspace_after_resampling, channels, outputs);
 }
 
 void FileStreamer::feedResampler() {
 	//If we're ended, short-circuit.
 	if(ended_before_resampling) return;
-	//First, write stuff to the workspace, of size _block_size.
-	unsigned int needed = block_size;
-	unsigned int got = 0;
-	float* ptr = workspace_before_resampling;
-	while(needed) {
-		got = reader.read(needed, ptr);
-		ptr += got*reader.getChannelCount();
-		needed -= got;
-		position += got*position_per_sample;
-		//We didn't get frames, the duration isn't 0 frames, and we're looping.
-		//Libsndfile doesn't let us ask why, and says we're supposed to just assume that this means the end.
-		if(got == 0 && reader.getFrameCount() && is_looping) {
-			position = 0.0;
-			reader.seek(0);
+	int got = 0;
+	//Until the I/O thread answers a flush, what's in the ring is stale.
+	if(requested_flush.load(std::memory_order_relaxed) == acknowledged_flush.load(std::memory_order_acquire)) {
+		ring->skipTo(flush_point.load(std::memory_order_acquire));
+		got = ring->read(workspace_before_resampling, block_size*channels)/channels;
+		position_in_frames += got;
+		//Past the end only happens when looping.
+		if(position_in_frames > frame_count && frame_count) position_in_frames %= frame_count;
+		if(got < block_size) {
+			if(is_looping.load() == false && ring->getReadPosition() >= end_point.load(std::memory_order_acquire)) ended_before_resampling = true;
+			else underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	std::fill(workspace_before_resampling+got*channels, workspace_before_resampling+block_size*channels, 0.0f);
+	//Silence keeps the resampler going through underruns, but once ended we only want the last of the file.
+	if(got || ended_before_resampling == false) resampler->read(workspace_before_resampling);
+}
+
+void FileStreamer::requestFlush(int64_t frame, int capacity) {
+	flush_frame.store(frame);
+	flush_capacity.store(capacity);
+	requested_flush.fetch_add(1, std::memory_order_release);
+	scheduler->wake();
+}
+
+int FileStreamer::getRoom() {
+	int buffered = (int)(ring->getWritePosition()-ring->getReadPosition())/channels;
+	return std::min(prefetch_frames.load()-buffered, ring->getCapacity()/channels-buffered);
+}
+
+double FileStreamer::getDeadline() {
+	if(requested_flush.load(std::memory_order_acquire) != acknowledged_flush.load(std::memory_order_relaxed)) return -1.0;
+	return (ring->getWritePosition()-ring->getReadPosition())/channels/(double)file_sr;
+}
+
+double FileStreamer::getSecondsUntilService() {
+	if(requested_flush.load(std::memory_order_acquire) != acknowledged_flush.load(std::memory_order_relaxed)) return 0.0;
+	//Looping turned on after the end needs a seek; otherwise, ended streams never need reading.
+	if(at_end) return is_looping.load() && frame_count ? 0.0 : std::numeric_limits<double>::infinity();
+	int wanted = std::max(1, prefetch_frames.load()/file_streamer_refill_divisor);
+	return (wanted-getRoom())/(double)file_sr;
+}
+
+int FileStreamer::service() {
+	long long flush = requested_flush.load(std::memory_order_acquire);
+	if(flush != acknowledged_flush.load(std::memory_order_relaxed)) {
+		//The audio thread isn't reading the ring, so we can replace it.
+		if(flush_capacity.load() != ring->getCapacity()) {
+			delete ring;
+			ring = new LockFreeRing<float>(flush_capacity.load());
 		}
-		else if(got == 0) { //This is probably the end, and Libsndfile annoyingly doesn't make it clear.
-			ended_before_resampling = true;
+		//Otherwise, what's in it is stale and would keep us from refilling until the audio thread skipped it.
+		else ring->clear();
+		int64_t frame = flush_frame.load();
+		if(frame_count) reader.seek((unsigned int)std::min(frame, frame_count-1));
+		//Seeking to the end leaves nothing to read.
+		at_end = frame >= frame_count;
+		end_point.store(at_end ? ring->getWritePosition() : std::numeric_limits<long long>::max());
+		flush_point.store(ring->getWritePosition());
+		acknowledged_flush.store(flush, std::memory_order_release);
+	}
+	if(at_end && is_looping.load() && frame_count) {
+		//Looping was turned on after we got to the end.
+		reader.seek(0);
+		at_end = false;
+		end_point.store(std::numeric_limits<long long>::max());
+	}
+	//Read everything we have room for now, so that the file sees one long read instead of many short ones.
+	int total = 0;
+	while(at_end == false) {
+		int room = getRoom();
+		if(room <= 0) break;
+		int got = reader.read(std::min(room, file_streamer_read_frames), read_workspace);
+		if(got == 0) {
+			//We didn't get frames.  Libsndfile doesn't let us ask why, and says we're supposed to just assume that this means the end.
+			if(is_looping.load() && frame_count) {
+				reader.seek(0);
+				continue;
+			}
+			at_end = true;
+			end_point.store(ring->getWritePosition(), std::memory_order_release);
 			break;
 		}
+		ring->write(read_workspace, got*channels);
+		total += got;
+		//Answer seeks promptly.
+		if(requested_flush.load(std::memory_order_relaxed) != flush) break;
 	}
-	std::fill(ptr, workspace_before_resampling+block_size*reader.getChannelCount(), 0.0f);
-	//And then feed the resampler.
-	if(got) resampler->read(workspace_before_resampling);
+	return total;
 }
 
 void FileStreamer::setPosition(double position) {
-	position = std::min(position, duration);
-	reader.seek(reader.getSr()*position);
-	this->position = position;
+	position = std::min(std::max(position, 0.0), duration);
+	position_in_frames = (int64_t)(file_sr*position);
+	requestFlush(position_in_frames, flush_capacity.load());
 	ended_before_resampling = false;
 	ended_after_resampling = false;
 }
 
 double FileStreamer::getPosition() {
-	//Position is estimated using floating point math, and can drift over the technical max by up to 0.99th of a sample.
-	//We clamp so that user code can pretend that it doesn't.
-	return std::min(position, duration);
+	//Position is counted as frames go into the resampler, and so is slightly ahead of what's heard.
+	return std::min(position_in_frames/(double)file_sr, duration);
 }
 
 double FileStreamer::getDuration() {
@@ -92,15 +178,16 @@ double FileStreamer::getDuration() {
 }
 
 void FileStreamer::setIsLooping(bool l) {
-	is_looping = l;
+	is_looping.store(l);
 	if(l) {
 		ended_before_resampling = false;
 		ended_after_resampling = false;
+		scheduler->wake();
 	}
 }
 
 bool FileStreamer::getIsLooping() {
-	return is_looping;
+	return is_looping.load();
 }
 
 bool FileStreamer::getEnded() {
@@ -108,7 +195,24 @@ bool FileStreamer::getEnded() {
 }
 
 int FileStreamer::getChannels() {
-	return (int)reader.getChannelCount();
+	return channels;
+}
+
+void FileStreamer::setPrefetch(double seconds) {
+	int frames = std::max(block_size, (int)(seconds*file_sr));
+	prefetch_frames.store(frames);
+	//Only grow, since shrinking a ring would drop what's in it.
+	int capacity = ringCapacityFor(frames, channels);
+	if(capacity > flush_capacity.load()) requestFlush(position_in_frames, capacity);
+	else scheduler->wake();
+}
+
+int FileStreamer::getUnderruns() {
+	return underruns.load(std::memory_order_relaxed);
 }
 
-}
\ No newline at end of file
+float FileStreamer::getFileSr() {
+	return file_sr;
+}
+
+}
@@ -9,6 +9,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/dspmath.hpp>
 #include <libaudioverse/private/memory.hpp>
 #include <libaudioverse/private/workspace.hpp>
+#include <libaudioverse/private/fft.hpp>
 #include <libaudioverse/implementations/hrtf_panner.hpp>
 #include <libaudioverse/implementations/delayline.hpp>
 #include <libaudioverse/implementations/convolvers.hpp>
@@ -20,18 +21,40 @@ namespace libaudioverse_implementation {
 
 thread_local Workspace<float> left_response_workspace, right_response_workspace;
 thread_local Workspace<float> crossfade_workspace;
+thread_local Workspace<float> hrtf_fft_output_workspace;
+thread_local Workspace<kiss_fft_cpx> hrtf_input_spectrum_workspace, hrtf_product_workspace;
 
 HrtfPanner::HrtfPanner(int _block_size, float _sr, std::shared_ptr<HrtfData> _hrtf): block_size(_block_size), sr(_sr), hrtf(_hrtf) {
 	response_length = hrtf->getLength();
-	float* left_response_ptr= left_response_workspace.get(response_length);
-	float* right_response_ptr = right_response_workspace.get(response_length);
-	hrtf->computeCoefficientsStereo(azimuth, elevation, left_response_ptr, right_response_ptr);
+	if(hrtf->hasGrid()) hrtf->computeGridIndicesStereo(elevation, azimuth, &left_grid_index, &right_grid_index);
+	if(hrtf->hasDelays()) {
+		//One extra sample for the interpolation.
+		left_delay_line = new DelayRingbuffer((unsigned int)hrtf->getMaxDelay()+2);
+		right_delay_line = new DelayRingbuffer((unsigned int)hrtf->getMaxDelay()+2);
+		computeDelays();
+		prev_left_delay = left_delay;
+		prev_right_delay = right_delay;
+	}
+	use_fft = response_length >= hrtf_panner_fft_threshold;
+	if(use_fft) {
+		//Overlap-save needs block_size+response_length-1 samples to produce block_size valid ones.
+		fft_size = nextFastFftSize(block_size+response_length-1);
+		spectra = hrtf->getSpectra(fft_size);
+		fft = getFftPlan(fft_size, false);
+		ifft = getFftPlan(fft_size, true);
+		history = allocArray<float>(fft_size);
+		left_spectrum = allocArray<kiss_fft_cpx>(spectra->bin_count);
+		right_spectrum = allocArray<kiss_fft_cpx>(spectra->bin_count);
+		prev_left_spectrum = allocArray<kiss_fft_cpx>(spectra->bin_count);
+		prev_right_spectrum = allocArray<kiss_fft_cpx>(spectra->bin_count);
+		setSpectra();
+		return;
+	}
 	left_convolver = new BlockConvolver(block_size);
 	right_convolver = new BlockConvolver(block_size);
 	prev_left_convolver = new BlockConvolver(block_size);
 	prev_right_convolver = new BlockConvolver(block_size);
-	left_convolver->setResponse(response_length, left_response_ptr);
-	right_convolver->setResponse(response_length, right_response_ptr);
+	setResponses();
 }
 
 HrtfPanner::~HrtfPanner() {
@@ -39,23 +62,51 @@ HrtfPanner::~HrtfPanner() {
 	delete right_convolver;
 	delete prev_left_convolver;
 	delete prev_right_convolver;
+	delete left_delay_line;
+	delete right_delay_line;
+	if(history) freeArray(history);
+	if(left_spectrum) freeArray(left_spectrum);
+	if(right_spectrum) freeArray(right_spectrum);
+	if(prev_left_spectrum) freeArray(prev_left_spectrum);
+	if(prev_right_spectrum) freeArray(prev_right_spectrum);
 }
 
 void HrtfPanner::pan(float* input, float *left_output, float *right_output) {
 	//Do we need to crossfade? We do if we've moved more than the threshold and crossfading is being allowed.
 	bool needsCrossfade = should_crossfade && fabs(azimuth-prev_azimuth)+fabs(elevation-prev_elevation) >= crossfade_threshold;
-	if(azimuth != prev_azimuth || elevation != prev_elevation) {
+	bool moved = azimuth != prev_azimuth || elevation != prev_elevation;
+	//With a grid, only moving to a different point changes anything.
+	//Neighbouring points can be many degrees apart, so every change of point crossfades, however slowly we got there.
+	if(moved && hrtf->hasGrid()) {
+		int left, right;
+		hrtf->computeGridIndicesStereo(elevation, azimuth, &left, &right);
+		moved = left != left_grid_index || right != right_grid_index;
+		needsCrossfade = should_crossfade && moved;
+		left_grid_index = left;
+		right_grid_index = right;
+	}
+	if(use_fft) panFrequencyDomain(input, left_output, right_output, moved, needsCrossfade);
+	else panTimeDomain(input, left_output, right_output, moved, needsCrossfade);
+	if(left_delay_line) {
+		if(moved) computeDelays();
+		delay(*left_delay_line, prev_left_delay, left_delay, left_output);
+		delay(*right_delay_line, prev_right_delay, right_delay, right_output);
+		prev_left_delay = left_delay;
+		prev_right_delay = right_delay;
+	}
+	prev_azimuth = azimuth;
+	prev_elevation = elevation;
+}
+
+void HrtfPanner::panTimeDomain(float* input, float *left_output, float *right_output, bool moved, bool needsCrossfade) {
+	if(moved) {
 		if(needsCrossfade) {
 			std::swap(left_convolver, prev_left_convolver);
 			std::swap(right_convolver, prev_right_convolver);
 			left_convolver->reset();
 			right_convolver->reset();
 		}
-		float* left_response_ptr = left_response_workspace.get(response_length);
-		float* right_response_ptr = right_response_workspace.get(response_length);
-		hrtf->computeCoefficientsStereo(elevation, azimuth, left_response_ptr, right_response_ptr);
-		left_convolver->setResponse(response_length, left_response_ptr);
-		right_convolver->setResponse(response_length, right_response_ptr);
+		setResponses();
 	}
 	//These two convolutions always happen.
 	left_convolver->convolve(input, left_output);
@@ -68,11 +119,98 @@ void HrtfPanner::pan(float* input, float *left_output, float *right_output) {
 		prev_right_convolver->convolve(input, crossfade_ptr);
 		for(int i = 0; i < block_size; i++) right_output[i] = (block_size-i)*delta*crossfade_ptr[i]+i*delta*right_output[i];
 	}
-	prev_azimuth = azimuth;
-	prev_elevation = elevation;
-}	
+}
+
+void HrtfPanner::setResponses() {
+	if(hrtf->hasGrid()) {
+		left_convolver->setResponse(response_length, hrtf->getGridResponse(left_grid_index));
+		right_convolver->setResponse(response_length, hrtf->getGridResponse(right_grid_index));
+		return;
+	}
+	float* left_response_ptr = left_response_workspace.get(response_length);
+	float* right_response_ptr = right_response_workspace.get(response_length);
+	hrtf->computeCoefficientsStereo(elevation, azimuth, left_response_ptr, right_response_ptr);
+	left_convolver->setResponse(response_length, left_response_ptr);
+	right_convolver->setResponse(response_length, right_response_ptr);
+}
+
+void HrtfPanner::setSpectra() {
+	//With a grid, use the same point as the delays and the time-domain path.
+	if(hrtf->hasGrid()) {
+		kiss_fft_cpx* left = hrtf->getGridSpectrum(spectra.get(), left_grid_index);
+		kiss_fft_cpx* right = hrtf->getGridSpectrum(spectra.get(), right_grid_index);
+		std::copy(left, left+spectra->bin_count, left_spectrum);
+		std::copy(right, right+spectra->bin_count, right_spectrum);
+		return;
+	}
+	hrtf->computeSpectraStereo(spectra.get(), elevation, azimuth, left_spectrum, right_spectrum);
+}
+
+void HrtfPanner::computeDelays() {
+	if(hrtf->hasGrid()) {
+		left_delay = hrtf->getGridDelay(left_grid_index);
+		right_delay = hrtf->getGridDelay(right_grid_index);
+	}
+	else hrtf->computeDelaysStereo(elevation, azimuth, &left_delay, &right_delay);
+}
+
+void HrtfPanner::delay(DelayRingbuffer &line, float from, float to, float* buffer) {
+	//Ramping the delay across the block avoids clicks, at the cost of a tiny pitch bend.
+	float delta = (to-from)/block_size;
+	for(int i = 0; i < block_size; i++) {
+		line.advance(buffer[i]);
+		float d = from+delta*i;
+		int index = (int)d;
+		float weight = d-index;
+		buffer[i] = (1.0f-weight)*line.read(index)+weight*line.read(index+1);
+	}
+}
+
+void HrtfPanner::panFrequencyDomain(float* input, float *left_output, float *right_output, bool moved, bool needsCrossfade) {
+	int binCount = spectra->bin_count;
+	if(moved) {
+		if(needsCrossfade) {
+			std::swap(left_spectrum, prev_left_spectrum);
+			std::swap(right_spectrum, prev_right_spectrum);
+		}
+		setSpectra();
+	}
+	std::copy(history+block_size, history+fft_size, history);
+	std::copy(input, input+block_size, history+fft_size-block_size);
+	//One fft of the input serves both ears.
+	kiss_fft_cpx* inputSpectrum = hrtf_input_spectrum_workspace.get(binCount, false);
+	kiss_fft_cpx* product = hrtf_product_workspace.get(binCount, false);
+	float* time = hrtf_fft_output_workspace.get(fft_size, false);
+	fft->fft(history, inputSpectrum);
+	//Only the last block_size samples are free of wraparound.
+	float scale = 1.0f/fft_size;
+	float* valid = time+fft_size-block_size;
+	complexMultiplicationKernel(binCount, (float*)inputSpectrum, (float*)left_spectrum, (float*)product);
+	ifft->ifft(product, time);
+	scalarMultiplicationKernel(block_size, scale, valid, left_output);
+	complexMultiplicationKernel(binCount, (float*)inputSpectrum, (float*)right_spectrum, (float*)product);
+	ifft->ifft(product, time);
+	scalarMultiplicationKernel(block_size, scale, valid, right_output);
+	if(needsCrossfade) {
+		double delta = 1.0/block_size;
+		complexMultiplicationKernel(binCount, (float*)inputSpectrum, (float*)prev_left_spectrum, (float*)product);
+		ifft->ifft(product, time);
+		for(int i = 0; i < block_size; i++) left_output[i] = (block_size-i)*delta*scale*valid[i]+i*delta*left_output[i];
+		complexMultiplicationKernel(binCount, (float*)inputSpectrum, (float*)prev_right_spectrum, (float*)product);
+		ifft->ifft(product, time);
+		for(int i = 0; i < block_size; i++) right_output[i] = (block_size-i)*delta*scale*valid[i]+i*delta*right_output[i];
+	}
+}
 
 void HrtfPanner::reset() {
+	if(left_delay_line) {
+		left_delay_line->reset();
+		right_delay_line->reset();
+	}
+	if(use_fft) {
+		std::fill(history, history+fft_size, 0.0f);
+		return;
+	}
 	left_convolver->reset();
 	right_convolver->reset();
 	prev_left_convolver->reset();
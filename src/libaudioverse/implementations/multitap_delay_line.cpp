@@ -0,0 +1,76 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/implementations/delayline.hpp>
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <algorithm>
+#include <math.h>
+
+namespace libaudioverse_implementation {
+
+MultiTapDelayLine::MultiTapDelayLine(int maxDelay, int blockSize): max_delay(maxDelay), block_size(blockSize) {
+	//One more for the interpolation.
+	length = max_delay+block_size+1;
+	buffer = allocArray<float>(2*length);
+}
+
+MultiTapDelayLine::~MultiTapDelayLine() {
+	freeArray(buffer);
+}
+
+void MultiTapDelayLine::write(float* input) {
+	int remaining = block_size, done = 0;
+	while(remaining) {
+		int count = std::min(remaining, length-write_position);
+		std::copy(input+done, input+done+count, buffer+write_position);
+		std::copy(input+done, input+done+count, buffer+write_position+length);
+		write_position = (write_position+count)%length;
+		done += count;
+		remaining -= count;
+	}
+}
+
+void MultiTapDelayLine::read(float delay, float* output) {
+	delay = std::min((float)max_delay, std::max(0.0f, delay));
+	int whole = (int)delay;
+	float fraction = delay-whole;
+	//Sample i of the output is between the samples at start+i-whole-1 and start+i-whole, where start is the first sample of the last block.
+	//Going back from that first sample by at most length-1 keeps the whole read in the doubled buffer.
+	int base = ((write_position-block_size-whole-1)%length+length)%length;
+	linearInterpolationKernel(block_size, fraction, buffer+base+1, buffer+base, output);
+}
+
+void MultiTapDelayLine::read(float from, float to, float* output) {
+	from = std::min((float)max_delay, std::max(0.0f, from));
+	to = std::min((float)max_delay, std::max(0.0f, to));
+	if(from == to) {
+		read(to, output);
+		return;
+	}
+	float delta = (to-from)/block_size;
+	int start = write_position-block_size;
+	for(int i = 0; i < block_size; i++) {
+		float delay = from+delta*i;
+		int whole = (int)delay;
+		float fraction = delay-whole;
+		//As above, for one sample.
+		int base = ((start+i-whole-1)%length+length)%length;
+		output[i] = (1.0f-fraction)*buffer[base+1]+fraction*buffer[base];
+	}
+}
+
+int MultiTapDelayLine::getMaxDelay() {
+	return max_delay;
+}
+
+void MultiTapDelayLine::reset() {
+	std::fill(buffer, buffer+2*length, 0.0f);
+	write_position = 0;
+}
+
+}
@@ -0,0 +1,219 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/fft.hpp>
+#include <libaudioverse/implementations/convolvers.hpp>
+#include <powercores/thread_pool.hpp>
+#include <algorithm>
+#include <thread>
+#include <memory>
+#include <future>
+#include <vector>
+#include <string.h>
+#include <kiss_fft.h>
+
+namespace libaudioverse_implementation {
+
+//Stages stop doubling once their partitions reach this size.
+const int partitioned_convolver_max_partition_size = 16384;
+//The first tail stage uses partitions of this many blocks; the head covers twice that.
+const int partitioned_convolver_first_stage_blocks = 4;
+
+/**Uniformly partitioned overlap-save convolution of one piece of a response.
+Each call to compute consumes partition_size samples of input and produces partition_size samples of output.*/
+class ConvolutionSegment {
+	public:
+	ConvolutionSegment(int partitionSize, int partitionCount);
+	~ConvolutionSegment();
+	//Take the partitions from response starting at offset, zero-padding past length.
+	void setResponse(int offset, int length, float* response);
+	//Shift input into the history. Must not be called while compute is running.
+	void pushInput(float* input);
+	//Compute output from the history. Safe to call from a background thread.
+	void compute(float* output);
+	void reset();
+	int partition_size, partition_count, fft_size, workspace_size, position = 0;
+	float* history = nullptr, *workspace = nullptr;
+	kiss_fft_cpx** response_ffts = nullptr, **input_ffts = nullptr, *accumulator = nullptr;
+	std::shared_ptr<FftPlan> fft, ifft;
+};
+
+ConvolutionSegment::ConvolutionSegment(int partitionSize, int partitionCount): partition_size(partitionSize), partition_count(partitionCount) {
+	workspace_size = 2*partition_size;
+	fft_size = workspace_size/2+1;
+	history = allocArray<float>(workspace_size);
+	workspace = allocArray<float>(workspace_size);
+	accumulator = allocArray<kiss_fft_cpx>(fft_size);
+	response_ffts = new kiss_fft_cpx*[partition_count];
+	input_ffts = new kiss_fft_cpx*[partition_count];
+	for(int i = 0; i < partition_count; i++) {
+		response_ffts[i] = allocArray<kiss_fft_cpx>(fft_size);
+		input_ffts[i] = allocArray<kiss_fft_cpx>(fft_size);
+	}
+	fft = getFftPlan(workspace_size, false);
+	ifft = getFftPlan(workspace_size, true);
+}
+
+ConvolutionSegment::~ConvolutionSegment() {
+	for(int i = 0; i < partition_count; i++) {
+		freeArray(response_ffts[i]);
+		freeArray(input_ffts[i]);
+	}
+	delete[] response_ffts;
+	delete[] input_ffts;
+	freeArray(history);
+	freeArray(workspace);
+	freeArray(accumulator);
+}
+
+void ConvolutionSegment::setResponse(int offset, int length, float* response) {
+	for(int i = 0; i < partition_count; i++) {
+		std::fill(workspace, workspace+workspace_size, 0.0f);
+		int start = offset+i*partition_size;
+		int end = std::min(start+partition_size, length);
+		if(start < end) std::copy(response+start, response+end, workspace);
+		fft->fft(workspace, response_ffts[i]);
+	}
+}
+
+void ConvolutionSegment::pushInput(float* input) {
+	std::copy(history+partition_size, history+workspace_size, history);
+	std::copy(input, input+partition_size, history+partition_size);
+}
+
+void ConvolutionSegment::compute(float* output) {
+	//The newest input fft goes in the slot before the last one, so that walking forward from position walks backward in time.
+	position = (position+partition_count-1)%partition_count;
+	fft->fft(history, input_ffts[position]);
+	memset(accumulator, 0, sizeof(kiss_fft_cpx)*fft_size);
+	for(int p = 0; p < partition_count; p++) {
+		complexMultiplicationAdditionKernel(fft_size, (float*)input_ffts[(position+p)%partition_count], (float*)response_ffts[p], (float*)accumulator);
+	}
+	ifft->ifft(accumulator, workspace);
+	//Overlap-save: only the second half is valid.
+	scalarMultiplicationKernel(partition_size, 1.0f/workspace_size, workspace+partition_size, output);
+}
+
+void ConvolutionSegment::reset() {
+	std::fill(history, history+workspace_size, 0.0f);
+	for(int i = 0; i < partition_count; i++) memset(input_ffts[i], 0, sizeof(kiss_fft_cpx)*fft_size);
+	position = 0;
+}
+
+std::shared_ptr<powercores::ThreadPool> *convolution_thread_pool;
+
+void initializeConvolutionThreads() {
+	int threads = std::max<int>(1, std::min<int>(4, (int)std::thread::hardware_concurrency()-1));
+	auto pool = new powercores::ThreadPool(threads);
+	pool->start();
+	//Convolvers hold onto the pool, so it stops when the last one dies rather than at shutdown.
+	convolution_thread_pool = new std::shared_ptr<powercores::ThreadPool>(pool, [] (powercores::ThreadPool* p) {
+		p->stop();
+		delete p;
+	});
+}
+
+void shutdownConvolutionThreads() {
+	delete convolution_thread_pool;
+}
+
+PartitionedConvolver::PartitionedConvolver(int blockSize): block_size(blockSize) {
+	thread_pool = *convolution_thread_pool;
+	float defaultResponse = 1.0f;
+	setResponse(1, &defaultResponse);
+}
+
+PartitionedConvolver::~PartitionedConvolver() {
+	freeStages();
+}
+
+void PartitionedConvolver::freeStages() {
+	for(auto &stage: tail) {
+		finishJob(stage);
+		delete stage.segment;
+		freeArray(stage.current);
+		freeArray(stage.next);
+		freeArray(stage.input);
+	}
+	tail.clear();
+	if(head) delete head;
+	head = nullptr;
+}
+
+void PartitionedConvolver::finishJob(TailStage &stage) {
+	if(stage.job_pending == false) return;
+	stage.job.wait();
+	stage.job_pending = false;
+}
+
+void PartitionedConvolver::setResponse(int length, float* response) {
+	freeStages();
+	int firstStageSize = partitioned_convolver_first_stage_blocks*block_size;
+	int headLength = 2*firstStageSize;
+	int headCount = std::min((length+block_size-1)/block_size, headLength/block_size);
+	head = new ConvolutionSegment(block_size, std::max(headCount, 1));
+	head->setResponse(0, length, response);
+	//Lay out the tail. Every stage starts at twice its partition size, which is what gives its job a full partition to finish.
+	int offset = headLength, size = firstStageSize;
+	while(offset < length) {
+		int needed = (length-offset+size-1)/size;
+		bool canGrow = size*2 <= partitioned_convolver_max_partition_size;
+		int count = canGrow ? std::min(2, needed) : needed;
+		tail.emplace_back();
+		auto &stage = tail.back();
+		stage.segment = new ConvolutionSegment(size, count);
+		stage.segment->setResponse(offset, length, response);
+		stage.current = allocArray<float>(size);
+		stage.next = allocArray<float>(size);
+		stage.input = allocArray<float>(size);
+		offset += size*count;
+		if(canGrow) size *= 2;
+	}
+}
+
+void PartitionedConvolver::convolve(float* input, float* output) {
+	head->pushInput(input);
+	head->compute(output);
+	for(auto &stage: tail) {
+		int size = stage.segment->partition_size;
+		additionKernel(block_size, output, stage.current+stage.read_position, output);
+		stage.read_position += block_size;
+		std::copy(input, input+block_size, stage.input+stage.fill);
+		stage.fill += block_size;
+		if(stage.fill < size) continue;
+		//This is the last block of the partition, and the deadline for the job started one partition ago.
+		finishJob(stage);
+		std::swap(stage.current, stage.next);
+		stage.read_position = 0;
+		stage.fill = 0;
+		stage.segment->pushInput(stage.input);
+		auto segment = stage.segment;
+		auto destination = stage.next;
+		if(thread_pool) {
+			stage.job = thread_pool->submitJobWithResult([=] () {segment->compute(destination);});
+			stage.job_pending = true;
+		}
+		else segment->compute(destination);
+	}
+}
+
+void PartitionedConvolver::reset() {
+	head->reset();
+	for(auto &stage: tail) {
+		finishJob(stage);
+		int size = stage.segment->partition_size;
+		stage.segment->reset();
+		std::fill(stage.current, stage.current+size, 0.0f);
+		std::fill(stage.next, stage.next+size, 0.0f);
+		stage.fill = 0;
+		stage.read_position = 0;
+	}
+}
+
+}
@@ -15,7 +15,12 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/audio_devices.hpp>
 #include <libaudioverse/private/logging.hpp>
 #include <libaudioverse/private/hrtf.hpp>
+#include <libaudioverse/private/fft.hpp>
 #include <libaudioverse/private/initialization.hpp>
+#include <libaudioverse/private/buffer.hpp>
+#include <libaudioverse/private/asset_cache.hpp>
+#include <libaudioverse/private/paged_audio.hpp>
+#include <libaudioverse/implementations/convolvers.hpp>
 
 #include <atomic>
 
@@ -39,6 +44,11 @@ InitInfo initializers[] = {
 	{"Audio backend", initializeDeviceFactory},
 	{"Metadata tables", initializeMetadata},
 	{"HRTF caches", initializeHrtfCaches},
+	{"FFT plan cache", initializeFftPlanCache},
+	{"Convolution threads", initializeConvolutionThreads},
+	{"Asset cache", initializeAssetCache},
+	{"Buffer loader threads", initializeBufferLoader},
+	{"Paged loader thread", initializePagedLoader},
 };
 
 typedef void (*shutdownfunc_t)();
@@ -54,10 +64,17 @@ struct ShutdownInfo{
 //Termination never fails.
 //logging must always be last.
 ShutdownInfo shutdown_funcs[] = {
+	//First, so that loads in progress finish while everything they use still exists.
+	{"buffer loader threads", shutdownBufferLoader},
 	{"memory module", shutdownMemoryModule},
+	//Destroying buffers trims the cache and unregisters paged audio, so these go after the memory module, which destroys the last of them.
+	{"asset cache", shutdownAssetCache},
+	{"paged loader thread", shutdownPagedLoader},
 	//Device factory needs to go near the end because it tries to log.
 	{"audio backend", shutdownDeviceFactory},
 	{"HRTF caches", shutdownHrtfCaches},
+	{"FFT plan cache", shutdownFftPlanCache},
+	{"convolution threads", shutdownConvolutionThreads},
 	{"logging", shutdownLogging},
 };
 
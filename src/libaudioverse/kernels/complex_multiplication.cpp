@@ -0,0 +1,82 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Complex multiplication of interleaved spectra, used by the frequency-domain convolvers.*/
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <mmintrin.h>
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+namespace libaudioverse_implementation {
+
+void complexMultiplicationKernelSimple(int length, float* a1, float* a2, float* dest) {
+	for(int i = 0; i < length*2; i+=2) {
+		float r = a1[i]*a2[i]-a1[i+1]*a2[i+1];
+		float im = a1[i]*a2[i+1]+a1[i+1]*a2[i];
+		dest[i] = r;
+		dest[i+1] = im;
+	}
+}
+
+void complexMultiplicationAdditionKernelSimple(int length, float* a1, float* a2, float* dest) {
+	for(int i = 0; i < length*2; i+=2) {
+		float r = a1[i]*a2[i]-a1[i+1]*a2[i+1];
+		float im = a1[i]*a2[i+1]+a1[i+1]*a2[i];
+		dest[i] += r;
+		dest[i+1] += im;
+	}
+}
+
+#if defined(LIBAUDIOVERSE_USE_SSE2)
+
+//Multiplies the two complex numbers in each register.
+//a*b = (ar*br-ai*bi, ai*br+ar*bi), so we multiply a by br and a with its halves swapped by bi, then negate the real lane of the second product.
+inline __m128 complexMultiply(__m128 a, __m128 b) {
+	const __m128 signs = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+	__m128 br = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 bi = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+	__m128 aSwapped = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_add_ps(_mm_mul_ps(a, br), _mm_mul_ps(_mm_mul_ps(aSwapped, bi), signs));
+}
+
+void complexMultiplicationKernel(int length, float* a1, float* a2, float* dest) {
+	//Two complex numbers per register.
+	int neededLength = (length/2)*2;
+	for(int i = 0; i < neededLength*2; i+=4) {
+		__m128 a1r = _mm_loadu_ps(a1+i);
+		__m128 a2r = _mm_loadu_ps(a2+i);
+		_mm_storeu_ps(dest+i, complexMultiply(a1r, a2r));
+	}
+	complexMultiplicationKernelSimple(length-neededLength, a1+neededLength*2, a2+neededLength*2, dest+neededLength*2);
+}
+
+void complexMultiplicationAdditionKernel(int length, float* a1, float* a2, float* dest) {
+	int neededLength = (length/2)*2;
+	for(int i = 0; i < neededLength*2; i+=4) {
+		__m128 a1r = _mm_loadu_ps(a1+i);
+		__m128 a2r = _mm_loadu_ps(a2+i);
+		__m128 destr = _mm_loadu_ps(dest+i);
+		_mm_storeu_ps(dest+i, _mm_add_ps(destr, complexMultiply(a1r, a2r)));
+	}
+	complexMultiplicationAdditionKernelSimple(length-neededLength, a1+neededLength*2, a2+neededLength*2, dest+neededLength*2);
+}
+
+#else
+
+void complexMultiplicationKernel(int length, float* a1, float* a2, float* dest) {
+	complexMultiplicationKernelSimple(length, a1, a2, dest);
+}
+
+void complexMultiplicationAdditionKernel(int length, float* a1, float* a2, float* dest) {
+	complexMultiplicationAdditionKernelSimple(length, a1, a2, dest);
+}
+
+#endif
+
+}
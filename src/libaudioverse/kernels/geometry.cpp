@@ -0,0 +1,173 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Implements the kernels used to update many sources at once.*/
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/constants.hpp>
+#include <libaudioverse/libaudioverse3d.h>
+#include <algorithm>
+#include <math.h>
+#include <mmintrin.h>
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+namespace libaudioverse_implementation {
+
+//Coefficients of the approximation to atan on [0, 1].  The error is under 1e-5 radians.
+const float atan_c1 = 0.99997726f, atan_c3 = -0.33262347f, atan_c5 = 0.19354346f, atan_c7 = -0.11643287f, atan_c9 = 0.05265332f, atan_c11 = -0.01172120f;
+
+void transformPointsKernelSimple(int length, const float* matrix, float* x, float* y, float* z) {
+	for(int i = 0; i < length; i++) {
+		float a = x[i], b = y[i], c = z[i];
+		x[i] = matrix[0]*a+matrix[4]*b+matrix[8]*c+matrix[12];
+		y[i] = matrix[1]*a+matrix[5]*b+matrix[9]*c+matrix[13];
+		z[i] = matrix[2]*a+matrix[6]*b+matrix[10]*c+matrix[14];
+	}
+}
+
+void lengthKernelSimple(int length, float* x, float* y, float* z, float* dest) {
+	for(int i = 0; i < length; i++) dest[i] = sqrtf(x[i]*x[i]+y[i]*y[i]+z[i]*z[i]);
+}
+
+void atan2KernelSimple(int length, float* y, float* x, float* dest) {
+	for(int i = 0; i < length; i++) {
+		float ax = fabsf(x[i]), ay = fabsf(y[i]);
+		float big = std::max(ax, ay), small = std::min(ax, ay);
+		float a = big == 0.0f ? 0.0f : small/big;
+		float s = a*a;
+		float r = a*(atan_c1+s*(atan_c3+s*(atan_c5+s*(atan_c7+s*(atan_c9+s*atan_c11)))));
+		if(ay > ax) r = (float)(PI/2)-r;
+		if(x[i] < 0.0f) r = (float)PI-r;
+		dest[i] = signbit(y[i]) ? -r : r;
+	}
+}
+
+void distanceGainKernelSimple(int length, int* models, float* distance, float* referenceDistance, float* maxDistance, float* dest) {
+	for(int i = 0; i < length; i++) {
+		float adjusted = std::max(0.0f, distance[i]-referenceDistance[i]);
+		float percent = adjusted/maxDistance[i];
+		float gain = 1.0f;
+		switch(models[i]) {
+			case Lav_DISTANCE_MODEL_LINEAR: gain = 1.0f-percent; break;
+			case Lav_DISTANCE_MODEL_INVERSE: gain = 1.0f/(1.0f+315.0f*percent); break;
+			case Lav_DISTANCE_MODEL_INVERSE_SQUARE: gain = 1.0f/(1.0f+315.0f*percent*percent); break;
+		}
+		if(adjusted > maxDistance[i] || gain < 0.0f) gain = 0.0f;
+		dest[i] = gain;
+	}
+}
+
+#if defined(LIBAUDIOVERSE_USE_SSE2)
+
+void transformPointsKernel(int length, const float* matrix, float* x, float* y, float* z) {
+	int needed = length/4*4;
+	__m128 m[12];
+	for(int i = 0; i < 3; i++) {
+		m[i*4] = _mm_set1_ps(matrix[i]);
+		m[i*4+1] = _mm_set1_ps(matrix[4+i]);
+		m[i*4+2] = _mm_set1_ps(matrix[8+i]);
+		m[i*4+3] = _mm_set1_ps(matrix[12+i]);
+	}
+	for(int i = 0; i < needed; i += 4) {
+		__m128 a = _mm_loadu_ps(x+i), b = _mm_loadu_ps(y+i), c = _mm_loadu_ps(z+i);
+		__m128 out[3];
+		for(int j = 0; j < 3; j++) {
+			out[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[j*4], a), _mm_mul_ps(m[j*4+1], b)), _mm_add_ps(_mm_mul_ps(m[j*4+2], c), m[j*4+3]));
+		}
+		_mm_storeu_ps(x+i, out[0]);
+		_mm_storeu_ps(y+i, out[1]);
+		_mm_storeu_ps(z+i, out[2]);
+	}
+	transformPointsKernelSimple(length-needed, matrix, x+needed, y+needed, z+needed);
+}
+
+void lengthKernel(int length, float* x, float* y, float* z, float* dest) {
+	int needed = length/4*4;
+	for(int i = 0; i < needed; i += 4) {
+		__m128 a = _mm_loadu_ps(x+i), b = _mm_loadu_ps(y+i), c = _mm_loadu_ps(z+i);
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+		_mm_storeu_ps(dest+i, _mm_sqrt_ps(sum));
+	}
+	lengthKernelSimple(length-needed, x+needed, y+needed, z+needed, dest+needed);
+}
+
+void atan2Kernel(int length, float* y, float* x, float* dest) {
+	int needed = length/4*4;
+	__m128 signMask = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps();
+	__m128 halfPi = _mm_set1_ps((float)(PI/2)), pi = _mm_set1_ps((float)PI);
+	__m128 c1 = _mm_set1_ps(atan_c1), c3 = _mm_set1_ps(atan_c3), c5 = _mm_set1_ps(atan_c5), c7 = _mm_set1_ps(atan_c7), c9 = _mm_set1_ps(atan_c9), c11 = _mm_set1_ps(atan_c11);
+	for(int i = 0; i < needed; i += 4) {
+		__m128 xr = _mm_loadu_ps(x+i), yr = _mm_loadu_ps(y+i);
+		__m128 ax = _mm_andnot_ps(signMask, xr), ay = _mm_andnot_ps(signMask, yr);
+		__m128 big = _mm_max_ps(ax, ay), small = _mm_min_ps(ax, ay);
+		//Where big is 0, so is small; the division gives NaN, which we mask to 0.
+		__m128 a = _mm_and_ps(_mm_div_ps(small, big), _mm_cmpneq_ps(big, zero));
+		__m128 s = _mm_mul_ps(a, a);
+		__m128 r = _mm_add_ps(c9, _mm_mul_ps(s, c11));
+		r = _mm_add_ps(c7, _mm_mul_ps(s, r));
+		r = _mm_add_ps(c5, _mm_mul_ps(s, r));
+		r = _mm_add_ps(c3, _mm_mul_ps(s, r));
+		r = _mm_mul_ps(a, _mm_add_ps(c1, _mm_mul_ps(s, r)));
+		//The three adjustments of the simple version, as selects.
+		__m128 mask = _mm_cmpgt_ps(ay, ax);
+		r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(halfPi, r)), _mm_andnot_ps(mask, r));
+		mask = _mm_cmplt_ps(xr, zero);
+		r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(pi, r)), _mm_andnot_ps(mask, r));
+		//Take the sign of y, so that -0 behaves as it does for atan2.
+		_mm_storeu_ps(dest+i, _mm_xor_ps(r, _mm_and_ps(yr, signMask)));
+	}
+	atan2KernelSimple(length-needed, y+needed, x+needed, dest+needed);
+}
+
+void distanceGainKernel(int length, int* models, float* distance, float* referenceDistance, float* maxDistance, float* dest) {
+	int needed = length/4*4;
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), k = _mm_set1_ps(315.0f);
+	__m128i linear = _mm_set1_epi32(Lav_DISTANCE_MODEL_LINEAR), inverse = _mm_set1_epi32(Lav_DISTANCE_MODEL_INVERSE), inverseSquare = _mm_set1_epi32(Lav_DISTANCE_MODEL_INVERSE_SQUARE);
+	for(int i = 0; i < needed; i += 4) {
+		__m128 maxr = _mm_loadu_ps(maxDistance+i);
+		__m128 adjusted = _mm_max_ps(zero, _mm_sub_ps(_mm_loadu_ps(distance+i), _mm_loadu_ps(referenceDistance+i)));
+		__m128 percent = _mm_div_ps(adjusted, maxr);
+		//Compute every model and keep the one each lane wants.
+		__m128i m = _mm_loadu_si128((__m128i*)(models+i));
+		__m128 linearMask = _mm_castsi128_ps(_mm_cmpeq_epi32(m, linear));
+		__m128 inverseMask = _mm_castsi128_ps(_mm_cmpeq_epi32(m, inverse));
+		__m128 inverseSquareMask = _mm_castsi128_ps(_mm_cmpeq_epi32(m, inverseSquare));
+		__m128 otherMask = _mm_andnot_ps(_mm_or_ps(linearMask, _mm_or_ps(inverseMask, inverseSquareMask)), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+		__m128 gain = _mm_and_ps(linearMask, _mm_sub_ps(one, percent));
+		gain = _mm_or_ps(gain, _mm_and_ps(inverseMask, _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(k, percent)))));
+		gain = _mm_or_ps(gain, _mm_and_ps(inverseSquareMask, _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(k, _mm_mul_ps(percent, percent))))));
+		gain = _mm_or_ps(gain, _mm_and_ps(otherMask, one));
+		//Past the max distance is silent, as is anything that went negative.
+		gain = _mm_andnot_ps(_mm_cmpgt_ps(adjusted, maxr), _mm_max_ps(gain, zero));
+		_mm_storeu_ps(dest+i, gain);
+	}
+	distanceGainKernelSimple(length-needed, models+needed, distance+needed, referenceDistance+needed, maxDistance+needed, dest+needed);
+}
+
+#else
+
+void transformPointsKernel(int length, const float* matrix, float* x, float* y, float* z) {
+	transformPointsKernelSimple(length, matrix, x, y, z);
+}
+
+void lengthKernel(int length, float* x, float* y, float* z, float* dest) {
+	lengthKernelSimple(length, x, y, z, dest);
+}
+
+void atan2Kernel(int length, float* y, float* x, float* dest) {
+	atan2KernelSimple(length, y, x, dest);
+}
+
+void distanceGainKernel(int length, int* models, float* distance, float* referenceDistance, float* maxDistance, float* dest) {
+	distanceGainKernelSimple(length, models, distance, referenceDistance, maxDistance, dest);
+}
+
+#endif
+
+}
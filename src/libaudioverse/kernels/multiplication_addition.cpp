@@ -27,6 +27,15 @@ void parallelMultiplicationAdditionKernelSimple(int length, float c1, float c2,
 	}
 }
 
+//The gain at sample i is start+i*delta.
+void gainRampMultiplicationAdditionKernelSimple(int length, float start, float delta, float* a1, float* a2, float* dest) {
+	for(int i = 0; i < length; i++) dest[i] = (start+i*delta)*a1[i]+a2[i];
+}
+
+void linearInterpolationKernelSimple(int length, float weight, float* a1, float* a2, float* dest) {
+	for(int i = 0; i < length; i++) dest[i] = a1[i]+weight*(a2[i]-a1[i]);
+}
+
 #if defined(LIBAUDIOVERSE_USE_SSE2)
 
 void multiplicationAdditionKernel(int length, float c, float* a1, float* a2, float* dest) {
@@ -68,6 +77,28 @@ void parallelMultiplicationAdditionKernel(int length, float c1, float c2, float
 	parallelMultiplicationAdditionKernelSimple(length-needed, c1, c2, c3, c4, a1+needed, a2+needed, out+needed);
 }
 
+void gainRampMultiplicationAdditionKernel(int length, float start, float end, float* a1, float* a2, float* dest) {
+	int neededLength = (length/4)*4;
+	float delta = (end-start)/length;
+	//As gainRampKernel: each gain comes from its index.
+	__m128 startr = _mm_set1_ps(start), deltar = _mm_set1_ps(delta), offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	for(int i = 0; i < neededLength; i+= 4) {
+		__m128 g = _mm_add_ps(startr, _mm_mul_ps(deltar, _mm_add_ps(_mm_set1_ps((float)i), offsets)));
+		_mm_storeu_ps(dest+i, _mm_add_ps(_mm_mul_ps(g, _mm_loadu_ps(a1+i)), _mm_loadu_ps(a2+i)));
+	}
+	gainRampMultiplicationAdditionKernelSimple(length-neededLength, start+neededLength*delta, delta, a1+neededLength, a2+neededLength, dest+neededLength);
+}
+
+void linearInterpolationKernel(int length, float weight, float* a1, float* a2, float* dest) {
+	int neededLength = (length/4)*4;
+	__m128 w = _mm_set1_ps(weight);
+	for(int i = 0; i < neededLength; i+= 4) {
+		__m128 a1r = _mm_loadu_ps(a1+i), a2r = _mm_loadu_ps(a2+i);
+		_mm_storeu_ps(dest+i, _mm_add_ps(a1r, _mm_mul_ps(w, _mm_sub_ps(a2r, a1r))));
+	}
+	linearInterpolationKernelSimple(length-neededLength, weight, a1+neededLength, a2+neededLength, dest+neededLength);
+}
+
 #else
 
 void multiplicationAdditionKernel(int length, float c, float* a1, float* a2, float* dest) {
@@ -78,6 +109,14 @@ void parallelMultiplicationAdditionKernel(int length, float c1, float c2, float
 	parallelMultiplicationKernelSimple(length, c1, c2, c3, c4, a1, a2, out);
 }
 
+void gainRampMultiplicationAdditionKernel(int length, float start, float end, float* a1, float* a2, float* dest) {
+	gainRampMultiplicationAdditionKernelSimple(length, start, (end-start)/length, a1, a2, dest);
+}
+
+void linearInterpolationKernel(int length, float weight, float* a1, float* a2, float* dest) {
+	linearInterpolationKernelSimple(length, weight, a1, a2, dest);
+}
+
 #endif
 
 }
\ No newline at end of file
@@ -23,6 +23,11 @@ void scalarMultiplicationKernelSimple(int length, float c, float* a1, float* des
 	for(int i = 0; i < length; i++) dest[i]=c*a1[i];
 }
 
+//The gain at sample i is start+i*delta.
+void gainRampKernelSimple(int length, float start, float delta, float* a1, float* dest) {
+	for(int i = 0; i < length; i++) dest[i] = (start+i*delta)*a1[i];
+}
+
 #if defined(LIBAUDIOVERSE_USE_SSE2)
 void multiplicationKernel(int length, float* a1, float* a2, float* dest) {
 	int neededLength = (length/4)*4;
@@ -48,6 +53,19 @@ void scalarMultiplicationKernel(int length, float c, float* a1, float* dest) {
 	scalarMultiplicationKernelSimple(length-neededLength, c, a1+neededLength, dest+neededLength);
 }
 
+void gainRampKernel(int length, float start, float end, float* a1, float* dest) {
+	int neededLength = (length/4)*4;
+	float delta = (end-start)/length;
+	//Compute each gain from its index rather than accumulating, so that long ramps don't drift.
+	__m128 startr = _mm_set1_ps(start), deltar = _mm_set1_ps(delta), offsets = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	for(int i = 0; i < neededLength; i+= 4) {
+		__m128 indices = _mm_add_ps(_mm_set1_ps((float)i), offsets);
+		__m128 g = _mm_add_ps(startr, _mm_mul_ps(deltar, indices));
+		_mm_storeu_ps(dest+i, _mm_mul_ps(g, _mm_loadu_ps(a1+i)));
+	}
+	gainRampKernelSimple(length-neededLength, start+neededLength*delta, delta, a1+neededLength, dest+neededLength);
+}
+
 #else
 void multiplicationKernel(int length, float* a1, float* a2, float* dest) {
 	multiplicationKernelSimple(length, a1, a2, dest);
@@ -57,6 +75,10 @@ void scalarMultiplicationKernel(int length, float c, float* a1, float*dest) {
 	scalarMultiplicationKernelSimple(length, c, a1, dest);
 }
 
+void gainRampKernel(int length, float start, float end, float* a1, float* dest) {
+	gainRampKernelSimple(length, start, (end-start)/length, a1, dest);
+}
+
 #endif
 
 }
\ No newline at end of file
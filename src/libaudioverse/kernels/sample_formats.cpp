@@ -0,0 +1,201 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Conversions between float and the compressed formats buffers can store.
+Encoding happens once, when a buffer is loaded, so only decoding has SSE2 versions.*/
+#include <libaudioverse/private/kernels.hpp>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <mmintrin.h>
+#include <emmintrin.h>
+#include <xmmintrin.h>
+
+namespace libaudioverse_implementation {
+
+const int adpcm_step_table[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int adpcm_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+void floatToInt16Kernel(int length, const float* source, int16_t* dest) {
+	for(int i = 0; i < length; i++) {
+		float s = std::min(1.0f, std::max(-1.0f, source[i]));
+		dest[i] = (int16_t)lrintf(s*32767.0f);
+	}
+}
+
+//Round to nearest even, with overflow going to infinity.  Audio rarely leaves [-1, 1], but we don't assume it.
+uint16_t floatToHalf(float f) {
+	uint32_t x;
+	memcpy(&x, &f, sizeof(float));
+	uint32_t sign = (x>>16)&0x8000;
+	x &= 0x7fffffff;
+	uint16_t ret;
+	if(x >= 0x47800000) ret = x > 0x7f800000 ? 0x7e00 : 0x7c00;
+	else if(x < 0x38800000) {
+		//Denormal or 0.  Adding 0.5 lines the mantissa up with that of a half, and lets the fpu round.
+		float magic = 0.5f, shifted;
+		memcpy(&shifted, &x, sizeof(float));
+		shifted += magic;
+		uint32_t bits, magicBits;
+		memcpy(&bits, &shifted, sizeof(float));
+		memcpy(&magicBits, &magic, sizeof(float));
+		ret = (uint16_t)(bits-magicBits);
+	}
+	else {
+		uint32_t odd = (x>>13)&1;
+		x += ((uint32_t)(15-127)<<23)+0xfff+odd;
+		ret = (uint16_t)(x>>13);
+	}
+	return (uint16_t)(ret|sign);
+}
+
+void floatToHalfKernel(int length, const float* source, uint16_t* dest) {
+	for(int i = 0; i < length; i++) dest[i] = floatToHalf(source[i]);
+}
+
+void adpcmEncodeKernel(int length, const float* source, int* index, unsigned char* dest) {
+	int s = (int)lrintf(std::min(1.0f, std::max(-1.0f, source[0]))*32767.0f);
+	int predictor = s;
+	dest[0] = (unsigned char)(predictor&0xff);
+	dest[1] = (unsigned char)((predictor>>8)&0xff);
+	dest[2] = (unsigned char)*index;
+	dest[3] = 0;
+	unsigned char* nibbles = dest+4;
+	memset(nibbles, 0, adpcm_block_bytes-4);
+	for(int i = 1; i < adpcm_block_frames; i++) {
+		//Short blocks are padded with silence.
+		int sample = i < length ? (int)lrintf(std::min(1.0f, std::max(-1.0f, source[i]))*32767.0f) : 0;
+		int diff = sample-predictor, nibble = 0;
+		if(diff < 0) {
+			nibble = 8;
+			diff = -diff;
+		}
+		int step = adpcm_step_table[*index], delta = step>>3;
+		if(diff >= step) {
+			nibble |= 4;
+			diff -= step;
+			delta += step;
+		}
+		step >>= 1;
+		if(diff >= step) {
+			nibble |= 2;
+			diff -= step;
+			delta += step;
+		}
+		step >>= 1;
+		if(diff >= step) {
+			nibble |= 1;
+			delta += step;
+		}
+		//Track the decoder exactly, so that errors don't accumulate.
+		predictor += nibble&8 ? -delta : delta;
+		predictor = std::min(32767, std::max(-32768, predictor));
+		*index = std::min(88, std::max(0, *index+adpcm_index_table[nibble&7]));
+		nibbles[(i-1)/2] |= (i-1)%2 ? nibble<<4 : nibble;
+	}
+}
+
+void adpcmDecodeKernel(int length, const unsigned char* source, float* dest) {
+	int predictor = (int16_t)(source[0]|(source[1]<<8));
+	int index = source[2];
+	const unsigned char* nibbles = source+4;
+	const float scale = 1.0f/32767.0f;
+	dest[0] = predictor*scale;
+	for(int i = 1; i < length; i++) {
+		int nibble = (i-1)%2 ? nibbles[(i-1)/2]>>4 : nibbles[(i-1)/2]&15;
+		int step = adpcm_step_table[index];
+		int delta = step>>3;
+		if(nibble&4) delta += step;
+		if(nibble&2) delta += step>>1;
+		if(nibble&1) delta += step>>2;
+		predictor += nibble&8 ? -delta : delta;
+		predictor = std::min(32767, std::max(-32768, predictor));
+		index = std::min(88, std::max(0, index+adpcm_index_table[nibble&7]));
+		dest[i] = predictor*scale;
+	}
+}
+
+void int16ToFloatKernelSimple(int length, const int16_t* source, float* dest) {
+	for(int i = 0; i < length; i++) dest[i] = source[i]*(1.0f/32767.0f);
+}
+
+void halfToFloatKernelSimple(int length, const uint16_t* source, float* dest) {
+	for(int i = 0; i < length; i++) {
+		uint32_t h = source[i], sign = (h&0x8000)<<16, exponent = (h>>10)&0x1f, mantissa = h&0x3ff;
+		uint32_t bits;
+		if(exponent == 0x1f) bits = sign|0x7f800000|(mantissa<<13);
+		else if(exponent != 0) bits = sign|((exponent+127-15)<<23)|(mantissa<<13);
+		else if(mantissa == 0) bits = sign;
+		else {
+			//Denormal: scale the mantissa by 2^-24.
+			float f = mantissa*(1.0f/16777216.0f);
+			memcpy(&bits, &f, sizeof(float));
+			bits |= sign;
+		}
+		memcpy(dest+i, &bits, sizeof(float));
+	}
+}
+
+#if defined(LIBAUDIOVERSE_USE_SSE2)
+
+void int16ToFloatKernel(int length, const int16_t* source, float* dest) {
+	int needed = length/8*8;
+	__m128 scale = _mm_set1_ps(1.0f/32767.0f);
+	for(int i = 0; i < needed; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(source+i));
+		//Put each sample in the high half of a 32-bit lane, then shift it down to sign extend.
+		__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+		_mm_storeu_ps(dest+i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(dest+i+4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+	int16ToFloatKernelSimple(length-needed, source+needed, dest+needed);
+}
+
+void halfToFloatKernel(int length, const uint16_t* source, float* dest) {
+	int needed = length/8*8;
+	__m128i noSign = _mm_set1_epi32(0x7fff), wasInfNan = _mm_set1_epi32(0x7bff), infNanExponent = _mm_set1_epi32(255<<23);
+	//2^112, which moves the exponent from half's bias to float's and makes denormals come out right.
+	__m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254-15)<<23));
+	__m128i zero = _mm_setzero_si128();
+	for(int i = 0; i < needed; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(source+i));
+		__m128i halves[2] = {_mm_unpacklo_epi16(s, zero), _mm_unpackhi_epi16(s, zero)};
+		for(int j = 0; j < 2; j++) {
+			__m128i h = halves[j];
+			__m128i exponentMantissa = _mm_and_si128(h, noSign);
+			__m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exponentMantissa), 16);
+			__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), magic);
+			__m128i infNan = _mm_and_si128(_mm_cmpgt_epi32(exponentMantissa, wasInfNan), infNanExponent);
+			_mm_storeu_ps(dest+i+j*4, _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan))));
+		}
+	}
+	halfToFloatKernelSimple(length-needed, source+needed, dest+needed);
+}
+
+#else
+
+void int16ToFloatKernel(int length, const int16_t* source, float* dest) {
+	int16ToFloatKernelSimple(length, source, dest);
+}
+
+void halfToFloatKernel(int length, const uint16_t* source, float* dest) {
+	halfToFloatKernelSimple(length, source, dest);
+}
+
+#endif
+
+}
@@ -381,6 +381,23 @@ bool Node::canCull() {
 	return getState() == Lav_NODESTATE_PAUSED;
 }
 
+void Node::skipBlocks(int blocks) {
+}
+
+void Node::catchUp(int blocks) {
+	//Paused nodes are left out of the plan anyway, and so are their parents unless something else needs them.
+	if(getState() == Lav_NODESTATE_PAUSED) return;
+	int missed = std::min(blocks, server->getTickCount()-1-last_processed);
+	if(missed <= 0) return;
+	//Mark us as current, so that parents we share with other nodes only catch up once.
+	last_processed = server->getTickCount()-1;
+	skipBlocks(missed);
+	visitDependencies(std::static_pointer_cast<Node>(shared_from_this()), [] (std::shared_ptr<Job> j, int blocks) {
+		auto n = std::dynamic_pointer_cast<Node>(j);
+		if(n) n->catchUp(blocks);
+	}, blocks);
+}
+
 void Node::setShouldZeroOutputBuffers(bool v) {
 	should_zero_output_buffers = v;
 }
@@ -764,6 +781,9 @@ Lav_PUBLIC_FUNCTION LavError Lav_nodeSetBufferProperty(LavHandle nodeHandle, int
 	PROP_PREAMBLE(nodeHandle, slot, Lav_PROPERTYTYPE_BUFFER);
 	auto buff=incomingObject<Buffer>(bufferHandle, true);
 	if(buff && buff->getServer() != node_ptr->getServer()) ERROR(Lav_ERROR_CANNOT_CROSS_SERVERS, "Buffer is not from the same server as the node.");
+	//Only buffer nodes know to wait for a buffer to finish loading.
+	if(buff && node_ptr->getType() == Lav_OBJTYPE_BUFFER_NODE) buff->throwIfCannotPlay();
+	else if(buff) buff->throwIfLoading();
 	prop.setBufferValue(buff);
 	PUB_END
 }
@@ -50,10 +50,33 @@ void BufferNode::bufferChanged() {
 		maxPosition =buff->getDuration();
 	}
 	player.setBuffer(buff);
+	//Until it's loaded, the buffer is empty and we play silence.  Once it is, we start over from here with the real one.
+	waiting_for_load = buff && buff->isLoading();
+	if(waiting_for_load && registered_for_will_tick == false) {
+		server->registerNodeForWillTick(std::static_pointer_cast<Node>(shared_from_this()));
+		registered_for_will_tick = true;
+	}
 	getProperty(Lav_BUFFER_POSITION).setDoubleValue(0.0); //the callback handles changing everything else.
 	getProperty(Lav_BUFFER_POSITION).setDoubleRange(0.0, maxPosition);
 }
 
+void BufferNode::willTick() {
+	if(waiting_for_load == false) return;
+	auto buff = getProperty(Lav_BUFFER_BUFFER).getBufferValue();
+	//Failed loads leave the buffer empty, which is what we already have.
+	if(buff && buff->isLoading()) return;
+	waiting_for_load = false;
+	//Picking up the loaded buffer allocates, so do it on the task thread.  The player still has the empty buffer and plays silence until then.
+	std::weak_ptr<BufferNode> weak = std::static_pointer_cast<BufferNode>(shared_from_this());
+	server->enqueueTask([weak, buff] () {
+		auto n = weak.lock();
+		if(n == nullptr) return;
+		LOCK(*n);
+		//Unless someone set another buffer meanwhile.
+		if(n->getProperty(Lav_BUFFER_BUFFER).getBufferValue() == buff) n->bufferChanged();
+	});
+}
+
 void BufferNode::positionChanged() {
 	player.setPosition(getProperty(Lav_BUFFER_POSITION).getDoubleValue());
 }
@@ -75,6 +98,18 @@ void BufferNode::process() {
 	getProperty(Lav_BUFFER_ENDED_COUNT).setIntValue(player.getEndedCount());
 }
 
+void BufferNode::skipBlocks(int blocks) {
+	auto buff = getProperty(Lav_BUFFER_BUFFER).getBufferValue();
+	if(buff == nullptr) return;
+	player.setEndedCount(getProperty(Lav_BUFFER_ENDED_COUNT).getIntValue());
+	int prevEndedCount = player.getEndedCount();
+	player.skip(blocks*block_size);
+	//The position property catches up in the next process.  Setting it here would make process move the player to it, losing the fractional part.
+	//One callback is enough, even if we looped many times while skipped.
+	if(player.getEndedCount() > prevEndedCount) server->enqueueTask([=] () {(*end_callback)();});
+	getProperty(Lav_BUFFER_ENDED_COUNT).setIntValue(player.getEndedCount());
+}
+
 //begin public api
 Lav_PUBLIC_FUNCTION LavError Lav_createBufferNode(LavHandle serverHandle, LavHandle* destination) {
 	PUB_BEGIN
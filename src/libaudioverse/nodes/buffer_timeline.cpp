@@ -88,6 +88,7 @@ Lav_PUBLIC_FUNCTION LavError Lav_bufferTimelineNodeScheduleBuffer(LavHandle node
 	if(n->getType() !=Lav_OBJTYPE_BUFFER_TIMELINE_NODE || b->getType() !=Lav_OBJTYPE_BUFFER) ERROR(Lav_ERROR_TYPE_MISMATCH);
 	if(time < 0.0) ERROR(Lav_ERROR_RANGE);
 	if(pitchBend <0.0) ERROR(Lav_ERROR_RANGE);
+	b->throwIfLoading();
 	LOCK(*n);
 	n->scheduleBuffer(time, pitchBend, b);
 	PUB_END
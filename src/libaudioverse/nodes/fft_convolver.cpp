@@ -28,8 +28,8 @@ FftConvolverNode::FftConvolverNode(std::shared_ptr<Server> server, int channels)
 	appendInputConnection(0, channels);
 	this->channels=channels;
 	appendOutputConnection(0, channels);
-	convolvers=new FftConvolver*[channels]();
-	for(int i= 0; i < channels; i++) convolvers[i] = new FftConvolver(server->getBlockSize());
+	convolvers=new PartitionedConvolver*[channels]();
+	for(int i= 0; i < channels; i++) convolvers[i] = new PartitionedConvolver(server->getBlockSize());
 }
 
 std::shared_ptr<Node> createFftConvolverNode(std::shared_ptr<Server> server, int channels) {
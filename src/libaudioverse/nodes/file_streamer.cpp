@@ -10,6 +10,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/nodes/file_streamer.hpp>
 #include <libaudioverse/private/node.hpp>
 #include <libaudioverse/private/server.hpp>
+#include <libaudioverse/private/streaming.hpp>
 #include <libaudioverse/private/properties.hpp>
 #include <libaudioverse/private/macros.hpp>
 #include <libaudioverse/private/memory.hpp>
@@ -21,23 +22,29 @@ carrying such notice may not be copied, modified, or distributed except accordin
 namespace libaudioverse_implementation {
 
 FileStreamerNode::FileStreamerNode(std::shared_ptr<Server> server, std::string path): Node(Lav_OBJTYPE_FILE_STREAMER_NODE, server, 0, 1),
-streamer(path, server->getBlockSize(), server->getSr()) {
-	resize(0, streamer.getChannels());
-	appendOutputConnection(0, streamer.getChannels());
-	getProperty(Lav_FILE_STREAMER_POSITION).setDoubleRange(0.0, streamer.getDuration());
+streamer(new FileStreamer(path, server->getBlockSize(), server->getSr(), server->getStreamingScheduler())) {
+	resize(0, streamer->getChannels());
+	appendOutputConnection(0, streamer->getChannels());
+	getProperty(Lav_FILE_STREAMER_POSITION).setDoubleRange(0.0, streamer->getDuration());
 	end_callback = std::make_shared<Callback<void()>>();
 }
 
+FileStreamerNode::~FileStreamerNode() {
+	server->getStreamingScheduler()->retireStream(streamer);
+}
+
 std::shared_ptr<Node> createFileStreamerNode(std::shared_ptr<Server> server, std::string path) {
 	return standardNodeCreation<FileStreamerNode>(server, path);
 }
 
 void FileStreamerNode::process() {
-	if(werePropertiesModified(this, Lav_FILE_STREAMER_POSITION)) streamer.setPosition(getProperty(Lav_FILE_STREAMER_POSITION).getDoubleValue());
-	if(werePropertiesModified(this, Lav_FILE_STREAMER_LOOPING)) streamer.setIsLooping(getProperty(Lav_FILE_STREAMER_LOOPING).getIntValue() != 0);
-	streamer.process(&output_buffers[0]);
-	getProperty(Lav_FILE_STREAMER_POSITION).setDoubleValue(streamer.getPosition());
-	if(streamer.getEnded()) {
+	if(werePropertiesModified(this, Lav_FILE_STREAMER_POSITION)) streamer->setPosition(getProperty(Lav_FILE_STREAMER_POSITION).getDoubleValue());
+	if(werePropertiesModified(this, Lav_FILE_STREAMER_LOOPING)) streamer->setIsLooping(getProperty(Lav_FILE_STREAMER_LOOPING).getIntValue() != 0);
+	if(werePropertiesModified(this, Lav_FILE_STREAMER_PREFETCH)) streamer->setPrefetch(getProperty(Lav_FILE_STREAMER_PREFETCH).getDoubleValue());
+	streamer->process(&output_buffers[0]);
+	getProperty(Lav_FILE_STREAMER_POSITION).setDoubleValue(streamer->getPosition());
+	getProperty(Lav_FILE_STREAMER_UNDERRUNS).setIntValue(streamer->getUnderruns());
+	if(streamer->getEnded()) {
 		getProperty(Lav_FILE_STREAMER_ENDED).setIntValue(1);
 		server->enqueueTask([=] () {(*end_callback)();});
 	}
@@ -64,4 +71,12 @@ Lav_PUBLIC_FUNCTION LavError Lav_fileStreamerNodeSetEndCallback(LavHandle nodeHa
 	PUB_END
 }
 
+Lav_PUBLIC_FUNCTION LavError Lav_fileStreamerNodeGetStreamingStats(LavHandle nodeHandle, double* throughput, double* latency, double* maxLatency, int* underruns) {
+	PUB_BEGIN
+	auto n = incomingObject<FileStreamerNode>(nodeHandle);
+	LOCK(*n);
+	n->getServer()->getStreamingScheduler()->getStreamStats(n->streamer, throughput, latency, maxLatency, underruns);
+	PUB_END
+}
+
 }
\ No newline at end of file
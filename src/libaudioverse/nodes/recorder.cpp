@@ -17,9 +17,12 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/constants.hpp>
 #include <libaudioverse/private/file.hpp>
 #include <libaudioverse/private/kernels.hpp>
-#include <powercores/threadsafe_queue.hpp>
-#include <powercores/exceptions.hpp>
+#include <libaudioverse/private/lock_free_ring.hpp>
+#include <libaudioverse/private/logging.hpp>
+#include <libaudioverse/private/error.hpp>
 #include <powercores/utilities.hpp>
+#include <algorithm>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -30,62 +33,76 @@ RecorderNode::RecorderNode(std::shared_ptr<Server> server, int channels): Node(L
 	appendInputConnection(0, channels);
 	appendOutputConnection(0, channels);
 	this->channels = channels;
-	buffer_size=server->getBlockSize()*channels;
-	//allocate a few buffers.
-	for(int i=0; i < 5; i++) available_buffers.enqueue(allocArray<float>(buffer_size));
+	block_workspace = allocArray<float>(block_size*channels);
+	write_workspace = allocArray<float>(recorder_write_frames*channels);
 }
 
 std::shared_ptr<Node> createRecorderNode(std::shared_ptr<Server> server, int channels) {
-	auto ret = standardNodeCreation<RecorderNode>(server, channels);
-	server->registerNodeForMaintenance(ret);
-	return ret;
+	return standardNodeCreation<RecorderNode>(server, channels);
 }
 
 RecorderNode::~RecorderNode() {
 	stopRecording();
-	while(available_buffers.size()) freeArray(available_buffers.dequeue());
-	while(unwritten_buffers.size()) freeArray(unwritten_buffers.dequeue());
+	delete ring;
+	freeArray(block_workspace);
+	freeArray(write_workspace);
 }
 
 void RecorderNode::recordingThreadFunction() {
 	try { //If we get an error that gets all the way out to here, we need to abort the thread without terminating the ap.
-		while(should_keep_recording.test_and_set()) {
-			float* buffer= nullptr;
-			try {
-				buffer = unwritten_buffers.dequeueWithTimeout(5);
+		//test_and_set sets the flag again, so we have to remember that we saw it cleared.
+		bool stopping = false;
+		for(;;) {
+			//Check before reading, so that everything recorded before the flag was cleared still gets written.
+			if(should_keep_recording.test_and_set() == false) stopping = true;
+			//stopRecording holds the server's lock while it waits for us, so only spend so long on the rest.
+			if(stopping && std::chrono::steady_clock::now() > stop_deadline) {
+				if(ring->getReadAvailable()) logDebug("Recorder: dropped the last %i frames, which couldn't be written in time.", ring->getReadAvailable()/channels);
+				break;
 			}
-			catch(powercores::TimeoutException e) {
-				continue; //try again in  a bit, if no one has cleared the flag.
+			//Writes to the ring are whole blocks, so this is always whole frames.
+			int got = ring->read(write_workspace, recorder_write_frames*channels)/channels;
+			if(got) {
+				int frames= 0;
+				while(frames != got) frames += recording_to.write(got-frames, write_workspace+frames*channels);
+				continue;
 			}
-			int frames= 0;
-			while(frames != block_size) frames += recording_to.write(block_size-frames, buffer+frames*channels);
-			available_buffers.enqueue(buffer);
+			if(stopping) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
 		}
 	}
-	catch(...) {
-		//Todo: log here.
+	catch(ErrorException &e) {
 		//We do this because in theory an open file can be invalidated, and the app should keep running.
+		logDebug("Recorder: stopped writing after error %i: %s", e.error, e.message.c_str());
+	}
+	catch(...) {
+		logDebug("Recorder: stopped writing after an unknown error.");
 	}
 }
 
 void RecorderNode::process() {
 	if(recording) {
-		float* buffer;
-		if(available_buffers.size()) buffer = available_buffers.dequeue();
-		else buffer =allocArray<float>(buffer_size);
-		interleaveSamples(num_input_buffers, block_size, num_input_buffers, &input_buffers[0], buffer);
-		unwritten_buffers.enqueue(buffer);
+		//Dropping a whole block is better than allocating, and better than writing part of one.
+		if(ring->getWriteAvailable() < block_size*channels) overflows++;
+		else {
+			interleaveSamples(num_input_buffers, block_size, num_input_buffers, &input_buffers[0], block_workspace);
+			ring->write(block_workspace, block_size*channels);
+		}
+		getProperty(Lav_RECORDER_OVERFLOWS).setIntValue(overflows);
 	}
 	for(int i = 0; i < num_output_buffers; i++) std::copy(input_buffers[i], input_buffers[i]+block_size, output_buffers[i]);
 }
 
-void RecorderNode::doMaintenance() {
-	while(available_buffers.size() > buffer_freeing_threshold) freeArray(available_buffers.dequeue());
-}
-
 void RecorderNode::startRecording(std::string path) {
 	if(recording) stopRecording();
-	recording_to.open(path.c_str(), server->getSr(), channels);
+	recording_to.open(path.c_str(), server->getSr(), channels, getProperty(Lav_RECORDER_FORMAT).getIntValue());
+	int frames = std::max(block_size, (int)(getProperty(Lav_RECORDER_BUFFER_LENGTH).getDoubleValue()*server->getSr()));
+	if(ring == nullptr || ring->getCapacity() != frames*channels) {
+		delete ring;
+		ring = new LockFreeRing<float>(frames*channels);
+	}
+	overflows = 0;
+	getProperty(Lav_RECORDER_OVERFLOWS).setIntValue(0);
 	recording = true;
 	should_keep_recording.test_and_set(); //so the thread doesn't immediately stop.
 	recording_thread= powercores::safeStartThread(&RecorderNode::recordingThreadFunction, this);
@@ -93,8 +110,12 @@ void RecorderNode::startRecording(std::string path) {
 
 void RecorderNode::stopRecording() {
 	if(recording) {
+		//The thread writes whatever is left in the ring before stopping, for as long as we can afford to wait.
+		stop_deadline = std::chrono::steady_clock::now()+std::chrono::microseconds((long long)(recorder_max_stop_wait*1e6));
 		should_keep_recording.clear();
 		recording_thread.join();
+		//If it stopped early because of an error or the deadline, the rest is lost.
+		ring->clear();
 		recording_to.close();
 		recording =false;
 	}
@@ -0,0 +1,460 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/private/paged_audio.hpp>
+#include <libaudioverse/private/buffer.hpp>
+#include <libaudioverse/private/file.hpp>
+#include <libaudioverse/private/kernels.hpp>
+#include <libaudioverse/private/memory.hpp>
+#include <libaudioverse/private/error.hpp>
+#include <libaudioverse/private/utf8.hpp>
+#include <libaudioverse/private/logging.hpp>
+#include <powercores/utilities.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace libaudioverse_implementation {
+
+PagedAudio::PagedAudio(int channels, int frames): channels(channels), frames(frames) {
+}
+
+int PagedAudio::getChannels() {
+	return channels;
+}
+
+int PagedAudio::getFrames() {
+	return frames;
+}
+
+void PagedAudio::read(int channel, int frame, int count, float* destination) {
+	readFrames(channel, frame, count, destination);
+	if(gain != 1.0f) scalarMultiplicationKernel(count, gain, destination, destination);
+}
+
+void PagedAudio::setGain(float g) {
+	gain = g;
+}
+
+int PagedAudio::getUnderruns() {
+	return underruns.load();
+}
+
+//Map a file, returning null on failure.
+char* mapFile(const std::string &path, size_t* size) {
+	#ifdef WIN32
+	HANDLE file = CreateFileW(utf8ToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return nullptr;
+	LARGE_INTEGER s;
+	HANDLE mapping = NULL;
+	char* ret = nullptr;
+	if(GetFileSizeEx(file, &s) && s.QuadPart > 0) mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping) ret = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	//The view keeps the file open.
+	if(mapping) CloseHandle(mapping);
+	CloseHandle(file);
+	*size = (size_t)s.QuadPart;
+	return ret;
+	#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) return nullptr;
+	struct stat info;
+	void* ret = MAP_FAILED;
+	if(fstat(fd, &info) == 0 && info.st_size > 0) ret = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(ret == MAP_FAILED) return nullptr;
+	*size = (size_t)info.st_size;
+	return (char*)ret;
+	#endif
+}
+
+void unmapFile(char* mapping, size_t size) {
+	#ifdef WIN32
+	UnmapViewOfFile(mapping);
+	#else
+	munmap(mapping, size);
+	#endif
+}
+
+/**A wave file of 16-bit or float samples, mapped into memory.*/
+class MappedPcmAudio: public PagedAudio {
+	public:
+	MappedPcmAudio(int channels, int frames, char* mapping, size_t mappingSize, const char* samples, bool isFloat);
+	~MappedPcmAudio();
+	void prefetch(int frame, bool looping) override;
+	size_t getSize() override;
+	float computePeak() override;
+	protected:
+	void readFrames(int channel, int frame, int count, float* destination) override;
+	char* mapping;
+	size_t mapping_size;
+	const char* samples;
+	bool is_float;
+	int frame_size;
+	//The chunk we last asked the OS to read ahead of.
+	std::atomic<int> advised_chunk{-1};
+};
+
+MappedPcmAudio::MappedPcmAudio(int channels, int frames, char* mapping, size_t mappingSize, const char* samples, bool isFloat):
+PagedAudio(channels, frames), mapping(mapping), mapping_size(mappingSize), samples(samples), is_float(isFloat) {
+	frame_size = channels*(isFloat ? 4 : 2);
+}
+
+MappedPcmAudio::~MappedPcmAudio() {
+	unmapFile(mapping, mapping_size);
+}
+
+void MappedPcmAudio::readFrames(int channel, int frame, int count, float* destination) {
+	//Samples may not be aligned, so go through memcpy.  Scaling matches libsndfile, so that this is what a full load would give.
+	const char* p = samples+(size_t)frame*frame_size;
+	if(is_float) {
+		p += channel*4;
+		for(int i = 0; i < count; i++, p += frame_size) memcpy(destination+i, p, 4);
+	}
+	else {
+		p += channel*2;
+		for(int i = 0; i < count; i++, p += frame_size) {
+			int16_t s;
+			memcpy(&s, p, 2);
+			destination[i] = s*(1.0f/32768.0f);
+		}
+	}
+}
+
+void MappedPcmAudio::prefetch(int frame, bool looping) {
+	#ifndef WIN32
+	int chunk = frame/paged_chunk_frames;
+	if(advised_chunk.exchange(chunk) == chunk) return;
+	//Ask for the next few chunks, rounded out to pages.
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start = (samples-mapping)+(size_t)chunk*paged_chunk_frames*frame_size;
+	size_t end = std::min(mapping_size, start+(size_t)(paged_lookahead_chunks+1)*paged_chunk_frames*frame_size);
+	start = start/page*page;
+	if(start < end) madvise(mapping+start, end-start, MADV_WILLNEED);
+	//Looping back to the start will need the start.
+	if(looping && end == mapping_size) madvise(mapping, std::min(mapping_size, (size_t)(samples-mapping)+(size_t)paged_chunk_frames*frame_size), MADV_WILLNEED);
+	#endif
+}
+
+size_t MappedPcmAudio::getSize() {
+	return 0;
+}
+
+float MappedPcmAudio::computePeak() {
+	float peak = 0.0f;
+	std::vector<float> block(paged_chunk_frames);
+	for(int ch = 0; ch < channels; ch++) {
+		for(int f = 0; f < frames; f += paged_chunk_frames) {
+			int count = std::min(paged_chunk_frames, frames-f);
+			readFrames(ch, f, count, &block[0]);
+			for(int i = 0; i < count; i++) peak = std::max(peak, fabsf(block[i]));
+		}
+	}
+	return peak;
+}
+
+class PagedChunkSlot {
+	public:
+	int chunk = -1;
+	bool ready = false;
+	long long last_used = 0;
+	float* data = nullptr;
+};
+
+/**Any other file, decoded a chunk at a time.
+Decoding happens on the paged loader thread, and is serialized with computePeak by reader_mutex.
+Players ask for chunks by setting their flags in requested, which never blocks.
+slots and use_clock are protected by slots_mutex, which is only held long enough to copy out of a chunk or claim a slot, never across a read.*/
+class ChunkedAudio: public PagedAudio {
+	public:
+	ChunkedAudio(const std::string &path);
+	~ChunkedAudio();
+	void prefetch(int frame, bool looping) override;
+	size_t getSize() override;
+	float computePeak() override;
+	//Decode what's been asked for.  Only for the loader thread.
+	void service();
+	protected:
+	void readFrames(int channel, int frame, int count, float* destination) override;
+	//Copy out of chunk if we have it.
+	bool copyFromChunk(int channel, int chunk, int start, int count, float* destination);
+	//Ask the loader thread for chunk, if nobody has yet.
+	void request(int chunk);
+	//Make sure we have chunk, decoding it into the least recently used slot if we don't.
+	void decodeChunk(int chunk);
+	FileReader reader;
+	std::mutex reader_mutex, slots_mutex;
+	PagedChunkSlot slots[paged_chunk_slots];
+	//Interleaved, for the reader.
+	float* scratch = nullptr;
+	int chunk_count = 0;
+	//One flag per chunk, set by players and cleared by the loader once the chunk is decoded.
+	std::unique_ptr<std::atomic<bool>[]> requested;
+	std::atomic<bool> has_requests{false};
+	long long use_clock = 0;
+};
+
+/**The loader thread, which decodes chunks for every ChunkedAudio.
+Audios register themselves for their whole life; the thread holds paged_loader_mutex while decoding, so unregistering waits for it.*/
+std::mutex *paged_loader_mutex;
+std::condition_variable *paged_loader_condition;
+std::set<ChunkedAudio*> *paged_loader_audios;
+std::thread *paged_loader_thread;
+bool paged_loader_running = false;
+//Set by players so that a wake between the thread's pass and its wait isn't lost.
+std::atomic<bool> paged_loader_woken{false};
+
+void pagedLoaderThreadFunction() {
+	std::unique_lock<std::mutex> l(*paged_loader_mutex);
+	while(paged_loader_running) {
+		for(auto a: *paged_loader_audios) {
+			try {
+				a->service();
+			}
+			catch(ErrorException &e) {
+				logDebug("Paged audio: error %i while decoding: %s", e.error, e.message.c_str());
+			}
+		}
+		paged_loader_condition->wait_for(l, std::chrono::microseconds((long long)(paged_loader_max_sleep*1e6)), [] () {return paged_loader_woken.load() || paged_loader_running == false;});
+		paged_loader_woken.store(false);
+	}
+}
+
+void wakePagedLoader() {
+	paged_loader_woken.store(true);
+	paged_loader_condition->notify_one();
+}
+
+void initializePagedLoader() {
+	paged_loader_mutex = new std::mutex();
+	paged_loader_condition = new std::condition_variable();
+	paged_loader_audios = new std::set<ChunkedAudio*>();
+	paged_loader_running = true;
+	paged_loader_thread = new std::thread(powercores::safeStartThread(pagedLoaderThreadFunction));
+}
+
+void shutdownPagedLoader() {
+	{
+		std::lock_guard<std::mutex> guard(*paged_loader_mutex);
+		paged_loader_running = false;
+	}
+	paged_loader_condition->notify_one();
+	paged_loader_thread->join();
+	delete paged_loader_thread;
+	delete paged_loader_audios;
+	delete paged_loader_condition;
+	delete paged_loader_mutex;
+}
+
+ChunkedAudio::ChunkedAudio(const std::string &path): PagedAudio(0, 0) {
+	reader.open(path.c_str());
+	channels = reader.getChannelCount();
+	frames = reader.getFrameCount();
+	chunk_count = (frames+paged_chunk_frames-1)/paged_chunk_frames;
+	requested = std::unique_ptr<std::atomic<bool>[]>(new std::atomic<bool>[chunk_count]);
+	for(int i = 0; i < chunk_count; i++) requested[i].store(false);
+	for(auto &s: slots) s.data = allocArray<float>(channels*paged_chunk_frames);
+	scratch = allocArray<float>(channels*paged_chunk_frames);
+	//Players start at the beginning, and reads never wait, so have it ready.
+	if(chunk_count) decodeChunk(0);
+	std::lock_guard<std::mutex> guard(*paged_loader_mutex);
+	paged_loader_audios->insert(this);
+}
+
+ChunkedAudio::~ChunkedAudio() {
+	{
+		std::lock_guard<std::mutex> guard(*paged_loader_mutex);
+		paged_loader_audios->erase(this);
+	}
+	for(auto &s: slots) freeArray(s.data);
+	freeArray(scratch);
+}
+
+void ChunkedAudio::request(int chunk) {
+	if(requested[chunk].exchange(true)) return;
+	has_requests.store(true);
+	wakePagedLoader();
+}
+
+void ChunkedAudio::service() {
+	if(has_requests.exchange(false) == false) return;
+	for(int i = 0; i < chunk_count; i++) {
+		if(requested[i].load() == false) continue;
+		decodeChunk(i);
+		requested[i].store(false);
+	}
+}
+
+bool ChunkedAudio::copyFromChunk(int channel, int chunk, int start, int count, float* destination) {
+	std::lock_guard<std::mutex> guard(slots_mutex);
+	for(auto &s: slots) {
+		if(s.chunk != chunk || s.ready == false) continue;
+		s.last_used = ++use_clock;
+		float* p = s.data+channel*paged_chunk_frames+start;
+		std::copy(p, p+count, destination);
+		return true;
+	}
+	return false;
+}
+
+void ChunkedAudio::decodeChunk(int chunk) {
+	std::lock_guard<std::mutex> readerGuard(reader_mutex);
+	PagedChunkSlot* slot = nullptr;
+	{
+		std::lock_guard<std::mutex> guard(slots_mutex);
+		for(auto &s: slots) {
+			if(s.chunk == chunk && s.ready) return;
+		}
+		//Empty slots have a last_used of 0, so they go first.
+		slot = &*std::min_element(slots, slots+paged_chunk_slots, [] (const PagedChunkSlot &a, const PagedChunkSlot &b) {return a.last_used < b.last_used;});
+		slot->chunk = chunk;
+		slot->ready = false;
+	}
+	int start = chunk*paged_chunk_frames;
+	int wanted = std::min(paged_chunk_frames, frames-start);
+	int got = 0;
+	if(reader.seek(start) == start) got = reader.read(wanted, scratch);
+	//A short read leaves silence, rather than stale audio.
+	std::fill(scratch+got*channels, scratch+paged_chunk_frames*channels, 0.0f);
+	for(int ch = 0; ch < channels; ch++) {
+		float* out = slot->data+ch*paged_chunk_frames;
+		for(int i = 0; i < paged_chunk_frames; i++) out[i] = scratch[i*channels+ch];
+	}
+	std::lock_guard<std::mutex> guard(slots_mutex);
+	slot->ready = true;
+	slot->last_used = ++use_clock;
+}
+
+void ChunkedAudio::readFrames(int channel, int frame, int count, float* destination) {
+	while(count > 0) {
+		int chunk = frame/paged_chunk_frames, start = frame%paged_chunk_frames;
+		int needed = std::min(count, paged_chunk_frames-start);
+		//This is the audio thread, so rather than wait for the file, play silence until the loader catches up.
+		if(copyFromChunk(channel, chunk, start, needed, destination) == false) {
+			std::fill(destination, destination+needed, 0.0f);
+			underruns++;
+			request(chunk);
+		}
+		frame += needed;
+		destination += needed;
+		count -= needed;
+	}
+}
+
+void ChunkedAudio::prefetch(int frame, bool looping) {
+	int chunk = frame/paged_chunk_frames;
+	for(int i = 0; i <= paged_lookahead_chunks; i++) {
+		int target = chunk+i;
+		if(target >= chunk_count) {
+			if(looping == false) break;
+			target -= chunk_count;
+			if(target >= chunk_count) break;
+		}
+		if(requested[target].load()) continue;
+		bool have = false;
+		{
+			std::lock_guard<std::mutex> guard(slots_mutex);
+			for(auto &s: slots) have = have || s.chunk == target;
+		}
+		if(have == false) request(target);
+	}
+}
+
+size_t ChunkedAudio::getSize() {
+	return sizeof(float)*channels*paged_chunk_frames*(paged_chunk_slots+1);
+}
+
+float ChunkedAudio::computePeak() {
+	std::lock_guard<std::mutex> guard(reader_mutex);
+	float peak = 0.0f;
+	reader.seek(0);
+	for(int f = 0; f < frames; f += paged_chunk_frames) {
+		int got = reader.read(std::min(paged_chunk_frames, frames-f), scratch);
+		for(int i = 0; i < got*channels; i++) peak = std::max(peak, fabsf(scratch[i]));
+		if(got == 0) break;
+	}
+	return peak;
+}
+
+uint32_t readLittleEndian(const char* p, int bytes) {
+	uint32_t ret = 0;
+	for(int i = bytes-1; i >= 0; i--) ret = (ret<<8)|(unsigned char)p[i];
+	return ret;
+}
+
+//Find the samples of a wave file of 16-bit or float samples, or return null.
+const char* findWaveSamples(const char* data, size_t size, int channels, int frames, bool* isFloat) {
+	uint16_t one = 1;
+	//Mapped samples are read as they are.
+	if(*(char*)&one != 1) return nullptr;
+	if(size < 12 || memcmp(data, "RIFF", 4) || memcmp(data+8, "WAVE", 4)) return nullptr;
+	int tag = 0, bits = 0, fileChannels = 0;
+	size_t pos = 12;
+	while(pos+8 <= size) {
+		const char* chunk = data+pos;
+		size_t length = readLittleEndian(chunk+4, 4);
+		if(length > size-pos-8) return nullptr;
+		if(memcmp(chunk, "fmt ", 4) == 0 && length >= 16) {
+			tag = readLittleEndian(chunk+8, 2);
+			fileChannels = readLittleEndian(chunk+10, 2);
+			bits = readLittleEndian(chunk+22, 2);
+			//WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the subformat.
+			if(tag == 0xfffe && length >= 40) tag = readLittleEndian(chunk+32, 2);
+		}
+		else if(memcmp(chunk, "data", 4) == 0) {
+			if(fileChannels != channels) return nullptr;
+			if(tag == 1 && bits == 16) *isFloat = false;
+			else if(tag == 3 && bits == 32) *isFloat = true;
+			else return nullptr;
+			if(length < (size_t)frames*channels*(*isFloat ? 4 : 2)) return nullptr;
+			return chunk+8;
+		}
+		pos += 8+length+(length&1);
+	}
+	return nullptr;
+}
+
+std::shared_ptr<PagedAudio> openPagedAudio(const std::string &path, int sr) {
+	int channels, frames;
+	{
+		FileReader probe{};
+		probe.open(path.c_str());
+		if((int)probe.getSr() != sr) return nullptr;
+		channels = probe.getChannelCount();
+		frames = probe.getFrameCount();
+	}
+	size_t size = 0;
+	char* mapping = mapFile(path, &size);
+	if(mapping) {
+		bool isFloat = false;
+		const char* samples = findWaveSamples(mapping, size, channels, frames, &isFloat);
+		if(samples) return std::make_shared<MappedPcmAudio>(channels, frames, mapping, size, samples, isFloat);
+		unmapFile(mapping, size);
+	}
+	return std::make_shared<ChunkedAudio>(path);
+}
+
+}
@@ -16,6 +16,12 @@ carrying such notice may not be copied, modified, or distributed except accordin
 
 namespace libaudioverse_implementation {
 
+thread_local int current_job_group = 0;
+
+int getCurrentJobGroup() {
+	return current_job_group;
+}
+
 Planner::Planner() {
 }
 
@@ -28,6 +34,7 @@ void Planner::execute(std::shared_ptr<Job> start, int threads) {
 	else initializeStrongPlan(); //Try to get it from the cache.
 	//We might invalidate because of a dead weak pointer, but this can only happen once.
 	if(is_valid == false) replan(start);
+	makeJobGroups();
 	if(threads == 1) {
 		runJobsSync();
 	}
@@ -53,12 +60,33 @@ void jobExecutor(std::shared_ptr<Job> &j) {
 	j->job_recorded = false;
 }
 
-void Planner::runJobsSync() {
-	becomeAudioThread();
+void groupExecutor(JobGroup &g) {
+	current_job_group = g.index;
+	for(auto j = g.begin; j != g.end; j++) jobExecutor(*j);
+	current_job_group = 0;
+}
+
+void Planner::makeJobGroups() {
+	job_groups.resize(plan.size());
+	int b = 0;
 	for(auto &bin: plan) {
-		for(auto &j: bin.second) {
-			jobExecutor(j);
+		auto &groups = job_groups[b];
+		groups.clear();
+		int count = (int)bin.second.size();
+		for(int g = 0; g < planner_job_group_count; g++) {
+			int start = g*count/planner_job_group_count, end = (g+1)*count/planner_job_group_count;
+			if(start == end) continue;
+			groups.push_back({g, bin.second.data()+start, bin.second.data()+end});
 		}
+		b++;
+	}
+}
+
+void Planner::runJobsSync() {
+	becomeAudioThread();
+	//The same groups as the threaded path, in order.
+	for(auto &groups: job_groups) {
+		for(auto &g: groups) groupExecutor(g);
 	}
 	//We are potentially sharing this thread with someone else. It is important that we don't accidentally give them high priority too.
 	unbecomeAudioThread();
@@ -68,8 +96,8 @@ void Planner::runJobsAsync() {
 	//becomeAudioThread is no-op if called multiple times.
 	//Putting it here greatly simplifies thread pool startup logic.
 	thread_pool.submitJobToAllThreads(becomeAudioThread);
-	for(auto &bin: plan) {
-		thread_pool.map(jobExecutor, bin.second.begin(), bin.second.end());
+	for(auto &groups: job_groups) {
+		thread_pool.map(groupExecutor, groups.begin(), groups.end());
 		thread_pool.submitBarrier();
 	}
 	//At this point, submit a meaningless job that does nothing.
@@ -16,6 +16,7 @@ carrying such notice may not be copied, modified, or distributed except accordin
 #include <libaudioverse/private/data.hpp>
 #include <libaudioverse/private/file.hpp>
 #include <libaudioverse/private/planner.hpp>
+#include <libaudioverse/private/streaming.hpp>
 #include <libaudioverse/private/logging.hpp>
 #include <libaudioverse/private/helper_templates.hpp>
 #include <powercores/utilities.hpp>
@@ -38,6 +39,7 @@ Server::Server(unsigned int sr, unsigned int blockSize, unsigned int mixahead):
 	//fire up the background thread.
 	backgroundTaskThread = powercores::safeStartThread(&Server::backgroundTaskThreadFunction, this);
 	planner = new Planner();
+	streaming_scheduler = std::make_shared<StreamingScheduler>(streaming_default_threads);
 	//Get thread count.
 	int defaultThreadCount = std::thread::hardware_concurrency();
 	if(defaultThreadCount == 0) {
@@ -224,6 +226,10 @@ int Server::getThreads() {
 	return threads;
 }
 
+std::shared_ptr<StreamingScheduler> Server::getStreamingScheduler() {
+	return streaming_scheduler;
+}
+
 void Server::invalidatePlan() {
 	planner->invalidatePlan();
 }
@@ -347,6 +353,38 @@ Lav_PUBLIC_FUNCTION LavError Lav_serverGetThreads(LavHandle serverHandle, int* d
 	PUB_END
 }
 
+Lav_PUBLIC_FUNCTION LavError Lav_serverSetStreamingThreads(LavHandle serverHandle, int threads) {
+	PUB_BEGIN
+	if(threads < 1) ERROR(Lav_ERROR_RANGE, "Cannot stream with less than one thread.");
+	auto s = incomingObject<Server>(serverHandle);
+	//This waits for reads in progress, so it mustn't hold up the audio thread.  The scheduler does its own locking.
+	s->getStreamingScheduler()->setThreadCount(threads);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_serverGetStreamingThreads(LavHandle serverHandle, int* destination) {
+	PUB_BEGIN
+	auto s = incomingObject<Server>(serverHandle);
+	*destination = s->getStreamingScheduler()->getThreadCount();
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_serverGetStreamingStats(LavHandle serverHandle, int* streams, double* throughput, double* latency, double* maxLatency, int* underruns) {
+	PUB_BEGIN
+	auto s = incomingObject<Server>(serverHandle);
+	LOCK(*s);
+	s->getStreamingScheduler()->getStats(streams, throughput, latency, maxLatency, underruns);
+	PUB_END
+}
+
+Lav_PUBLIC_FUNCTION LavError Lav_serverResetStreamingStats(LavHandle serverHandle) {
+	PUB_BEGIN
+	auto s = incomingObject<Server>(serverHandle);
+	LOCK(*s);
+	s->getStreamingScheduler()->resetStats();
+	PUB_END
+}
+
 Lav_PUBLIC_FUNCTION LavError Lav_serverCallIn(LavHandle serverHandle, double when, int inAudioThread, LavTimeCallback cb, void* userdata) {
 	PUB_BEGIN
 	auto s = incomingObject<Server>(serverHandle);
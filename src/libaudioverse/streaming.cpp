@@ -0,0 +1,213 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+#include <libaudioverse/private/streaming.hpp>
+#include <libaudioverse/implementations/file_streamer.hpp>
+#include <libaudioverse/private/logging.hpp>
+#include <libaudioverse/private/error.hpp>
+#include <powercores/utilities.hpp>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace libaudioverse_implementation {
+
+void StreamingStats::add(const StreamingStats &other) {
+	frames += other.frames;
+	seconds += other.seconds;
+	reads += other.reads;
+	total_latency += other.total_latency;
+	max_latency = std::max(max_latency, other.max_latency);
+	underruns += other.underruns;
+}
+
+StreamingScheduler::StreamingScheduler(int threads) {
+	stats_start = std::chrono::steady_clock::now();
+	startThreads(threads);
+}
+
+StreamingScheduler::~StreamingScheduler() {
+	stopThreads();
+}
+
+void StreamingScheduler::addStream(FileStreamer* stream) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		streams[stream].underruns_at_reset = stream->getUnderruns();
+	}
+	wake_condition.notify_all();
+}
+
+void StreamingScheduler::retireStream(FileStreamer* stream) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		auto i = streams.find(stream);
+		if(i != streams.end()) {
+			//Waiting for the read would hold up whoever destroyed the stream's node, usually with the server locked.
+			if(i->second.in_service) {
+				i->second.retired = true;
+				return;
+			}
+			i->second.stats.underruns = stream->getUnderruns()-i->second.underruns_at_reset;
+			retired_stats.add(i->second.stats);
+			streams.erase(i);
+		}
+	}
+	delete stream;
+}
+
+void StreamingScheduler::wake() {
+	wake_condition.notify_all();
+}
+
+void StreamingScheduler::setThreadCount(int threads) {
+	std::lock_guard<std::mutex> guard(threads_mutex);
+	stopThreads();
+	startThreads(threads);
+}
+
+int StreamingScheduler::getThreadCount() {
+	std::lock_guard<std::mutex> guard(threads_mutex);
+	return (int)threads.size();
+}
+
+void StreamingScheduler::startThreads(int count) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		running = true;
+	}
+	for(int i = 0; i < count; i++) threads.push_back(powercores::safeStartThread(&StreamingScheduler::threadFunction, this));
+}
+
+void StreamingScheduler::stopThreads() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		running = false;
+	}
+	wake_condition.notify_all();
+	for(auto &t: threads) t.join();
+	threads.clear();
+}
+
+FileStreamer* StreamingScheduler::pickStream(double* sleepFor) {
+	auto now = std::chrono::steady_clock::now();
+	FileStreamer* best = nullptr;
+	double bestDeadline = 0.0;
+	*sleepFor = streaming_max_sleep;
+	for(auto &i: streams) {
+		auto &state = i.second;
+		if(state.in_service || state.failed) continue;
+		double until = i.first->getSecondsUntilService();
+		if(until > 0.0) {
+			*sleepFor = std::min(*sleepFor, until);
+			continue;
+		}
+		if(state.is_due == false) {
+			state.is_due = true;
+			state.due_since = now;
+		}
+		double deadline = i.first->getDeadline();
+		if(best == nullptr || deadline < bestDeadline) {
+			best = i.first;
+			bestDeadline = deadline;
+		}
+	}
+	if(best) streams[best].in_service = true;
+	return best;
+}
+
+void StreamingScheduler::threadFunction() {
+	std::unique_lock<std::mutex> l(mutex);
+	while(running) {
+		double sleepFor;
+		FileStreamer* stream = pickStream(&sleepFor);
+		if(stream == nullptr) {
+			//Not sleeping at all would spin, and the audio thread drains rings a block at a time anyway.
+			sleepFor = std::max(sleepFor, 0.001);
+			wake_condition.wait_for(l, std::chrono::microseconds((long long)(sleepFor*1e6)));
+			continue;
+		}
+		l.unlock();
+		int frames = 0;
+		bool failed = false;
+		try {
+			frames = stream->service();
+		}
+		catch(ErrorException &e) {
+			//The file may stop being readable, and the app should keep running.
+			logDebug("Streaming: stopped reading a stream after error %i: %s", e.error, e.message.c_str());
+			failed = true;
+		}
+		auto now = std::chrono::steady_clock::now();
+		l.lock();
+		auto &state = streams[stream];
+		if(frames) {
+			double latency = std::chrono::duration<double>(now-state.due_since).count();
+			state.stats.frames += frames;
+			state.stats.seconds += frames/(double)stream->getFileSr();
+			state.stats.reads += 1;
+			state.stats.total_latency += latency;
+			state.stats.max_latency = std::max(state.stats.max_latency, latency);
+		}
+		state.is_due = false;
+		state.failed = failed;
+		state.in_service = false;
+		if(state.retired) {
+			state.stats.underruns = stream->getUnderruns()-state.underruns_at_reset;
+			retired_stats.add(state.stats);
+			streams.erase(stream);
+			l.unlock();
+			delete stream;
+			l.lock();
+		}
+	}
+}
+
+void StreamingScheduler::reportStats(const StreamingStats &stats, double* throughput, double* latency, double* maxLatency, int* underruns) {
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-stats_start).count();
+	*throughput = elapsed > 0.0 ? stats.seconds/elapsed : 0.0;
+	//Latencies are reported in milliseconds.
+	*latency = stats.reads ? stats.total_latency/stats.reads*1000.0 : 0.0;
+	*maxLatency = stats.max_latency*1000.0;
+	*underruns = stats.underruns;
+}
+
+void StreamingScheduler::getStreamStats(FileStreamer* stream, double* throughput, double* latency, double* maxLatency, int* underruns) {
+	std::lock_guard<std::mutex> guard(mutex);
+	StreamingStats stats;
+	auto i = streams.find(stream);
+	if(i != streams.end()) {
+		stats = i->second.stats;
+		stats.underruns = stream->getUnderruns()-i->second.underruns_at_reset;
+	}
+	reportStats(stats, throughput, latency, maxLatency, underruns);
+}
+
+void StreamingScheduler::getStats(int* streamCount, double* throughput, double* latency, double* maxLatency, int* underruns) {
+	std::lock_guard<std::mutex> guard(mutex);
+	StreamingStats stats = retired_stats;
+	for(auto &i: streams) {
+		StreamingStats s = i.second.stats;
+		s.underruns = i.first->getUnderruns()-i.second.underruns_at_reset;
+		stats.add(s);
+	}
+	*streamCount = (int)streams.size();
+	reportStats(stats, throughput, latency, maxLatency, underruns);
+}
+
+void StreamingScheduler::resetStats() {
+	std::lock_guard<std::mutex> guard(mutex);
+	retired_stats = StreamingStats();
+	for(auto &i: streams) {
+		i.second.stats = StreamingStats();
+		i.second.underruns_at_reset = i.first->getUnderruns();
+	}
+	stats_start = std::chrono::steady_clock::now();
+}
+
+}
@@ -0,0 +1,114 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Creates many sources with the given panning strategy, renders a few blocks so that they make their panners, and prints the memory used per source.
+Run it once with hrtf and once with stereo to see what the hrtf panner costs; sources only pay for the panners they use.
+Memory is measured as the growth of the process's resident set, so it includes the allocator's overhead.*/
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/libaudioverse_properties.h>
+#include <libaudioverse/libaudioverse3d.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+#define BLOCK_SIZE 1024
+#define NUM_SOURCES 1000
+#define NUM_BLOCKS 10
+float storage[BLOCK_SIZE*2] = {0};
+
+#define ERRCHECK(x) do {\
+if((x) != Lav_ERROR_NONE) {\
+	printf(#x " errored: %i", (x));\
+	Lav_shutdown();\
+	return 1;\
+}\
+} while(0)\
+
+//Resident memory in bytes, or 0 if we don't know how to find it.
+long long residentMemory() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0) return 0;
+	return counters.WorkingSetSize;
+#else
+	FILE* f = fopen("/proc/self/statm", "r");
+	if(f == nullptr) return 0;
+	long long size = 0, resident = 0;
+	int got = fscanf(f, "%lld %lld", &size, &resident);
+	fclose(f);
+	if(got != 2) return 0;
+	return resident*sysconf(_SC_PAGESIZE);
+#endif
+}
+
+int main(int argc, char** args) {
+	if(argc < 3) {
+		printf("Usage: %s <hrtf file or default> <hrtf|stereo|surround40|surround51|surround71> [sources]\n", args[0]);
+		return 1;
+	}
+	int strategy;
+	if(strcmp(args[2], "hrtf") == 0) strategy = Lav_PANNING_STRATEGY_HRTF;
+	else if(strcmp(args[2], "stereo") == 0) strategy = Lav_PANNING_STRATEGY_STEREO;
+	else if(strcmp(args[2], "surround40") == 0) strategy = Lav_PANNING_STRATEGY_SURROUND40;
+	else if(strcmp(args[2], "surround51") == 0) strategy = Lav_PANNING_STRATEGY_SURROUND51;
+	else if(strcmp(args[2], "surround71") == 0) strategy = Lav_PANNING_STRATEGY_SURROUND71;
+	else {
+		printf("Unknown panning strategy %s\n", args[2]);
+		return 1;
+	}
+	int numSources = NUM_SOURCES;
+	if(argc == 4) {
+		sscanf(args[3], "%i", &numSources);
+		if(numSources < 1) {
+			printf("Sources must be greater than 0.\n");
+			return 1;
+		}
+	}
+	ERRCHECK(Lav_initialize());
+	LavHandle server, world, sineObj;
+	std::vector<LavHandle> sources;
+	ERRCHECK(Lav_createServer(44100, BLOCK_SIZE, &server));
+	ERRCHECK(Lav_createEnvironmentNode(server, args[1], &world));
+	ERRCHECK(Lav_nodeSetIntProperty(world, Lav_ENVIRONMENT_PANNING_STRATEGY, strategy));
+	ERRCHECK(Lav_createSineNode(server, &sineObj));
+	ERRCHECK(Lav_nodeConnectServer(world, 0));
+	//Render once first, so that anything shared between sources is already allocated.
+	ERRCHECK(Lav_serverGetBlock(server, 2, 1, storage));
+	long long before = residentMemory();
+	if(before == 0) {
+		printf("Can't measure memory on this platform.\n");
+		Lav_shutdown();
+		return 1;
+	}
+	for(int i = 0; i < numSources; i++) {
+		LavHandle newSource;
+		ERRCHECK(Lav_createSourceNode(server, world, &newSource));
+		ERRCHECK(Lav_nodeConnect(sineObj, 0, newSource, 0));
+		//Spread them around the listener, so that none are culled.
+		float x = (float)(i%20)-10.0f, z = (float)(i/20%20)-10.0f;
+		ERRCHECK(Lav_nodeSetFloat3Property(newSource, Lav_SOURCE_POSITION, x, 0.0f, z));
+		sources.push_back(newSource);
+	}
+	long long created = residentMemory();
+	for(int i = 0; i < NUM_BLOCKS; i++) ERRCHECK(Lav_serverGetBlock(server, 2, 1, storage));
+	long long rendered = residentMemory();
+	printf("%i sources using %s panning\n", numSources, args[2]);
+	printf("After creation: %f KB per source\n", (created-before)/1024.0/numSources);
+	printf("After rendering %i blocks: %f KB per source\n", NUM_BLOCKS, (rendered-before)/1024.0/numSources);
+	for(auto i: sources) ERRCHECK(Lav_handleDecRef(i));
+	Lav_shutdown();
+	return 0;
+}
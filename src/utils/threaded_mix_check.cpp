@@ -0,0 +1,105 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Renders the same scene of many moving sources on one thread and on several, and checks that the output is bit-identical.
+Sources mix into the environment from whichever threads run them, so this catches both races and any dependence on scheduling.
+Exits with 1 if the outputs differ.*/
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/libaudioverse_properties.h>
+#include <libaudioverse/libaudioverse3d.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define BLOCK_SIZE 256
+#define NUM_SOURCES 300
+#define NUM_BLOCKS 400
+
+#define ERRCHECK(x) do {\
+if((x) != Lav_ERROR_NONE) {\
+	printf(#x " errored: %i", (x));\
+	Lav_shutdown();\
+	exit(1);\
+}\
+} while(0)\
+
+//Render the scene with the given thread count and return the output.
+std::vector<float> render(const char* hrtf, int strategy, int threads) {
+	LavHandle server, world;
+	std::vector<LavHandle> sources, sines;
+	ERRCHECK(Lav_createServer(44100, BLOCK_SIZE, &server));
+	ERRCHECK(Lav_serverSetThreads(server, threads));
+	ERRCHECK(Lav_createEnvironmentNode(server, hrtf, &world));
+	ERRCHECK(Lav_nodeSetIntProperty(world, Lav_ENVIRONMENT_PANNING_STRATEGY, strategy));
+	ERRCHECK(Lav_nodeConnectServer(world, 0));
+	int reverb;
+	ERRCHECK(Lav_environmentNodeAddEffectSend(world, 4, 1, 1, &reverb));
+	for(int i = 0; i < NUM_SOURCES; i++) {
+		LavHandle sine, source;
+		ERRCHECK(Lav_createSineNode(server, &sine));
+		ERRCHECK(Lav_nodeSetFloatProperty(sine, Lav_OSCILLATOR_FREQUENCY, 100.0f+i*7.0f));
+		ERRCHECK(Lav_createSourceNode(server, world, &source));
+		ERRCHECK(Lav_nodeConnect(sine, 0, source, 0));
+		sines.push_back(sine);
+		sources.push_back(source);
+	}
+	std::vector<float> output(NUM_BLOCKS*BLOCK_SIZE*2);
+	for(int b = 0; b < NUM_BLOCKS; b++) {
+		//Move everything every few blocks, so that panners crossfade and sources come in and out of range.
+		if(b%8 == 0) {
+			for(int i = 0; i < NUM_SOURCES; i++) {
+				float t = (b+i*13)%200/200.0f;
+				float x = 60.0f*t-30.0f, z = (float)(i%17)-8.0f;
+				ERRCHECK(Lav_nodeSetFloat3Property(sources[i], Lav_SOURCE_POSITION, x, 0.0f, z));
+			}
+		}
+		ERRCHECK(Lav_serverGetBlock(server, 2, 1, &output[b*BLOCK_SIZE*2]));
+	}
+	for(auto h: sources) ERRCHECK(Lav_handleDecRef(h));
+	for(auto h: sines) ERRCHECK(Lav_handleDecRef(h));
+	ERRCHECK(Lav_handleDecRef(world));
+	ERRCHECK(Lav_handleDecRef(server));
+	return output;
+}
+
+int main(int argc, char** args) {
+	if(argc < 2) {
+		printf("Usage: %s <hrtf file or default> [threads]\n", args[0]);
+		return 1;
+	}
+	int threads = 4;
+	if(argc == 3) {
+		sscanf(args[2], "%i", &threads);
+		if(threads < 2) {
+			printf("Threads must be at least 2.\n");
+			return 1;
+		}
+	}
+	ERRCHECK(Lav_initialize());
+	int strategies[] = {Lav_PANNING_STRATEGY_HRTF, Lav_PANNING_STRATEGY_STEREO, Lav_PANNING_STRATEGY_SURROUND51};
+	const char* names[] = {"hrtf", "stereo", "surround51"};
+	int failed = 0;
+	for(int s = 0; s < 3; s++) {
+		auto single = render(args[1], strategies[s], 1);
+		auto multi = render(args[1], strategies[s], threads);
+		int mismatches = 0, first = -1;
+		for(int i = 0; i < single.size(); i++) {
+			if(memcmp(&single[i], &multi[i], sizeof(float)) == 0) continue;
+			if(first == -1) first = i;
+			mismatches++;
+		}
+		if(mismatches) {
+			printf("%s: %i of %i samples differ, starting at frame %i\n", names[s], mismatches, (int)single.size(), first/2);
+			failed = 1;
+		}
+		else printf("%s: 1 and %i threads match\n", names[s], threads);
+	}
+	Lav_shutdown();
+	return failed;
+}
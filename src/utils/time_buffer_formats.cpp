@@ -0,0 +1,68 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Loads a file in each buffer storage format, then plays it with many looping buffer nodes and prints the memory used and how long rendering took.
+Half the nodes play at a different rate, so that both the copying and the interpolating paths of the buffer player are timed.*/
+#include "time_helper.hpp"
+#include <libaudioverse/libaudioverse.h>
+#include <libaudioverse/libaudioverse_properties.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define BLOCK_SIZE 1024
+#define NUM_NODES 100
+#define NUM_TIMES 200
+float storage[BLOCK_SIZE*2] = {0};
+
+#define ERRCHECK(x) do {\
+if((x) != Lav_ERROR_NONE) {\
+	printf(#x " errored: %i", (x));\
+	Lav_shutdown();\
+	return 1;\
+}\
+} while(0)\
+
+int main(int argc, char** args) {
+	if(argc != 2) {
+		printf("Usage: %s <sound file>\n", args[0]);
+		return 1;
+	}
+	ERRCHECK(Lav_initialize());
+	int formats[] = {Lav_BUFFER_STORAGE_FORMAT_FLOAT, Lav_BUFFER_STORAGE_FORMAT_INT16, Lav_BUFFER_STORAGE_FORMAT_HALF, Lav_BUFFER_STORAGE_FORMAT_ADPCM};
+	const char* names[] = {"float", "int16", "half", "adpcm"};
+	for(int f = 0; f < 4; f++) {
+		LavHandle server, buffer;
+		std::vector<LavHandle> nodes;
+		ERRCHECK(Lav_createServer(44100, BLOCK_SIZE, &server));
+		ERRCHECK(Lav_createBuffer(server, &buffer));
+		ERRCHECK(Lav_bufferSetStorageFormat(buffer, formats[f]));
+		ERRCHECK(Lav_bufferLoadFromFile(buffer, args[1]));
+		int size;
+		ERRCHECK(Lav_bufferGetSizeInBytes(buffer, &size));
+		for(int i = 0; i < NUM_NODES; i++) {
+			LavHandle node;
+			ERRCHECK(Lav_createBufferNode(server, &node));
+			ERRCHECK(Lav_nodeSetBufferProperty(node, Lav_BUFFER_BUFFER, buffer));
+			ERRCHECK(Lav_nodeSetIntProperty(node, Lav_BUFFER_LOOPING, 1));
+			if(i%2) ERRCHECK(Lav_nodeSetDoubleProperty(node, Lav_BUFFER_RATE, 1.1));
+			ERRCHECK(Lav_nodeConnectServer(node, 0));
+			nodes.push_back(node);
+		}
+		float t = timeit([&] () {
+			Lav_serverGetBlock(server, 2, 1, storage);
+		}, NUM_TIMES);
+		printf("%s: %i KB, %f seconds for %i blocks of %i nodes\n", names[f], size/1024, t, NUM_TIMES, NUM_NODES);
+		for(auto i: nodes) ERRCHECK(Lav_handleDecRef(i));
+		ERRCHECK(Lav_handleDecRef(buffer));
+		ERRCHECK(Lav_handleDecRef(server));
+	}
+	Lav_shutdown();
+	return 0;
+}
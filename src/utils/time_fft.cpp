@@ -0,0 +1,55 @@
+/* Copyright 2016 Libaudioverse Developers. See the COPYRIGHT
+file at the top-level directory of this distribution.
+
+Licensed under the mozilla Public License, version 2.0 <LICENSE.MPL2 or
+https://www.mozilla.org/en-US/MPL/2.0/> or the Gbnu General Public License, V3 or later
+<LICENSE.GPL3 or http://www.gnu.org/licenses/>, at your option. All files in the project
+carrying such notice may not be copied, modified, or distributed except according to those terms. */
+
+/**Times a forward and inverse real fft with each fft backend, for sizes from 64 to 65536.
+Sizes include the powers of two and some of the 3- and 5-smooth sizes the convolvers use.*/
+#include "time_helper.hpp"
+#include <libaudioverse/private/fft.hpp>
+#include <kiss_fft.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+#include <memory>
+
+using namespace libaudioverse_implementation;
+
+//Aim for roughly the same amount of work per size.
+#define TOTAL_SAMPLES (1<<24)
+
+float timePlans(std::shared_ptr<FftPlan> forward, std::shared_ptr<FftPlan> inverse, int size) {
+	std::vector<float> samples(size);
+	std::vector<kiss_fft_cpx> spectrum(size/2+1);
+	for(auto &i: samples) i = rand()/(float)RAND_MAX-0.5f;
+	int times = TOTAL_SAMPLES/size;
+	float t = timeit([&] () {
+		forward->fft(samples.data(), spectrum.data());
+		inverse->ifft(spectrum.data(), samples.data());
+		//Keep the values from growing without bound.
+		for(auto &i: samples) i /= size;
+	}, times);
+	//Microseconds per pair of ffts.
+	return t/times*1e6f;
+}
+
+int main(int argc, char** args) {
+	std::vector<int> sizes;
+	for(int i = 64; i <= 65536; i *= 2) sizes.push_back(i);
+	for(int i: {96, 160, 480, 960, 1920, 3840, 7680, 15360, 30720, 61440}) sizes.push_back(i);
+	printf("%8s %14s %14s %8s\n", "size", "kissfft (us)", "sse (us)", "speedup");
+	for(int size: sizes) {
+		float kiss = timePlans(createKissFftPlan(size, false), createKissFftPlan(size, true), size);
+		auto sseForward = createSseFftPlan(size, false), sseInverse = createSseFftPlan(size, true);
+		if(sseForward == nullptr) {
+			printf("%8i %14f %14s %8s\n", size, kiss, "unsupported", "-");
+			continue;
+		}
+		float sse = timePlans(sseForward, sseInverse, size);
+		printf("%8i %14f %14f %8.2f\n", size, kiss, sse, kiss/sse);
+	}
+	return 0;
+}